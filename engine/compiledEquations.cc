@@ -0,0 +1,68 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "compiledEquations.h"
+#include "operationType.h"
+#include "minskyVersion.h"
+#include <ecolab_epilogue.h>
+#include <fstream>
+#include <iterator>
+using namespace std;
+
+namespace minsky
+{
+  string CompiledEquations::engineBuild()
+  {
+    return string(MINSKY_VERSION)+":"+to_string(int(OperationType::numOps));
+  }
+
+  void CompiledEquations::write(const string& fileName) const
+  {
+    classdesc::pack_t buf;
+    buf<<int(version)<<engineBuild()<<*this;
+    ofstream f(fileName, ios::binary);
+    f.write(buf.data(), buf.size());
+    if (!f)
+      throw ecolab::error("unable to write equations to %s",fileName.c_str());
+  }
+
+  bool CompiledEquations::read(const string& fileName)
+  {
+    ifstream f(fileName, ios::binary);
+    if (!f) return false;
+    string data((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+    try
+      {
+        classdesc::pack_t buf;
+        buf.packraw(data.data(), data.size());
+        int fileVersion=0;
+        buf>>fileVersion;
+        if (fileVersion!=version) return false;
+        string build;
+        buf>>build;
+        if (build!=engineBuild()) return false;
+        buf>>*this;
+        return true;
+      }
+    catch (const std::exception&)
+      {
+        // truncated or corrupt, so rebuild the equations instead
+        return false;
+      }
+  }
+}
@@ -0,0 +1,95 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMPILEDEQUATIONS_H
+#define COMPILEDEQUATIONS_H
+#include "variableValue.h"
+#include "evalGodley.h"
+#include "classdesc_access.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace minsky
+{
+  /// an EvalOp, with its state operation referred to by schema item id
+  struct CompiledOp
+  {
+    int type=0, out=0, in1=0, in2=0;
+    bool flow1=true, flow2=true;
+    /// schema id of the operation supplying state, or -1
+    int state=-1;
+    /// value of constant operations
+    double value=0;
+  };
+
+  struct CompiledIntegral
+  {
+    VariableValue stock, input;
+    /// schema id of the integral operation, or -1
+    int operation=-1;
+  };
+
+  /// value attached to an output port of an item
+  struct CompiledPortValue
+  {
+    int item=-1;
+    unsigned port=0;
+    VariableValue value;
+  };
+
+  /**
+     The equation program produced by Minsky::constructEquations and
+     initGodleys, stored alongside a model file so that an unchanged
+     model can be simulated without rebuilding it. Items are referred
+     to by their ids in the saved schema, so the program is only
+     valid for the model whose structural hash is \a modelHash.
+  */
+  struct CompiledEquations
+  {
+    /// bumped whenever the layout of this structure changes
+    static const int version=3;
+    /// identifies the engine that wrote the file, as the stored
+    /// operation types and Godley matrix are only meaningful to the
+    /// same build
+    static std::string engineBuild();
+    unsigned long long modelHash=0;
+    std::vector<CompiledOp> equations;
+    std::vector<CompiledIntegral> integrals;
+    /// variable slot assignments
+    std::vector<std::pair<std::string, VariableValue> > variableValues;
+    std::vector<CompiledPortValue> portValues;
+    /// variable vectors as initialised by constructEquations
+    std::vector<double> stockVars, flowVars;
+    /// Godley table flow to stock matrix
+    EvalGodley godley;
+
+    /// name of the file holding the program for model file \a modelFile
+    static std::string fileName(const std::string& modelFile)
+    {return modelFile+".eqn";}
+    /// @throw ecolab::error if \a fileName cannot be written
+    void write(const std::string& fileName) const;
+    /// @return false if \a fileName cannot be read, or was written by
+    /// an incompatible version or different engine build
+    bool read(const std::string& fileName);
+  };
+}
+
+#include "compiledEquations.cd"
+#endif
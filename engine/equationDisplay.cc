@@ -152,65 +152,71 @@ namespace MathDAG
   {
     double x, y; // starting position of current line
     cairo_get_current_point(dest.cairo(),&x,&y);
-    Pango den(dest.cairo());
-    den.setMarkup("dt");
-
-    for (const VariableDAG* i: variables)
+    for (size_t i=0; i<numEquationRows(); ++i)
       {
-        if (dynamic_cast<const IntegralInputVariableDAG*>(i)) continue;
-        if (i->type==VariableType::constant) continue;
-        RecordingSurface line;
-        variableRender(line,*i);
-        cairo_move_to(dest.cairo(), x, y-line.top());
-        variableRender(dest,*i);
-        y+=line.height()+4;
         cairo_move_to(dest.cairo(), x, y);
-       }
+        y+=renderEquationRow(dest, i);
+      }
+    cairo_move_to(dest.cairo(), x, y);
+  } 
 
-    for (const VariableDAG* i: integrationVariables)
+  double SystemOfEquations::renderEquationRow(Surface& dest, size_t row) const
+  {
+    double x, y; // top left of the row
+    cairo_get_current_point(dest.cairo(),&x,&y);
+    auto& vars=displayVariables();
+    if (row<vars.size())
       {
-        // initial conditions
-        y+=print(dest.cairo(), latexToPango(mathrm(i->name))+"(0) = "+
-                 latexToPango(MathDAG::latex(i->init)),Anchor::nw);
-        
-        // differential equation
-        Pango num(dest.cairo());
-        num.setMarkup("d"+latexToPango(mathrm(i->name)));
-        double lineSpacing=num.height()+den.height()+2;
-
-        VariableDAGPtr input=expressionCache.getIntegralInput(i->valueId);
-        if (input && input->rhs)
-          { // adjust linespacing to allow enough height for RHS
-          RecordingSurface rhs;
-          input->rhs->render(rhs);
-          lineSpacing = max(rhs.height(), lineSpacing);
-        }
+        RecordingSurface line;
+        variableRender(line,*vars[row]);
+        cairo_move_to(dest.cairo(), x, y-line.top());
+        variableRender(dest,*vars[row]);
+        return line.height()+4;
+      }
 
-        // vertical location of the = sign
-        double eqY=y+max(num.height(), 0.5*lineSpacing);
-
-        cairo_move_to(dest.cairo(), x, eqY-num.height());
-        num.show();
-        cairo_move_to(dest.cairo(), x, eqY);
-        double solidusLength = max(num.width(),den.width());
-        cairo_rel_line_to(dest.cairo(), solidusLength, 0);
-        cairo_stroke(dest.cairo());
-        cairo_move_to(dest.cairo(), x+solidusLength, eqY);
-        // display RHS here
-        if (input && input->rhs)
-          {
-            print(dest.cairo()," = ", Anchor::w);
-            input->rhs->render(dest);
-          }
-        else
-          print(dest.cairo()," = 0", Anchor::w);
-        cairo_move_to(dest.cairo(), x+0.5*(num.width()-den.width()), eqY);
-        den.show();
-        cairo_move_to(dest.cairo(), x, y+=lineSpacing);// move to next line
+    row-=vars.size();
+    const VariableDAG* i=integrationVariables.at(row/2);
+    if (row%2==0) // initial conditions
+      return print(dest.cairo(), latexToPango(mathrm(i->name))+"(0) = "+
+                   latexToPango(MathDAG::latex(i->init)),Anchor::nw);
         
+    // differential equation
+    Pango den(dest.cairo());
+    den.setMarkup("dt");
+    Pango num(dest.cairo());
+    num.setMarkup("d"+latexToPango(mathrm(i->name)));
+    double lineSpacing=num.height()+den.height()+2;
+
+    VariableDAGPtr input=expressionCache.getIntegralInput(i->valueId);
+    if (input && input->rhs)
+      { // adjust linespacing to allow enough height for RHS
+        RecordingSurface rhs;
+        input->rhs->render(rhs);
+        lineSpacing = max(rhs.height(), lineSpacing);
+      }
 
+    // vertical location of the = sign
+    double eqY=y+max(num.height(), 0.5*lineSpacing);
+
+    cairo_move_to(dest.cairo(), x, eqY-num.height());
+    num.show();
+    cairo_move_to(dest.cairo(), x, eqY);
+    double solidusLength = max(num.width(),den.width());
+    cairo_rel_line_to(dest.cairo(), solidusLength, 0);
+    cairo_stroke(dest.cairo());
+    cairo_move_to(dest.cairo(), x+solidusLength, eqY);
+    // display RHS here
+    if (input && input->rhs)
+      {
+        print(dest.cairo()," = ", Anchor::w);
+        input->rhs->render(dest);
       }
-  } 
+    else
+      print(dest.cairo()," = 0", Anchor::w);
+    cairo_move_to(dest.cairo(), x+0.5*(num.width()-den.width()), eqY);
+    den.show();
+    return lineSpacing;
+  }
 
   void ConstantDAG::render(ecolab::cairo::Surface& surf) const
   {
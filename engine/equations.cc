@@ -22,6 +22,7 @@
 #include "minsky.h"
 #include "str.h"
 #include "flowCoef.h"
+#include <sstream>
 #include <ecolab_epilogue.h>
 using namespace minsky;
 
@@ -70,8 +71,7 @@ namespace MathDAG
       NoArgument(const OperationPtr& s, unsigned a1, unsigned a2): 
         state(s), argNum1(a1), argNum2(a2) {}
       const char* what() const noexcept override {
-        if (state)
-          minsky::minsky().displayErrorItem(state->x(),state->y());
+        minsky::minsky().displayErrorItem(state);
         return ("missing argument "+str(argNum1)+","+str(argNum2)+
                 " on operation "+(state? state->name():string(""))).c_str();
       }
@@ -346,7 +346,7 @@ namespace MathDAG
           }
         if ((!ev.back()->state || ev.back()->state->type()==numOps) 
             && state && ev.back()->type()==state->type())
-          ev.back()->state=state;
+          ev.back()->setState(state);
       }
     if (type()!=integrate && r.isFlowVar() && r.idx()>=0 && result.idx()!=r.idx())
       ev.push_back(EvalOpPtr(copy, r, result));
@@ -1132,10 +1132,10 @@ namespace MathDAG
     map<string, VariableDAG*> integVarMap;
 
     // search through operations looking for integrals
-    minsky.model->recursiveDo
-      (&Group::items,
-       [&](const Items&, Items::const_iterator it){
-        if (IntOp* i=dynamic_cast<IntOp*>(it->get()))
+    minsky.model->forEachOfKind
+      (&GroupItems::operations,
+       [&](const shared_ptr<OperationBase>& it){
+        if (IntOp* i=dynamic_cast<IntOp*>(it.get()))
           {
             if (VariablePtr iv=i->intVar)
               {
@@ -1157,25 +1157,22 @@ namespace MathDAG
                   }
               }
           }
-        else if (const Constant* c=dynamic_cast<const Constant*>(it->get()))
+        else if (const Constant* c=dynamic_cast<const Constant*>(it.get()))
           {
             VariablePtr v(VariableType::parameter, c->description());
             // note makeDAG caches a reference to the object, and manages lifetime
             variables.push_back(makeDAG(*v).get());
             variables.back()->rhs=expressionCache.insertAnonymous(NodePtr(new ConstantDAG(c->value)));
           }
-        return false;
       });
 
     // process the Godley tables
     map<string, GodleyColumnDAG> godleyVars;
-    m.model->recursiveDo
-      (&Group::items,
-       [&](const Items&, Items::const_iterator i)
+    m.model->forEachOfKind
+      (&GroupItems::godleyIcons,
+       [&](const shared_ptr<GodleyIcon>& g)
        {
-         if (auto g=dynamic_cast<GodleyIcon*>(i->get()))
-           processGodleyTable(godleyVars, g->table/*, i->id()*/);
-         return false;
+         processGodleyTable(godleyVars, g->table/*, i->id()*/);
        });
 
     for (map<string, GodleyColumnDAG>::iterator g=godleyVars.begin(); 
@@ -1340,6 +1337,48 @@ namespace MathDAG
   }     
   
     
+  const vector<const VariableDAG*>& SystemOfEquations::displayVariables() const
+  {
+    if (!displayedVariablesValid)
+      {
+        displayedVariables.clear();
+        for (const VariableDAG* i: variables)
+          if (!dynamic_cast<const IntegralInputVariableDAG*>(i) &&
+              i->type!=VariableType::constant)
+            displayedVariables.push_back(i);
+        displayedVariablesValid=true;
+      }
+    return displayedVariables;
+  }
+
+  string SystemOfEquations::equationRowLatex(size_t i) const
+  {
+    ostringstream o;
+    auto& vars=displayVariables();
+    if (i<vars.size())
+      {
+        auto v=vars[i];
+        o << v->latex() << "=";
+        if (v->rhs) 
+          v->rhs->latex(o);
+        else
+          o<<MathDAG::latex(v->init);
+        return o.str();
+      }
+    i-=vars.size();
+    auto v=integrationVariables.at(i/2);
+    if (i%2==0)
+      o << mathrm(v->name)<<"(0)="<<MathDAG::latex(v->init);
+    else
+      {
+        o << "\\frac{ d " << mathrm(v->name) << "}{dt}=";
+        VariableDAGPtr input=expressionCache.getIntegralInput(v->valueId);
+        if (input && input->rhs)
+          input->rhs->latex(o);
+      }
+    return o.str();
+  }
+
   ostream& SystemOfEquations::latex(ostream& o) const
   {
     o << "\\begin{eqnarray*}\n";
@@ -1466,16 +1505,12 @@ namespace MathDAG
     assert(minsky.variableValues.validEntries());
 
     // ensure all variables have their output port's variable value up to date
-    minsky.model->recursiveDo
-      (&Group::items,
-       [&](Items&, Items::iterator i)
+    minsky.model->forEachOfKind
+      (&GroupItems::variables,
+       [&](const shared_ptr<VariableBase>& v)
        {
-         if (auto v=dynamic_cast<VariableBase*>(i->get()))
-           {
-             assert(minsky.variableValues.count(v->valueId()));
-             v->ports[0]->setVariableValue(minsky.variableValues[v->valueId()]);
-           }
-         return false;
+         assert(minsky.variableValues.count(v->valueId()));
+         v->ports[0]->setVariableValue(minsky.variableValues[v->valueId()]);
        });
        
 
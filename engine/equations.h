@@ -319,6 +319,11 @@ namespace MathDAG
 
     const Minsky& minsky;
 
+    /// variables given a row by renderEquations, built on first use
+    mutable vector<const VariableDAG*> displayedVariables;
+    mutable bool displayedVariablesValid=false;
+    const vector<const VariableDAG*>& displayVariables() const;
+
     /// create a variable DAG. returns cached value if previously called
     shared_ptr<VariableDAG> makeDAG(const string& valueId, const string& name, VariableType::Type type);
     shared_ptr<VariableDAG> makeDAG(VariableBase& v)
@@ -359,6 +364,17 @@ namespace MathDAG
 
     /// render equations into a cairo context
     void renderEquations(ecolab::cairo::Surface&) const;
+    /// number of rows drawn by renderEquations. Each integral has two:
+    /// its initial condition, and its derivative
+    size_t numEquationRows() const
+    {return displayVariables().size()+2*integrationVariables.size();}
+    /// LaTeX of row \a i of renderEquations, which determines how
+    /// the row is drawn
+    string equationRowLatex(size_t i) const;
+    /// render row \a i of renderEquations with its top left corner at
+    /// the current point
+    /// @return vertical distance to the next row
+    double renderEquationRow(ecolab::cairo::Surface&, size_t i) const;
   };
 
   /// creates a new name to represent the derivative of a variable
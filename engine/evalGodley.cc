@@ -18,6 +18,7 @@
 */
 
 #include "evalGodley.h"
+#include <cassert>
 #include <ecolab_epilogue.h>
 
 using namespace std;
@@ -59,37 +60,99 @@ namespace minsky
       }
   }
 
-  bool SharedColumnCheck::updateColDefs(const string& col, const FlowCoef& fc)
-  {
-    bool alreadySeen=sharedCol.count(col);
-    if (alreadySeen)
-      colDef[col][fc.name]-=fc.coef;
-    else
-      colDef[col][fc.name]+=fc.coef;
-    return alreadySeen;
-  }
-
   void SharedColumnCheck::checkSharedColDefs() const
   {
     // check that shared column definitions sum to zero
     for (set<string>::iterator i=sharedCol.begin(); i!=sharedCol.end(); ++i)
       {
-        const map<string, double>& cdef=colDef[*i];
-        for (map<string, double>::const_iterator j=cdef.begin(); 
-             j!=cdef.end(); ++j)
+        auto cdef=colDef.find(*i);
+        if (cdef==colDef.end()) continue;
+        for (map<int, double>::const_iterator j=cdef->second.begin(); 
+             j!=cdef->second.end(); ++j)
           if (abs(j->second)>1e-30)
-            throw error("column %s has mismatched flow %s",
-                        i->c_str(), j->first.c_str());
+            {
+              auto name=flowName.find(j->first);
+              throw error("column %s has mismatched flow %s", i->c_str(),
+                          name!=flowName.end()? name->second.c_str(): "");
+            }
       }
   }
 
-  void EvalGodley::eval(double sv[], const double fv[]) const
+  void EvalGodley::setEntries(const vector<int>& sidx, const vector<int>& fidx,
+                              const vector<double>& m)
   {
-    for (size_t i=0; i<initIdx.size(); ++i)
-      sv[initIdx[i]]=0;
+    // counting sort by stock, retaining table order within each row,
+    // so sums are accumulated in the same order as before
+    int rows=0;
+    for (int s: sidx) rows=max(rows, s+1);
+    vector<int> start(rows+1);
+    for (int s: sidx) start[s+1]++;
+    for (int i=0; i<rows; ++i) start[i+1]+=start[i];
 
+    this->rowStart.resize(rows+1);
+    for (int i=0; i<=rows; ++i) this->rowStart[i]=start[i];
+    this->fidx.resize(sidx.size());
+    this->m.resize(sidx.size());
     for (size_t i=0; i<sidx.size(); ++i)
-      sv[sidx[i]] += fv[fidx[i]] * m[i];
+      {
+        int j=start[sidx[i]]++;
+        this->fidx[j]=fidx[i];
+        this->m[j]=m[i];
+      }
+    resizeStocks(rows);
+  }
+
+  void EvalGodley::resizeStocks(size_t numStocks)
+  {
+    size_t rows=rowStart.size()? rowStart.size()-1: 0;
+    numStocks=max(numStocks, rows);
+    // stocks not appearing in any Godley table have empty rows
+    vector<int> start(numStocks+1, rows? rowStart[rows]: 0);
+    for (size_t i=0; i<rows; ++i) start[i]=rowStart[i];
+    rowStart.resize(numStocks+1);
+    for (size_t i=0; i<=numStocks; ++i) rowStart[i]=start[i];
+
+    copyIdx.resize(numStocks);
+    copyFromFlow.resize(numStocks);
+    for (size_t i=0; i<numStocks; ++i)
+      {
+        copyIdx[i]=-1;
+        copyFromFlow[i]=0;
+      }
+  }
+
+  void EvalGodley::setIntegral(size_t stock, int input, bool fromFlow)
+  {
+    assert(stock<copyIdx.size());
+    copyIdx[stock]=input;
+    copyFromFlow[stock]=fromFlow;
+  }
+
+  void EvalGodley::eval(double sv[], const double fv[]) const
+  {
+    for (size_t i=0; i+1<rowStart.size(); ++i)
+      if (rowStart[i]<rowStart[i+1])
+        {
+          double sum=0;
+          for (int j=rowStart[i]; j<rowStart[i+1]; ++j)
+            sum+=fv[fidx[j]]*m[j];
+          sv[i]=sum;
+        }
+  }
+
+  void EvalGodley::evalDerivatives(double result[], const double sv[], const double fv[]) const
+  {
+    for (size_t i=0; i<copyIdx.size(); ++i)
+      if (copyIdx[i]>=0)
+        // integrals are kind of a copy
+        result[i]=copyFromFlow[i]? fv[copyIdx[i]]: sv[copyIdx[i]];
+      else
+        {
+          double sum=0;
+          for (int j=rowStart[i]; j<rowStart[i+1]; ++j)
+            sum+=fv[fidx[j]]*m[j];
+          result[i]=sum;
+        }
   }
 
 //  template <>
@@ -27,6 +27,7 @@
 
 #include <ecolab.h>
 #include <arrays.h>
+#include <vector>
 
 namespace minsky
 {
@@ -34,12 +35,21 @@ namespace minsky
 
   class EvalGodley
   {
-    /// representation of matrix connecting flow variables to stock variables
-    ecolab::array<int> sidx, fidx;
+    /// matrix connecting flow variables to stock variables, in
+    /// compressed sparse row form: stock variable i is the sum of
+    /// fv[fidx[j]]*m[j] for j in [rowStart[i], rowStart[i+1])
+    ecolab::array<int> rowStart, fidx;
     ecolab::array<double> m;
 
-    /// index of stock variables that need to be zeroed at start of eval
-    ecolab::array<int> initIdx;
+    /// for each stock variable, the variable an integral copies into
+    /// it (-1 if none), and whether that is a flow variable
+    ecolab::array<int> copyIdx, copyFromFlow;
+
+    /// build the sparse rows from matrix entries in table order
+    void setEntries(const std::vector<int>& sidx, const std::vector<int>& fidx,
+                    const std::vector<double>& m);
+    void setIntegral(size_t stock, int input, bool fromFlow);
+    void resizeStocks(size_t numStocks);
 
     CLASSDESC_ACCESS(EvalGodley);
   public:
@@ -50,12 +60,24 @@ namespace minsky
     (const GodleyIterator& begin, const GodleyIterator& end, 
      const VariableValues& values);
 
+    /// set up evalDerivatives for \a numStocks stock variables, the
+    /// stocks of \a integrals being copied from their inputs rather
+    /// than computed from Godley tables. Unwired integrals are ignored.
+    template <class Integrals>
+    void fuseIntegrals(size_t numStocks, const Integrals& integrals);
+
     /// evaluate Godley tables on sv and current value of fv, storing
     /// result in output variable (of \a fv). \a sv is assume to be of
     /// size \c stockVars and \a fv is assumed to be of size \c
     /// flowVars.
     void eval(double sv[], const double fv[]) const;
 
+    /// compute the derivatives of all stock variables in a single
+    /// pass over \a result, from the Godley tables and integrals
+    /// given to fuseIntegrals. \a sv and \a fv are the stock and flow
+    /// variables the derivatives are computed from.
+    void evalDerivatives(double result[], const double sv[], const double fv[]) const;
+
     EvalGodley():  compatibility(false) {}
     /// if compatibility is true, then consttrainst between Godley
     /// tables is not applied, and shared columns are merely summed
@@ -75,8 +97,11 @@ namespace minsky
 
     int id() const {return it->id();}
 
-    /// Godley table data this points to
-    const std::vector<std::vector<std::string> >& data() const;
+    /// dimensions of the Godley table this points to
+    size_t rows() const;
+    size_t cols() const;
+    /// parsed cell of the Godley table. Row 0 names the stock variables
+    const FlowCoef& cell(size_t row, size_t col) const;
     const GodleyAssetClass::AssetClass assetClass(size_t col) const;
     bool signConventionReversed(int col) const;
     bool initialConditionRow(int row) const;
@@ -101,14 +126,12 @@ namespace minsky
     /// has, whether it is allowed to be shared by business rules
     void checkShared(const string& name, AssetClass ac);
 
-    /// store the sum of flow var contributions for each colum
-    /// here. Used for checking that shared column definitions are
-    /// equivalent
-    ConstMap<string, std::map<string, double> > colDef;
-
-    /// update col defs, give column name, and flow variable entry
-    /// @return true if col has been seen before
-    bool updateColDefs(const string& col, const FlowCoef& fc);
+    /// store the sum of flow var contributions, by flow variable
+    /// index, for each column here. Used for checking that shared
+    /// column definitions are equivalent
+    std::map<string, std::map<int, double> > colDef;
+    /// valueIds of the flow variables referred to in colDef
+    std::map<int, string> flowName;
 
     /// check shared columns are equivalently defined
     void checkSharedColDefs() const;
@@ -120,54 +143,92 @@ namespace minsky
      const VariableValues& values)
   {
     SharedColumnCheck scCheck;
-    sidx.resize(0);
-    fidx.resize(0);
-    m.resize(0);
-
-    std::set<int> iidx;
+    // matrix entries in table order
+    std::vector<int> sidx, fidx;
+    std::vector<double> m;
 
     for (GodleyIterator g=begin; g!=end; ++g)
       {
-        if (g.data().empty()) continue;
-        // check for shared columns
-        if (!compatibility)
-          for (size_t col=1; col<g.data()[0].size(); ++col)
-            scCheck.checkShared(g.valueId(trimWS(g.data()[0][col])), g.assetClass(col));
+        if (g.rows()==0) continue;
+
+        // stock variable of each column, resolved once per column
+        struct Column
+        {
+          int stock=-1;
+          double sign=1;
+          /// shared column definition, unless in compatibility mode
+          std::map<int, double>* def=nullptr;
+          bool shared=false;
+        };
+        std::vector<Column> columns(g.cols());
+        std::vector<string> svNames(g.cols());
+        for (size_t col=1; col<g.cols(); ++col)
+          {
+            svNames[col]=g.valueId(g.cell(0,col).name);
+            // check for shared columns
+            if (!compatibility)
+              scCheck.checkShared(svNames[col], g.assetClass(col));
+          }
+        for (size_t col=1; col<g.cols(); ++col)
+          {
+            Column& c=columns[col];
+            c.stock=values[svNames[col]].idx();
+            if (g.signConventionReversed(col)) c.sign=-1;
+            if (!compatibility)
+              {
+                c.def=&scCheck.colDef[svNames[col]];
+                c.shared=scCheck.sharedCol.count(svNames[col]);
+              }
+          }
+
+        // flow variable indices, resolved once per name, as they
+        // depend only on the table's scope
+        std::map<string, int> flows;
 
-        for (size_t row=1; row<g.data().size(); ++row)
+        for (size_t row=1; row<g.rows(); ++row)
           if (!g.initialConditionRow(row))
-            for (size_t col=1; col<g.data()[row].size(); ++col)
+            for (size_t col=1; col<g.cols(); ++col)
               {
-                FlowCoef fvc(g.data()[row][col]);
-                fvc.name=g.valueId(fvc.name);
-                if (g.signConventionReversed(col)) fvc.coef*=-1;
-                string svName(g.valueId(trimWS(g.data()[0][col])));
+                const FlowCoef& fc=g.cell(row,col);
+                const Column& c=columns[col];
+                if (fc.name.empty() || c.stock<0) continue;
+                auto f=flows.find(fc.name);
+                if (f==flows.end())
+                  {
+                    string fvName=g.valueId(fc.name);
+                    f=flows.insert
+                      (make_pair(fc.name, values[g.valueId(fvName)].idx())).first;
+                    if (f->second>=0)
+                      scCheck.flowName[f->second]=fvName;
+                  }
+                if (f->second<0) continue;
+                double coef=c.sign*fc.coef;
 
-                if (!fvc.name.empty() && !svName.empty())
+                // check for compatible column definitions
+                if (c.def)
                   {
-                    const VariableValue& fv=values[g.valueId(fvc.name)];
-                    const VariableValue& sv=values[svName];
-                    if (fv.idx()>=0 && sv.idx()>=0)
-                      {
-                        // check for compatible column definitions
-                        if (!compatibility && 
-                            scCheck.updateColDefs(svName, fvc))
-                          continue;
-                
-                        iidx.insert(sv.idx());
-                        sidx<<=sv.idx();
-                        fidx<<=fv.idx();
-                        m<<=fvc.coef;
-                      }
+                    (*c.def)[f->second]+= c.shared? -coef: coef;
+                    if (c.shared) continue;
                   }
+                
+                sidx.push_back(c.stock);
+                fidx.push_back(f->second);
+                m.push_back(coef);
               }
       }
     
-    for (std::set<int>::iterator i=iidx.begin(); i!=iidx.end(); ++i)
-      initIdx<<=*i;
-
     if (!compatibility)
       scCheck.checkSharedColDefs();
+    setEntries(sidx, fidx, m);
+  }
+
+  template <class Integrals>
+  void EvalGodley::fuseIntegrals(size_t numStocks, const Integrals& integrals)
+  {
+    resizeStocks(numStocks);
+    for (auto& i: integrals)
+      if (i.stock.idx()>=0 && i.input.idx()>=0)
+        setIntegral(i.stock.idx(), i.input.idx(), i.input.isFlowVar());
   }
                    
 }
@@ -61,8 +61,7 @@ namespace minsky
       }
     if (!isfinite(fv[out]))
       {
-        if (state)
-          minsky().displayErrorItem(*state);
+        minsky().displayErrorItem(state);
         string msg="Invalid: "+OperationBase::typeName(type())+"(";
         if (numArgs()>0)
           msg+=str(flow1? fv[in1]: sv[in1]);
@@ -115,7 +114,7 @@ namespace minsky
   {return value;}
   template <>
   double EvalOp<OperationType::constant>::evaluate(double in1, double in2) const
-  {return dynamic_cast<Constant&>(*state).value;}
+  {throw error("constants are evaluated by ConstantEvalOp");}
   template <>
   double EvalOp<OperationType::constant>::d1(double x1, double x2) const
   {return 0;}
@@ -123,7 +122,7 @@ namespace minsky
   double EvalOp<OperationType::constant>::d2(double x1, double x2) const
   {return 0;}
 
-  double EvalOpBase::t;
+  thread_local double EvalOpBase::t;
 
   template <>
   double EvalOp<OperationType::time>::evaluate(double in1, double in2) const
@@ -169,10 +168,10 @@ namespace minsky
 
   template <> double 
   EvalOp<OperationType::data>::evaluate(double in1, double in2) const
-  {return state? dynamic_cast<DataOp&>(*state).interpolate(in1): 0;}
+  {throw error("data operations are evaluated by DataEvalOp");}
   template <> 
   double EvalOp<OperationType::data>::d1(double x1, double x2) const
-  {return state? dynamic_cast<DataOp&>(*state).deriv(x1): 0;}
+  {throw error("data operations are evaluated by DataEvalOp");}
   template <> 
   double EvalOp<OperationType::data>::d2(double x1, double x2) const
   {return 0;}
@@ -487,6 +486,8 @@ namespace minsky
       {
       case constant:
         return new ConstantEvalOp(out,in1,in2,flow1,flow2);
+      case data:
+        return new DataEvalOp(out,in1,in2,flow1,flow2);
       case numOps:
         return NULL;
       default:
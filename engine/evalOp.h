@@ -51,16 +51,21 @@ namespace minsky
   {
     typedef OperationType::Type Type;
 
-    // value used for the time operator
-    static double t;
+    /// value used for the time operator. Thread local, so that
+    /// scenario branches can be evaluated concurrently
+    static thread_local double t;
 
     /// indexes into the Godley variables vector
     int out, in1, in2;
     ///indicate whether in1/in2 are flow variables (out is always a flow variable)
     bool flow1, flow2; 
 
-    /// state data (for those ops that need it)
+    /// the operation this evaluates, for reporting errors on the GUI
+    /// thread. Evaluation must not read it, as the GUI may edit it
+    /// while the solver thread runs
     std::shared_ptr<OperationBase> state;
+    /// set state, copying any data evaluation needs from it
+    virtual void setState(const std::shared_ptr<OperationBase>& s) {state=s;}
     EvalOpBase(int out=0, int in1=0, int in2=0, 
                bool flow1=true, bool flow2=true): 
       out(out), in1(in1), in2(in2), flow1(flow1), flow2(flow2) 
@@ -138,6 +143,24 @@ namespace minsky
     double evaluate(double in1=0, double in2=0) const override;
    };
 
+  struct DataEvalOp: public EvalOp<minsky::OperationType::data>
+  {
+    /// copy of the data of the DataOp state
+    std::map<double, double> data;
+    DataEvalOp(int out=0, int in1=0, int in2=0, 
+               bool flow1=true, bool flow2=true): 
+      EvalOp<OperationType::data>(out,in1,in2,flow1,flow2) {}
+    void setState(const std::shared_ptr<OperationBase>& s) override {
+      EvalOpBase::setState(s);
+      if (auto d=dynamic_cast<const DataOp*>(s.get()))
+        data=d->data;
+    }
+    double evaluate(double in1=0, double in2=0) const override
+    {return DataOp::interpolate(data, in1);}
+    double d1(double x1=0, double x2=0) const override
+    {return DataOp::deriv(data, x1);}
+  };
+
   struct EvalOpPtr: public classdesc::shared_ptr<EvalOpBase>, 
                     public OperationType
   {
@@ -19,6 +19,8 @@
 
 #include "latexMarkup.h"
 #include <map>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
@@ -830,9 +832,9 @@ namespace
   };
 }
 
-namespace minsky
+namespace
 {
-  string latexToPango(const char* input)
+  string convert(const char* input)
   {
     Result r("<i>");
     while (*input!='\0')
@@ -863,5 +865,21 @@ namespace minsky
     while (!r.stack.empty()) r.pop();
     return r+"</i>";
   }
+}
 
+namespace minsky
+{
+  string latexToPango(const char* input)
+  {
+    // labels are converted each time they are drawn, so conversions
+    // are memoised. Plots may be drawn on other threads.
+    static mutex memoMutex;
+    static unordered_map<string,string> memo;
+    static const size_t maxMemo=1<<16;
+    lock_guard<mutex> lock(memoMutex);
+    auto i=memo.find(input);
+    if (i!=memo.end()) return i->second;
+    if (memo.size()>=maxMemo) memo.clear();
+    return memo.emplace(input, convert(input)).first->second;
+  }
 }
@@ -26,6 +26,7 @@ namespace minsky
   std::string latexToPango(const char*);
   /// interprets LaTeX sequences within, returning result as UTF-8
   /// containing Pango markup. Only a small subset of LaTeX is implemented.
+  /// Results are memoised.
   inline std::string latexToPango(const std::string& x) 
   {return latexToPango(x.c_str());}
 }
@@ -0,0 +1,103 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "logWriter.h"
+#include <error.h>
+#include <chrono>
+
+using namespace std;
+
+namespace minsky
+{
+  LogWriter::LogWriter(const string& fileName, const vector<string>& columns,
+                       size_t bufferSize, bool dropWhenFull):
+    out(fileName), m_fileName(fileName), queue(bufferSize>0? bufferSize: 1), dropWhenFull(dropWhenFull)
+  {
+    if (!out)
+      throw ecolab::error("unable to open log file %s",fileName.c_str());
+    out<<"#time";
+    for (auto& c: columns)
+      out<<" "<<c;
+    out<<"\n";
+    writer=thread([this]{run();});
+  }
+
+  void LogWriter::close()
+  {
+    running=false;
+    dataAvailable.notify_one();
+    if (writer.joinable())
+      writer.join();
+  }
+
+  void LogWriter::push(vector<double>& record)
+  {
+    if (!queue.push(record))
+      {
+        if (dropWhenFull)
+          {
+            m_dropped++;
+            return;
+          }
+        m_stalls++;
+        dataAvailable.notify_one();
+        // sleep until the writer has made room. The timeout guards
+        // against a wakeup lost between the writer's pop and its test
+        // of producerWaiting
+        unique_lock<std::mutex> lock(mutex);
+        producerWaiting=true;
+        while (!queue.push(record))
+          spaceAvailable.wait_for(lock, chrono::milliseconds(10));
+        producerWaiting=false;
+      }
+    dataAvailable.notify_one();
+  }
+
+  void LogWriter::run()
+  {
+    vector<double> record;
+    for (;;)
+      {
+        while (queue.pop(record))
+          {
+            if (record.empty()) continue;
+            out<<record[0];
+            for (size_t i=1; i<record.size(); ++i)
+              out<<" "<<record[i];
+            out<<"\n";
+            m_written++;
+            if (producerWaiting)
+              {
+                lock_guard<std::mutex> lock(mutex);
+                spaceAvailable.notify_one();
+              }
+          }
+        if (!running && queue.empty())
+          break;
+        // flush when idle, rather than on every line
+        out.flush();
+        if (!out) m_failed=true;
+        unique_lock<std::mutex> lock(mutex);
+        dataAvailable.wait_for(lock, chrono::milliseconds(50), [this]{
+            return !queue.empty() || !running;});
+      }
+    out.flush();
+    if (!out) m_failed=true;
+  }
+}
@@ -0,0 +1,86 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+#include "ringBuffer.h"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace minsky
+{
+  /**
+     Writes simulation records to a log file on a background thread,
+     so that file I/O does not block the integration loop.
+
+     Records are passed through a bounded single producer/single
+     consumer queue. If the writer falls behind, the producer either
+     waits for space (backpressure) or discards the record, according
+     to \a dropWhenFull.
+  */
+  class LogWriter
+  {
+    std::ofstream out;
+    std::string m_fileName;
+    RingBuffer<std::vector<double> > queue;
+    bool dropWhenFull;
+    std::atomic<size_t> m_stalls{0}, m_dropped{0}, m_written{0};
+    std::atomic<bool> running{true}, m_failed{false};
+    /// true while the producer is blocked on a full queue
+    std::atomic<bool> producerWaiting{false};
+    std::mutex mutex;
+    std::condition_variable dataAvailable, spaceAvailable;
+    std::thread writer;
+    void run();
+  public:
+    /// opens \a fileName and writes a header line naming each column
+    /// @throw ecolab::error if the file cannot be opened
+    LogWriter(const std::string& fileName, const std::vector<std::string>& columns,
+              size_t bufferSize, bool dropWhenFull);
+    /// flushes all queued records before returning
+    ~LogWriter() {close();}
+    LogWriter(const LogWriter&)=delete;
+    void operator=(const LogWriter&)=delete;
+
+    /// queue \a record for writing. \a record is swapped into the
+    /// queue, and is returned holding recycled storage
+    void push(std::vector<double>& record);
+    /// write all queued records and stop the writer thread, after
+    /// which failed() reports whether every record was written
+    void close();
+
+    /// number of records waiting to be written
+    size_t queueDepth() const {return queue.size();}
+    /// number of times the producer had to wait for the writer
+    size_t stalls() const {return m_stalls;}
+    /// number of records discarded because the queue was full
+    size_t dropped() const {return m_dropped;}
+    /// number of records written to file
+    size_t written() const {return m_written;}
+    /// true if an I/O error occurred on the writer thread
+    bool failed() const {return m_failed;}
+    const std::string& fileName() const {return m_fileName;}
+  };
+}
+
+#endif
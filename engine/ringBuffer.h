@@ -0,0 +1,91 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <stddef.h>
+
+namespace minsky
+{
+  /**
+     A bounded, lock-free queue for exactly one producer thread and
+     one consumer thread.
+
+     Elements are exchanged by swapping rather than copying, so a
+     producer pushing a std::vector gets back whatever storage the
+     consumer previously left in that slot. In steady state, no
+     allocation takes place on either side.
+  */
+  template <class T>
+  class RingBuffer
+  {
+    std::vector<T> buffer;
+    /// next slot to be written (owned by the producer)
+    std::atomic<size_t> head{0};
+    /// next slot to be read (owned by the consumer)
+    std::atomic<size_t> tail{0};
+    size_t next(size_t i) const {return i+1==buffer.size()? 0: i+1;}
+  public:
+    /// one slot is sacrificed to distinguish full from empty
+    explicit RingBuffer(size_t capacity): buffer(capacity+1) {}
+    RingBuffer(const RingBuffer&)=delete;
+    void operator=(const RingBuffer&)=delete;
+
+    size_t capacity() const {return buffer.size()-1;}
+
+    /// number of elements currently queued. Only approximate if
+    /// called while the other side is active.
+    size_t size() const {
+      size_t h=head.load(std::memory_order_acquire),
+        t=tail.load(std::memory_order_acquire);
+      return h>=t? h-t: h+buffer.size()-t;
+    }
+    bool empty() const {
+      return head.load(std::memory_order_acquire)==
+        tail.load(std::memory_order_acquire);
+    }
+
+    /// producer side: swap \a x into the queue.
+    /// @return false (leaving \a x untouched) if the queue is full
+    bool push(T& x) {
+      size_t h=head.load(std::memory_order_relaxed), n=next(h);
+      if (n==tail.load(std::memory_order_acquire))
+        return false;
+      std::swap(buffer[h], x);
+      head.store(n, std::memory_order_release);
+      return true;
+    }
+
+    /// consumer side: swap the oldest element into \a x
+    /// @return false (leaving \a x untouched) if the queue is empty
+    bool pop(T& x) {
+      size_t t=tail.load(std::memory_order_relaxed);
+      if (t==head.load(std::memory_order_acquire))
+        return false;
+      std::swap(x, buffer[t]);
+      tail.store(next(t), std::memory_order_release);
+      return true;
+    }
+  };
+}
+
+#endif
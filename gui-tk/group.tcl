@@ -216,8 +216,8 @@ namespace eval group {
         set angle [radian [wiringGroup.group.rotation]]
         set rx [expr $scalex*cos($angle)-$scaley*sin($angle)]
         set ry [expr $scalex*sin($angle)+$scaley*cos($angle)]
-        wiringGroup.group.width [expr abs($rx*[wiringGroup.group.width])]
-        wiringGroup.group.height [expr abs($ry*[wiringGroup.group.height])]
+        wiringGroup.group.resize [expr abs($rx*[wiringGroup.group.width])] \
+            [expr abs($ry*[wiringGroup.group.height])]
         wiringGroup.group.computeDisplayZoom
         wiringGroup.group.set
         .wiring.canvas delete group$id
@@ -211,6 +211,9 @@ set preferencesVars {
         "+/-" sign } 
     nRecentFiles          "Number of recent files to display" 10 text
     wrapLaTeXLines        "Wrap long equations in LaTeX export" 1 bool
+    threadedSimulation    "Run simulation in background thread" 1 bool
+    storeEquations        "Save compiled equations alongside model" 0 bool
+    defaultFont           "Label font family (blank for default)" "" text
 }
 
 foreach {var text default type} $preferencesVars {
@@ -219,6 +222,8 @@ foreach {var text default type} $preferencesVars {
         set preferences($var) $default
     }
 }
+minsky.storeEquations $preferences(storeEquations)
+minsky.defaultFont $preferences(defaultFont)
             
 proc showPreferences {} {
     global preferences_input preferences preferencesVars
@@ -385,7 +390,7 @@ proc exportCanvas {} {
     global workDir type fname preferences
 
     set f [tk_getSaveFile -filetypes {
-        {"SVG" svg TEXT} {"PDF" pdf TEXT} {"Postscript" eps TEXT} {"LaTeX" tex TEXT} {"Matlab" m TEXT}} \
+        {"SVG" svg TEXT} {"PDF" pdf TEXT} {"Postscript" eps TEXT} {"PNG" png} {"LaTeX" tex TEXT} {"Matlab" m TEXT}} \
                -initialdir $workDir -typevariable type -initialfile [file rootname [file tail $fname]]]  
     if {$f==""} return
     if [string match -nocase *.svg "$f"] {
@@ -394,6 +399,8 @@ proc exportCanvas {} {
         minsky.renderCanvasToPDF "$f"
     } elseif {[string match -nocase *.ps "$f"] || [string match -nocase *.eps "$f"]} {
         minsky.renderCanvasToPS "$f"
+    } elseif {[string match -nocase *.png "$f"]} {
+        minsky.renderCanvasToPNG "$f" 1
     } elseif {[string match -nocase *.tex "$f"]} {
         latex "$f" $preferences(wrapLaTeXLines)
     } elseif {[string match -nocase *.m "$f"]} {
@@ -403,6 +410,7 @@ proc exportCanvas {} {
             "*(svg)" {minsky.renderCanvasToSVG  "$f.svg"}
             "*(pdf)" {minsky.renderCanvasToPDF "$f.pdf"}
             "*(eps)" {minsky.renderCanvasToPS "$f.eps"}
+            "*(png)" {minsky.renderCanvasToPNG "$f.png" 1}
             "*(tex)" {latex "$f.tex" $preferences(wrapLaTeXLines)}
             "*(m)" {matlab "$f.m"}
         }
@@ -544,14 +552,16 @@ set delay [simulationDelay]
 set running 0
 
 proc runstop {} {
-  global running classicMode
+  global running classicMode preferences recordingReplay
   if {$running} {
     set running 0
+    stopSimulation
     if {$classicMode} {
             .controls.run configure -text run
         } else {
             .controls.run configure -image runButton
         }
+      flushPlotFrames
       updateCanvas
   } else {
     set running 1
@@ -561,10 +571,33 @@ proc runstop {} {
         } else {
              .controls.run configure -image stopButton
         }
-    simulate
+    if {$preferences(threadedSimulation) && !$recordingReplay} {
+        if {[catch startSimulation errMsg options]} {
+            runstop
+            return -options $options $errMsg
+        }
+        syncSimulationLoop
+    } else {
+        simulate
+    }
  }
 }
 
+# update the display from a simulation running in the background
+proc syncSimulationLoop {} {
+    global running
+    if {$running} {
+        set lastt [t]
+        if {[catch syncSimulation errMsg options]} {
+            runstop
+            return -options $options $errMsg
+        }
+        .controls.statusbar configure -text "t: [t] Δt: [format %g [expr [t]-$lastt]]"
+        updateGodleysDisplay
+        after 40 syncSimulationLoop
+    }
+}
+
 proc step {} {
     global recordingReplay eventRecordR
     if {$recordingReplay} {
@@ -613,7 +646,10 @@ proc reset {} {
     } else {
         set tstep 0
         set simLogging 0
-        closeLogFile
+        stopSimulation
+        if {[catch closeLogFile err]} {
+            tk_messageBox -icon error -message "Logging failed" -detail $err -type ok
+        }
         # delay throwing exception to allow display to be updated
         set err [catch minsky.reset result]
         .controls.statusbar configure -text "t: 0 Δt: 0"
@@ -658,7 +694,7 @@ populateRecentFiles
 proc openFile {} {
     global fname workDir preferences
     set ofname [tk_getOpenFile -multiple 1 -filetypes {
-	    {Minsky {.mky}} {XML {.xml}} {All {.*}}} -initialdir $workDir]
+	    {Minsky {.mky .mkyb}} {XML {.xml}} {All {.*}}} -initialdir $workDir]
     if [string length $ofname] {openNamedFile $ofname}
 }
 
@@ -689,10 +725,15 @@ proc openNamedFile {ofname} {
 proc insertFile {} {
     global workDir
     set fname [tk_getOpenFile -multiple 1 -filetypes {
-	    {Minsky {.mky}} {XML {.xml}} {All {.*}}} -initialdir $workDir]
+	    {Minsky {.mky .mkyb}} {XML {.xml}} {All {.*}}} -initialdir $workDir]
     insertNewGroup [insertGroupFromFile $fname]
 }
 
+# supplies the clipboard to other applications, when requested
+proc minskyClipboardData {offset maxChars} {
+    return [minsky.clipboardChunk $offset $maxChars]
+}
+
 proc insertNewGroup {gid} {
     newGroupItem $gid
 
@@ -734,15 +775,38 @@ proc save {} {
     if {![string length $fname]} {
 	    setFname [tk_getSaveFile -defaultextension .mky]}            
     if [string length $fname] {
-        minsky.save $fname
+        saveInBackground $fname
     }
 }
 
 proc saveAs {} {
     global fname workDir
-    setFname [tk_getSaveFile -defaultextension .mky -initialdir $workDir]
+    setFname [tk_getSaveFile -defaultextension .mky -initialdir $workDir -filetypes {
+        {Minsky {.mky}} {{Minsky binary} {.mkyb}} {All {.*}}}]
     if [string length $fname] {
-        minsky.save $fname
+        saveInBackground $fname
+    }
+}
+
+# write the model on a background thread, reporting any failure once
+# it completes
+proc saveInBackground {fname} {
+    minsky.saveInBackground $fname
+    after 100 checkBackgroundSave
+}
+
+proc checkBackgroundSave {} {
+    if [minsky.saveInProgress] {
+        after 100 checkBackgroundSave
+        return
+    }
+    reportSaveError
+}
+
+proc reportSaveError {} {
+    set err [minsky.takeSaveError]
+    if [string length $err] {
+        tk_messageBox -icon error -message "Save failed" -detail $err -type ok
     }
 }
 
@@ -866,6 +930,11 @@ proc setPreferenceParms {} {
     foreach var [array names preferences_input] {
 	set preferences($var) $preferences_input($var)
     }
+    minsky.storeEquations $preferences(storeEquations)
+    if {$preferences(defaultFont)!=[minsky.defaultFont]} {
+        minsky.defaultFont $preferences(defaultFont)
+        rebuildCanvas
+    }
 }
 
 
@@ -1007,11 +1076,18 @@ proc deleteSubsidiaryTopLevels {} {
 }
 
 proc exit {} {
-    # check if the model has been saved yet
-    if [edited] {
+    # complete any saves still being written. A failed save leaves
+    # the model edited, so the user is offered the chance to save again
+    minsky.waitForSave
+    reportSaveError
+    while {[edited]} {
         switch [tk_messageBox -message "Save before exiting?" -type yesnocancel] {
-            yes save
-            no {}
+            yes {
+                save
+                minsky.waitForSave
+                reportSaveError
+            }
+            no break
             cancel {return -level [info level]}
         }
     }
@@ -1031,7 +1107,7 @@ proc exit {} {
         puts $rc "set canvasHeight [winfo height .wiring.canvas]"
         puts $rc "set backgroundColour $backgroundColour"
         foreach p [array names preferences] {
-            puts $rc "set preferences($p) $preferences($p)"
+            puts $rc [list set preferences($p) $preferences($p)]
         }
         puts $rc "set recentFiles \{$recentFiles\}"
         close $rc
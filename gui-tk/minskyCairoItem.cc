@@ -68,7 +68,7 @@ namespace
                                  CAIRO_FONT_WEIGHT_NORMAL);
           cairo_set_font_size(cairo,12);
           cairo_set_line_width(cairo,1);
-          op->draw(cairo);
+          op->drawCached(cairo);
         }
     }
   };
@@ -99,6 +99,11 @@ namespace minsky
       t->is_const=true;
      if (auto t=getCommandData("minsky.resetNotNeeded"))
       t->is_const=true;
+    // clipboard operations do not modify the model
+    if (auto t=getCommandData("minsky.copy"))
+      t->is_const=true;
+    if (auto t=getCommandData("minsky.clipboardLost"))
+      t->is_const=true;
  }
 
 
@@ -187,6 +192,21 @@ namespace minsky
 #endif
     }
 
+    bool MinskyTCL::claimClipboard()
+    {
+#if defined(MAC_OSX_TK) || defined(_WIN32)
+      // no means of supplying the clipboard on demand
+      return false;
+#else
+      // X11 requests the data from the owner when pasted, which is
+      // supplied by the minskyClipboardData handler
+      tclcmd()<<"selection handle -selection CLIPBOARD -type UTF8_STRING . minskyClipboardData\n"
+        "selection handle -selection CLIPBOARD -type STRING . minskyClipboardData\n"
+        "selection own -selection CLIPBOARD -command minsky.clipboardLost .\n";
+      return true;
+#endif
+    }
+
   void MinskyTCL::latex(const char* filename, bool wrapLaTeXLines) 
   {
     if (cycleCheck()) throw error("cyclic network detected");
@@ -118,6 +118,7 @@ namespace minsky
       
     void putClipboard(const std::string& s) const override; 
     std::string getClipboard() const override; 
+    bool claimClipboard() override;
 
     std::set<string> matchingTableColumns(int currTable, GodleyAssetClass::AssetClass ac) {
       auto it=items.find(currTable);
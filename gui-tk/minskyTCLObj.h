@@ -33,12 +33,38 @@ namespace minsky
   inline string to_string(CONST84 char* x) {return x;}
   inline string to_string(Tcl_Obj* x) {return Tcl_GetString(x);}
 
+  /// true if \a cmd changes the equations, integrator or its
+  /// parameters, which are shared with a running solver thread
+  inline bool changesSolverState(const string& cmd, int argc)
+  {
+    static const char* commands[]={
+      "minsky.step","minsky.reset","minsky.constructEquations",
+      "minsky.load","minsky.clearAllMaps","minsky.undo",
+      "minsky.restoreCheckpoint","minsky.runScenarios"};
+    static const char* parameters[]={
+      "minsky.stepMin","minsky.stepMax","minsky.nSteps","minsky.epsAbs",
+      "minsky.epsRel","minsky.order","minsky.implicit","minsky.simulationDelay"};
+    for (auto c: commands)
+      if (cmd==c) return true;
+    // setters only
+    if (argc>1)
+      for (auto c: parameters)
+        if (cmd==c) return true;
+    return false;
+  }
+
   // a hook for recording when the minsky model's state changes
   template <class AV>
   void member_entry_hook(int argc, AV argv)
   {
     string argv0=to_string(argv[0]);
     MinskyTCL& m=static_cast<MinskyTCL&>(minsky());
+    // stop a background simulation before commands that replace
+    // state the solver thread reads. Other edits may run alongside
+    // it, as the equations hold copies of the constants and data they
+    // evaluate, and are caught below.
+    if (m.simulationRunning() && changesSolverState(argv0, argc))
+      m.pauseSimulation();
     if (m.doPushHistory && argv0!="wiringGroup.adjustWires" && 
         argv0!="minsky.availableOperations" &&
         argv0!="minsky.clearAll" &&
@@ -51,6 +77,7 @@ namespace minsky
         argv0!="minsky.setGodleyIconResource" &&
         argv0!="minsky.setGroupIconResource" &&
         argv0!="minsky.step" &&
+        argv0!="minsky.syncSimulation" &&
         argv0.find(".get")==string::npos && 
         argv0.find(".mouseFocus")==string::npos
         )
@@ -62,6 +89,8 @@ namespace minsky
             if (m.pushHistoryIfDifferent())
               {
                 if (argv0!="minsky.load") m.markEdited();
+                // restarting the solver picks up the edit
+                m.pauseSimulation();
                 if (m.eventRecord.get() && argv0=="minsky.startRecording")
                   {
                     for (int i=0; i<argc; ++i)
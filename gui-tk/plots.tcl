@@ -259,8 +259,8 @@ namespace eval plot {
         set scalex [expr 2*abs($x-[plot.x])/double([plot.width])]
         set scaley [expr 2*abs($y-[plot.y])/double([plot.height])]
         # compute rotated scale factors
-        plot.width [expr int(ceil(abs($scalex*[plot.width])))]
-        plot.height [expr int(ceil(abs($scaley*[plot.height])))]
+        plot.resize [expr int(ceil(abs($scalex*[plot.width])))] \
+            [expr int(ceil(abs($scaley*[plot.height])))]
 
         redraw $id
         bind .wiring.canvas <Motion> {}
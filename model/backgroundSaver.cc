@@ -0,0 +1,145 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "backgroundSaver.h"
+#include <error.h>
+#include <cstdio>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <ecolab_epilogue.h>
+using namespace std;
+
+namespace minsky
+{
+  BackgroundSaver::~BackgroundSaver()
+  {
+    {
+      lock_guard<std::mutex> lock(mutex);
+      shutdown=true;
+    }
+    jobReady.notify_all();
+    if (thread.joinable()) thread.join();
+  }
+
+  void BackgroundSaver::writeAtomically(const string& fileName, const Writer& write)
+  {
+    string tmp=fileName+".tmp";
+    try
+      {
+        write(tmp);
+      }
+    catch (...)
+      {
+        remove(tmp.c_str());
+        throw;
+      }
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows, but
+    // MoveFileEx can do so atomically
+    if (!MoveFileExA(tmp.c_str(), fileName.c_str(),
+                     MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH))
+#else
+    if (rename(tmp.c_str(), fileName.c_str())!=0)
+#endif
+      {
+        remove(tmp.c_str());
+        throw ecolab::error("cannot save to %s",fileName.c_str());
+      }
+  }
+
+  void BackgroundSaver::submit(const string& fileName, Job job)
+  {
+    {
+      lock_guard<std::mutex> lock(mutex);
+      bool superseded=false;
+      for (auto& j: jobs)
+        if (j.fileName==fileName)
+          {
+            j.job=std::move(job);
+            superseded=true;
+          }
+      if (!superseded)
+        {
+          Queued q;
+          q.fileName=fileName;
+          q.job=std::move(job);
+          jobs.push_back(std::move(q));
+        }
+      if (!thread.joinable())
+        thread=std::thread([this]{run();});
+    }
+    jobReady.notify_one();
+  }
+
+  bool BackgroundSaver::busy() const
+  {
+    lock_guard<std::mutex> lock(mutex);
+    return running || !jobs.empty();
+  }
+
+  void BackgroundSaver::wait()
+  {
+    unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this]{return !running && jobs.empty();});
+  }
+
+  bool BackgroundSaver::takeResult(Result& r)
+  {
+    lock_guard<std::mutex> lock(mutex);
+    if (results.empty()) return false;
+    r=std::move(results.front());
+    results.pop_front();
+    return true;
+  }
+
+  void BackgroundSaver::run()
+  {
+    unique_lock<std::mutex> lock(mutex);
+    for (;;)
+      {
+        // drain the queue before honouring shutdown, so saves are not lost
+        jobReady.wait(lock, [this]{return shutdown || !jobs.empty();});
+        if (jobs.empty()) return;
+        Queued q=std::move(jobs.front());
+        jobs.pop_front();
+        running=true;
+        lock.unlock();
+
+        Result r;
+        r.fileName=q.fileName;
+        try
+          {
+            q.job(q.fileName);
+          }
+        catch (const std::exception& e)
+          {
+            r.error=e.what();
+          }
+        catch (...)
+          {
+            r.error="unknown error saving "+q.fileName;
+          }
+
+        lock.lock();
+        running=false;
+        results.push_back(std::move(r));
+        jobDone.notify_all();
+      }
+  }
+}
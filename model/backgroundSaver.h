@@ -0,0 +1,95 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BACKGROUNDSAVER_H
+#define BACKGROUNDSAVER_H
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace minsky
+{
+  /**
+     Writes files on a separate thread.
+
+     Each job works from a self contained snapshot of what is to be
+     written, so the model can continue to be edited and simulated
+     while the file is written. Jobs write their files with
+     writeAtomically(), which writes a temporary file alongside the
+     destination and renames it over the destination only once
+     completely written, so a failed or interrupted save never leaves
+     a truncated file behind.
+
+     The outcome of each job is queued for the GUI thread to collect
+     with takeResult().
+  */
+  class BackgroundSaver
+  {
+  public:
+    /// writes the file whose name it is passed, throwing on failure
+    typedef std::function<void(const std::string&)> Writer;
+    /// saves the file whose name it is passed, throwing on failure
+    typedef Writer Job;
+    struct Result
+    {
+      std::string fileName;
+      /// empty if the file was written successfully
+      std::string error;
+    };
+
+    BackgroundSaver() {}
+    /// waits for outstanding jobs to complete
+    ~BackgroundSaver();
+    BackgroundSaver(const BackgroundSaver&)=delete;
+    void operator=(const BackgroundSaver&)=delete;
+
+    /// write \a fileName with \a write, via a temporary file, on the
+    /// calling thread
+    static void writeAtomically(const std::string& fileName, const Writer& write);
+
+    /// queue \a job to save \a fileName in the background. A queued
+    /// job for the same file that has not yet started is superseded
+    void submit(const std::string& fileName, Job job);
+    /// true if a job is queued or running
+    bool busy() const;
+    /// wait until all queued jobs have completed
+    void wait();
+    /// retrieve the outcome of the oldest completed job. @return false if none
+    bool takeResult(Result&);
+
+  private:
+    struct Queued
+    {
+      std::string fileName;
+      Job job;
+    };
+    mutable std::mutex mutex;
+    std::condition_variable jobReady, jobDone;
+    std::deque<Queued> jobs;
+    std::deque<Result> results;
+    bool running=false, shutdown=false;
+    std::thread thread;
+    void run();
+  };
+}
+
+#endif
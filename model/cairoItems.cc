@@ -30,6 +30,8 @@
 #include "latexMarkup.h"
 #include <arrays.h>
 #include <pango.h>
+#include <map>
+#include <mutex>
 #include <ecolab_epilogue.h>
 #include <boost/geometry/geometry.hpp>
 
@@ -47,17 +49,51 @@ void minsky::drawSelected(cairo_t* cairo)
   cairo_restore(cairo);
 }
 
+namespace
+{
+  mutex labelMutex;
+  map<pair<string,double>, LabelExtents> labelMemo;
+  const size_t maxLabelMemo=1<<16;
+}
+
+LabelExtents minsky::labelExtents(const string& label, double fontSize)
+{
+  auto key=make_pair(label, fontSize);
+  {
+    lock_guard<mutex> lock(labelMutex);
+    auto i=labelMemo.find(key);
+    if (i!=labelMemo.end()) return i->second;
+  }
+
+  LabelExtents r;
+  cairo_surface_t* surf=cairo_image_surface_create(CAIRO_FORMAT_A1, 100,100);
+  cairo_t* cairo=cairo_create(surf);
+  {
+    Pango pango(cairo);
+    pango.setFontSize(fontSize);
+    pango.setMarkup(latexToPango(label));
+    r.width=pango.width();
+    r.height=pango.height();
+    r.top=pango.top();
+  }
+  cairo_destroy(cairo);
+  cairo_surface_destroy(surf);
+
+  lock_guard<mutex> lock(labelMutex);
+  if (labelMemo.size()>=maxLabelMemo) labelMemo.clear();
+  labelMemo[key]=r;
+  return r;
+}
+
+void minsky::clearLabelExtents()
+{
+  lock_guard<mutex> lock(labelMutex);
+  labelMemo.clear();
+}
+
 RenderOperation::RenderOperation(const OperationBase& op, cairo_t* cairo):
   op(op), cairo(cairo), hoffs(0)
 {
-  cairo_t *lcairo=cairo;
-  cairo_surface_t* surf=NULL;
-  if (!lcairo)
-    {
-      surf = cairo_image_surface_create(CAIRO_FORMAT_A1, 100,100);
-      lcairo = cairo_create(surf);
-    }
-
   const float l=op.l, r=op.r;
   w=0.5*(-l+r);
   h=op.h;
@@ -67,15 +103,11 @@ RenderOperation::RenderOperation(const OperationBase& op, cairo_t* cairo):
     case OperationType::constant:
     case OperationType::data:
       {
-        cairo_text_extents_t bbox;
         const NamedOp& c=dynamic_cast<const NamedOp&>(op);
-
-        Pango pango(lcairo);
-        pango.setFontSize(10);
-        pango.setMarkup(latexToPango(c.description));
-        w=0.5*pango.width()+2; 
-        h=0.5*pango.height()+4;
-        hoffs=pango.top();
+        auto e=labelExtents(c.description, 10);
+        w=0.5*e.width+2; 
+        h=0.5*e.height+4;
+        hoffs=e.top;
         break;
       }
     case OperationType::integrate:
@@ -91,11 +123,6 @@ RenderOperation::RenderOperation(const OperationBase& op, cairo_t* cairo):
       }
     default: break;
     }
- if (surf) //cleanup temporary surface
-    {
-      cairo_destroy(lcairo);
-      cairo_surface_destroy(surf);
-    }
 }
 
 Polygon RenderOperation::geom() const
@@ -118,6 +145,9 @@ void RenderOperation::draw()
 
 void OperationBase::draw(cairo_t* cairo) const
 {
+  // transformation placing the icon, relative to which ports are drawn
+  cairo_matrix_t iconMatrix;
+  cairo_get_matrix(cairo, &iconMatrix);
   // if rotation is in 1st or 3rd quadrant, rotate as
   // normal, otherwise flip the text so it reads L->R
   double angle=rotation * M_PI / 180.0;
@@ -171,21 +201,15 @@ void OperationBase::draw(cairo_t* cairo) const
 
         // set the output ports coordinates
         // compute port coordinates relative to the icon's
-        // point of reference
-        double xx=w+2, yy=0;
-        cairo_user_to_device(cairo, &xx, &yy);
-
-        ports[0]->moveTo(x()+xx, y()+yy);
+        // point of reference, independently of how the icon is placed
+        double sa=sin(angle), ca=cos(angle);
+        ports[0]->moveTo(x()+(w+2)*ca, y()+(w+2)*sa);
         if (numPorts()>1)
-          {
-            xx=-w, yy=0;
-            cairo_user_to_device(cairo, &xx, &yy);
-            ports[1]->moveTo(x()+xx, y()+yy);
-          }
+          ports[1]->moveTo(x()-w*ca, y()-w*sa);
         if (mouseFocus)
           {
             cairo_save(cairo);
-            cairo_identity_matrix(cairo);
+            cairo_set_matrix(cairo, &iconMatrix);
             drawPorts(cairo);
             cairo_restore(cairo);
           }
@@ -329,7 +353,7 @@ void OperationBase::draw(cairo_t* cairo) const
   if (mouseFocus)
     {
       cairo_save(cairo);
-      cairo_identity_matrix(cairo);
+      cairo_set_matrix(cairo, &iconMatrix);
       drawPorts(cairo);
       cairo_restore(cairo);
     }
@@ -341,27 +365,10 @@ void OperationBase::draw(cairo_t* cairo) const
 RenderVariable::RenderVariable(const VariableBase& var, cairo_t* cairo):
   var(var), cairo(cairo)
 {
-  cairo_t *lcairo=cairo;
-  cairo_surface_t* surf=NULL;
-  if (!lcairo)
-    {
-      surf = cairo_image_surface_create(CAIRO_FORMAT_A1, 100,100);
-      lcairo = cairo_create(surf);
-    }
-
-  Pango pango(lcairo);
-  pango.setFontSize(12);
-  pango.setMarkup(latexToPango(var.name()));
-  w=0.5*pango.width()+2; 
-  h=0.5*pango.height()+4;
-  hoffs=pango.top();
-
-
-  if (surf) //cleanup temporary surface
-    {
-      cairo_destroy(lcairo);
-      cairo_surface_destroy(surf);
-    }
+  auto e=labelExtents(var.name(), 12);
+  w=0.5*e.width+2; 
+  h=0.5*e.height+4;
+  hoffs=e.top;
 }
 
 Polygon RenderVariable::geom() const
@@ -385,6 +392,9 @@ void RenderVariable::draw()
 
 void VariableBase::draw(cairo_t *cairo) const
 {
+  // transformation placing the icon, relative to which ports are drawn
+  cairo_matrix_t iconMatrix;
+  cairo_get_matrix(cairo, &iconMatrix);
   double angle=rotation * M_PI / 180.0;
   double fm=std::fmod(rotation,360);
 
@@ -449,7 +459,7 @@ void VariableBase::draw(cairo_t *cairo) const
   if (mouseFocus)
     {
       cairo_save(cairo);
-      cairo_identity_matrix(cairo);
+      cairo_set_matrix(cairo, &iconMatrix);
       drawPorts(cairo);
       cairo_restore(cairo);
     }
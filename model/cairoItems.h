@@ -25,6 +25,18 @@
 
 namespace minsky
 {
+  /// size of a label as laid out by Pango, in user units
+  struct LabelExtents
+  {
+    float width=0, height=0, top=0;
+  };
+  /// extents of LaTeX \a label at \a fontSize. Measurements are
+  /// memoised process wide, so a label is laid out only once for its
+  /// size, however often the icons bearing it are drawn or hit tested.
+  LabelExtents labelExtents(const std::string& label, double fontSize);
+  /// discard memoised label extents, eg when the font changes
+  void clearLabelExtents();
+
   /** class that renders an operation into a cairo context. 
       A user can also query the size of the unrotated rendered image
   */
@@ -0,0 +1,143 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "checkpoint.h"
+#include <error.h>
+#include <fstream>
+#include <stdio.h>
+#include <unistd.h>
+using namespace std;
+
+namespace minsky
+{
+  namespace
+  {
+    template <class T>
+    void write(ostream& o, const vector<T>& x)
+    {
+      size_t n=x.size();
+      o.write((const char*)&n, sizeof(n));
+      o.write((const char*)x.data(), n*sizeof(T));
+    }
+
+    template <class T>
+    void read(istream& i, vector<T>& x)
+    {
+      size_t n=0;
+      i.read((char*)&n, sizeof(n));
+      x.resize(n);
+      i.read((char*)x.data(), n*sizeof(T));
+    }
+  }
+
+  void Checkpoint::spill(const string& fileName)
+  {
+    ofstream f(fileName, ios::binary);
+    write(f, stock);
+    write(f, flow);
+    size_t n=plotCursors.size();
+    f.write((const char*)&n, sizeof(n));
+    for (auto& c: plotCursors)
+      write(f, c);
+    if (!f)
+      throw ecolab::error("unable to write checkpoint to %s",fileName.c_str());
+    spillFile=fileName;
+    vector<double>().swap(stock);
+    vector<double>().swap(flow);
+    vector<vector<size_t> >().swap(plotCursors);
+  }
+
+  void Checkpoint::unspill()
+  {
+    if (spillFile.empty()) return;
+    ifstream f(spillFile, ios::binary);
+    read(f, stock);
+    read(f, flow);
+    size_t n=0;
+    f.read((char*)&n, sizeof(n));
+    plotCursors.resize(n);
+    for (auto& c: plotCursors)
+      read(f, c);
+    if (!f)
+      throw ecolab::error("unable to read checkpoint from %s",spillFile.c_str());
+    removeSpill();
+  }
+
+  void Checkpoint::removeSpill()
+  {
+    if (!spillFile.empty())
+      remove(spillFile.c_str());
+    spillFile.clear();
+  }
+
+  size_t Checkpoint::bytes() const
+  {
+    size_t r=sizeof(*this)+sizeof(double)*(stock.size()+flow.size());
+    for (auto& c: plotCursors)
+      r+=sizeof(c)+sizeof(size_t)*c.size();
+    return r;
+  }
+
+  void Checkpoints::push(Checkpoint&& c)
+  {
+    checkpoints.push_back(move(c));
+    // index of the oldest checkpoint still in memory
+    size_t inMemory=0, oldest=checkpoints.size();
+    for (size_t i=checkpoints.size(); i-->0;)
+      if (checkpoints[i].spillFile.empty())
+        {
+          inMemory++;
+          oldest=i;
+        }
+    if (inMemory>maxInMemory)
+      {
+        if (spillDir.empty())
+          checkpoints.erase(checkpoints.begin()+oldest);
+        else
+          checkpoints[oldest].spill
+            (spillDir+"/minsky-checkpoint-"+to_string(getpid())+"-"+
+             to_string(nextSpill++)+".dat");
+      }
+  }
+
+  Checkpoint Checkpoints::restore(size_t i)
+  {
+    if (i>=checkpoints.size())
+      throw ecolab::error("checkpoint %d does not exist",int(i));
+    while (checkpoints.size()>i+1)
+      {
+        checkpoints.back().removeSpill();
+        checkpoints.pop_back();
+      }
+    Checkpoint r=checkpoints.back();
+    // spill file is removed by unspill, so detach it from the copy retained
+    if (!r.spillFile.empty())
+      {
+        r.unspill();
+        checkpoints.back()=r;
+      }
+    return r;
+  }
+
+  void Checkpoints::clear()
+  {
+    for (auto& c: checkpoints)
+      c.removeSpill();
+    checkpoints.clear();
+  }
+}
@@ -0,0 +1,83 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <deque>
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+namespace minsky
+{
+  /// simulation state sufficient to resume integration from time t
+  struct Checkpoint
+  {
+    double t=0;
+    /// integrator step size at the time of the checkpoint
+    double stepSize=0;
+    std::vector<double> stock, flow;
+    /// number of points in each pen of each live plot
+    std::vector<std::vector<size_t> > plotCursors;
+    /// if non-empty, stock, flow and plotCursors have been written to this file
+    std::string spillFile;
+
+    /// write state to spillFile, releasing memory
+    void spill(const std::string& fileName);
+    /// read state back from spillFile
+    void unspill();
+    /// remove any spill file
+    void removeSpill();
+    /// approximate memory used by this checkpoint
+    size_t bytes() const;
+  };
+
+  /**
+     Ring of recent simulation checkpoints, in order of time. When
+     full, the oldest in-memory checkpoint is either written to disk
+     (if spillDir is set) or discarded.
+  */
+  class Checkpoints
+  {
+    std::deque<Checkpoint> checkpoints;
+    unsigned nextSpill=0;
+  public:
+    /// maximum number of checkpoints held in memory
+    unsigned maxInMemory=100;
+    /// directory to write excess checkpoints to. If empty, they are discarded
+    std::string spillDir;
+
+    Checkpoints() {}
+    Checkpoints(const Checkpoints&)=delete;
+    void operator=(const Checkpoints&)=delete;
+    ~Checkpoints() {clear();}
+
+    size_t size() const {return checkpoints.size();}
+    bool empty() const {return checkpoints.empty();}
+    const Checkpoint& operator[](size_t i) const {return checkpoints[i];}
+    const Checkpoint& back() const {return checkpoints.back();}
+
+    void push(Checkpoint&&);
+    /// retrieve checkpoint \a i, discarding all later ones
+    /// @throw ecolab::error if out of range
+    Checkpoint restore(size_t i);
+    void clear();
+  };
+}
+
+#endif
@@ -36,9 +36,11 @@ namespace
       if (cairoSurface)
         try
           {
-            MathDAG::SystemOfEquations system(cminsky());
+            // only the rows changed since the last edit are rendered,
+            // and only those in view are drawn
+            cminsky().updateEquationView();
             cairo_move_to(cairoSurface->cairo(),0,0);
-            system.renderEquations(*cairoSurface);
+            cminsky().equationView.draw(cairoSurface->cairo());
           }
         catch (std::exception& ex) {} // ignore errors due to ill-formed models
     }
@@ -0,0 +1,95 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "equationView.h"
+#include "equations.h"
+#include <cairo_base.h>
+#include <algorithm>
+#include <unordered_map>
+#include <ecolab_epilogue.h>
+using namespace std;
+
+namespace minsky
+{
+  void EquationView::update(const MathDAG::SystemOfEquations& system)
+  {
+    // rows already rendered, by the LaTeX they were rendered from
+    unordered_map<string, Row> previous;
+    for (auto& r: rows)
+      previous.emplace(r.latex, std::move(r));
+    rows.clear();
+    m_width=m_overhang=0;
+
+    double y=0;
+    for (size_t i=0; i<system.numEquationRows(); ++i)
+      {
+        Row r;
+        r.latex=system.equationRowLatex(i);
+        auto p=previous.find(r.latex);
+        if (p!=previous.end())
+          {
+            r=std::move(p->second);
+            previous.erase(p);
+          }
+        else
+          {
+            ecolab::cairo::Surface surf
+              (cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,nullptr));
+            cairo_move_to(surf.cairo(),0,0);
+            r.advance=system.renderEquationRow(surf,i);
+            // the row shares the recording, which outlives surf
+            r.recording.reset(cairo_surface_reference(surf.surface()),
+                              cairo_surface_destroy);
+            double x0, y0, w, h;
+            cairo_recording_surface_ink_extents(r.recording.get(), &x0, &y0, &w, &h);
+            r.right=x0+w;
+            r.overhang=max(0.0, max(-y0, y0+h-r.advance));
+            ++m_rowsRendered;
+          }
+        r.y=y;
+        y+=r.advance;
+        m_width=max(m_width, r.right);
+        m_overhang=max(m_overhang, r.overhang);
+        rows.push_back(std::move(r));
+      }
+  }
+
+  void EquationView::draw(cairo_t* cairo) const
+  {
+    double x=0, y=0;
+    if (cairo_has_current_point(cairo))
+      cairo_get_current_point(cairo, &x, &y);
+    double x0, y0, x1, y1;
+    cairo_clip_extents(cairo, &x0, &y0, &x1, &y1);
+    y0-=y+m_overhang;
+    y1-=y-m_overhang;
+
+    // first row ending below the top of the clip region
+    auto i=upper_bound(rows.begin(), rows.end(), y0,
+                       [](double t, const Row& r) {return t<r.y+r.advance;});
+    for (; i!=rows.end() && i->y<=y1; ++i)
+      {
+        cairo_save(cairo);
+        cairo_set_source_surface(cairo, i->recording.get(), x, y+i->y);
+        cairo_paint(cairo);
+        cairo_restore(cairo);
+        ++m_rowsDrawn;
+      }
+  }
+}
@@ -0,0 +1,77 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EQUATIONVIEW_H
+#define EQUATIONVIEW_H
+#include <cairo.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace MathDAG
+{
+  class SystemOfEquations;
+}
+
+namespace minsky
+{
+  /**
+     Rows of the equations pane, each recorded once along with its
+     height, and kept until the LaTeX of its equation changes. Drawing
+     the pane replays only the rows within the clip region.
+  */
+  class EquationView
+  {
+  public:
+    /// replace the rows by those of \a system, rendering only rows
+    /// not present at the last update
+    void update(const MathDAG::SystemOfEquations& system);
+    /// draw the rows intersecting the clip region of \a cairo, with
+    /// the top left corner of the pane at the current point
+    void draw(cairo_t* cairo) const;
+    void clear() {rows.clear(); m_width=m_overhang=0;}
+
+    size_t size() const {return rows.size();}
+    double width() const {return m_width;}
+    double height() const
+    {return rows.empty()? 0: rows.back().y+rows.back().advance;}
+    /// number of rows rendered by update(), rather than reused
+    size_t rowsRendered() const {return m_rowsRendered;}
+    /// number of rows replayed by draw()
+    size_t rowsDrawn() const {return m_rowsDrawn;}
+
+  private:
+    struct Row
+    {
+      std::string latex;
+      std::shared_ptr<cairo_surface_t> recording;
+      double y=0; ///< offset of the row from the top of the pane
+      double advance=0; ///< distance to the next row
+      double right=0; ///< right hand edge of the ink
+      /// distance the ink extends above the row or below the next
+      double overhang=0;
+    };
+    std::vector<Row> rows;
+    double m_width=0, m_overhang=0;
+    size_t m_rowsRendered=0;
+    mutable size_t m_rowsDrawn=0;
+  };
+}
+
+#endif
@@ -31,17 +31,48 @@ void GodleyTable::markEdited()
   minsky::minsky().markEdited();
 }
 
+namespace
+{
+  bool isInitialConditionLabel(const string& label)
+  {
+    static size_t initialConditionsSz=strlen(GodleyTable::initialConditions);
+    size_t i, j;
+    // trim any leading whitespaces
+    for (i=0; isspace(label[i]); ++i);
+    // compare case insensitively
+    for (j=0; j<initialConditionsSz && i<label.size() && 
+           toupper(label[i])==toupper(GodleyTable::initialConditions[j]); ++i, ++j);
+    return j==initialConditionsSz;
+  }
+}
+
 bool GodleyTable::initialConditionRow(unsigned row) const
 {
-  const string& label=cell(row,0);
-  static size_t initialConditionsSz=strlen(initialConditions);
-  size_t i, j;
-  // trim any leading whitespaces
-  for (i=0; isspace(label[i]); ++i);
-  // compare case insensitively
-  for (j=0; j<initialConditionsSz && i<label.size() && 
-         toupper(label[i])==toupper(initialConditions[j]); ++i, ++j);
-  return j==initialConditionsSz;
+  return parsedCell(row,0).initialCondition;
+}
+
+const GodleyTable::ParsedCell& GodleyTable::parsedCell(unsigned row, unsigned col) const
+{
+  if (parsed.size()!=data.size())
+    parsed.assign(data.size(), vector<ParsedCell>());
+  auto& parsedRow=parsed[row];
+  if (parsedRow.size()!=data[row].size())
+    parsedRow.assign(data[row].size(), ParsedCell());
+  auto& p=parsedRow[col];
+  if (!p.valid)
+    {
+      const string& contents=data[row][col];
+      if (row==0)
+        {
+          p.flow.coef=1;
+          p.flow.name=trimWS(contents);
+        }
+      else
+        p.flow=FlowCoef(contents);
+      p.initialCondition=col==0 && isInitialConditionLabel(contents);
+      p.valid=true;
+    }
+  return p;
 }
 
 void GodleyTable::insertRow(unsigned row)
@@ -49,6 +80,7 @@ void GodleyTable::insertRow(unsigned row)
   if (row<=data.size())
     {
       data.insert(data.begin()+row, vector<string>(cols()));
+      invalidateParsed();
       markEdited();
     }
 }
@@ -65,6 +97,7 @@ void GodleyTable::insertCol(unsigned col)
         data[row].insert(data[row].end(), "");
       data[row].insert(data[row].begin()+col, "");
     }
+  invalidateParsed();
   markEdited();
 }
 
@@ -77,6 +110,7 @@ void GodleyTable::deleteCol(unsigned col)
     {
       for (unsigned row=0; row<rows(); ++row)
         data[row].erase(data[row].begin()+col-1);
+      invalidateParsed();
       markEdited();
     }
 }
@@ -90,6 +124,7 @@ void GodleyTable::moveRow(int row, int n)
   for ( ; abs(n)>0; n=n>0? n-1:n+1)
     rowToMove.swap(data[row+n]);
   rowToMove.swap(data[row]);
+  invalidateParsed();
 }
 
 void GodleyTable::moveCol(int col, int n)
@@ -104,6 +139,7 @@ void GodleyTable::moveCol(int col, int n)
         cellToMove.swap(data[row][col+i]);
       cellToMove.swap(data[row][col]);
     }
+  invalidateParsed();
 }
 
 
@@ -113,7 +149,7 @@ vector<string> GodleyTable::getColumnVariables() const
   vector<string> vars;
   for (size_t c=1; c<cols(); ++c)
     {
-      string var=trimWS(cell(0,c));
+      const string& var=parsedCell(0,c).flow.name;
       if (!var.empty())
         {
           if (!uvars.insert(var).second)
@@ -132,7 +168,7 @@ vector<string> GodleyTable::getVariables() const
     if (!initialConditionRow(r))
       for (size_t c=1; c<cols(); ++c)
         {
-          FlowCoef fc(cell(r,c));
+          const FlowCoef& fc=parsedCell(r,c).flow;
           if (!fc.name.empty() && uvars.insert(fc.name).second)
             vars.push_back(fc.name);
         }
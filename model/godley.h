@@ -26,6 +26,7 @@
 
 #include "variable.h"
 #include "assetClass.h"
+#include "flowCoef.h"
 
 namespace minsky
 {
@@ -38,18 +39,35 @@ namespace minsky
 
     friend struct SchemaHelper;
     friend class GodleyIcon;
+
+    /// parsed form of a cell
+    struct ParsedCell
+    {
+      /// coefficient and trimmed variable name. In row 0, the
+      /// column's stock variable, with unit coefficient
+      FlowCoef flow;
+      /// in column 0, whether the row is an initial conditions row
+      bool initialCondition=false;
+      bool valid=false;
+    };
   private:
     CLASSDESC_ACCESS(GodleyTable);
     /// class of each column (used in DE compliant mode)
     vector<AssetClass> m_assetClass;
     vector<vector<string> > data;
+    /// cells parsed on demand, and invalidated when handed out for
+    /// modification by cell(). Structural changes discard the lot.
+    mutable classdesc::Exclude<vector<vector<ParsedCell> > > parsed;
 
     void markEdited(); ///< mark model as having changed
+    /// discard parsed cells, after data is modified directly
+    void invalidateParsed() {parsed.clear();}
     void _resize(unsigned rows, unsigned cols) {
       // resize existing
       for (size_t i=0; i<data.size(); ++i) data[i].resize(cols);
       data.resize(rows, vector<string>(cols));
       m_assetClass.resize(cols, noAssetClass);
+      invalidateParsed();
     }
   public:
 
@@ -105,7 +123,7 @@ namespace minsky
     size_t rows() const {return data.size();}
     size_t cols() const {return data.empty()? 0: data[0].size();}
 
-    void clear() {data.clear(); markEdited();}
+    void clear() {data.clear(); invalidateParsed(); markEdited();}
     void resize(unsigned rows, unsigned cols){_resize(rows,cols); markEdited();}
 
     /** @{ In the following, C++ data structure is off by one with
@@ -130,12 +148,20 @@ namespace minsky
 
     void dimension(unsigned rows, unsigned cols) {clear(); resize(rows,cols);}
 
+    /// modifiable cell contents. The cell's parsed form is refreshed
+    /// on next use, so the returned reference should not be retained
+    /// for modification after other cells have been read
     string& cell(unsigned row, unsigned col) {
       if (row>=rows() || col>=cols())
         _resize(row+1, col+1);
+      if (row<parsed.size() && col<parsed[row].size())
+        parsed[row][col].valid=false;
       return data[row][col];
     }
     const string& cell(unsigned row, unsigned col) const {return data[row][col];}
+    /// cell (\a row, \a col) parsed as a flow coefficient, updated
+    /// only when the cell has been edited
+    const ParsedCell& parsedCell(unsigned row, unsigned col) const;
     string getCell(unsigned row, unsigned col) const {
       if (row<rows() && col<cols())
         return cell(row,col);
@@ -164,5 +190,17 @@ namespace minsky
 
 }
 
+#ifdef _CLASSDESC
+// working storage, excluded from serialisation
+#pragma omit pack minsky::GodleyTable::ParsedCell
+#pragma omit unpack minsky::GodleyTable::ParsedCell
+#pragma omit TCL_obj minsky::GodleyTable::ParsedCell
+#pragma omit xml_pack minsky::GodleyTable::ParsedCell
+#pragma omit xml_unpack minsky::GodleyTable::ParsedCell
+#pragma omit xsd_generate minsky::GodleyTable::ParsedCell
+#pragma omit json_pack minsky::GodleyTable::ParsedCell
+#pragma omit json_unpack minsky::GodleyTable::ParsedCell
+#endif
+
 #include "godley.cd"
 #endif
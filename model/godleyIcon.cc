@@ -123,26 +123,17 @@ namespace minsky
 //                       vars.back()->ports.end());
         }
       // remove any previously existing variables
-      set<ItemPtr> ov(oldVars.begin(), oldVars.end());
-      if (!ov.empty())
-        minsky::minsky().model->recursiveDo
-          (&Group::items,
-           [&](Items& m, Items::iterator i) 
-           {
-             if (ov.count(*i))
-               m.erase(i);
-             return false;
-           });
+      for (auto& v: oldVars)
+        if (auto g=v->group.lock())
+          g->removeItem(*v);
     }
 
   void GodleyIcon::setCell(int row, int col, const string& newVal) 
   {
     // if this operation is clearing an initial condition cell, set it to 0
-    string& c=table.cell(row,col);
-    if (newVal.empty() && !c.empty() && table.initialConditionRow(row))
-      c="0";
-    else
-      c=newVal; 
+    bool clearingInitialCondition=newVal.empty() &&
+      !table.cell(row,col).empty() && table.initialConditionRow(row);
+    table.cell(row,col)=clearingInitialCondition? "0": newVal;
     if (row==0)
       minsky().importDuplicateColumn(table, col);
     else
@@ -155,6 +146,7 @@ namespace minsky
     if (row>0 && row<=table.rows())
       {
         table.data.erase(table.data.begin()+row-1);
+        table.invalidateParsed();
         // if shared column data is deleted, remove it from the other tables too
         for (size_t col=1; col<table.cols(); ++col)
           minsky().balanceDuplicateColumns(*this, col);
@@ -187,7 +179,7 @@ namespace minsky
     for (size_t row=1; row<table.rows(); ++row)
       if (!table.initialConditionRow(row))
         {
-          FlowCoef fc(table.cell(row,col));
+          const FlowCoef& fc=table.parsedCell(row,col).flow;
           if (!fc.name.empty())
             r[fc.name]+=fc.coef;
         }
@@ -243,6 +235,8 @@ namespace minsky
     iconSize=max(100.0, 1.8*height);
 
     positionVariables();
+    if (auto g=group.lock())
+      g->itemResized(*this);
   }
 
   void GodleyIcon::positionVariables() const
@@ -79,6 +79,8 @@ namespace minsky
 
     /// draw icon to \a context
     void draw(cairo_t* context) const override;
+    /// drawing positions the table's variables
+    bool iconCacheable() const override {return false;}
 
     /// returns valueid for variable reference in table
     // TODO: this should be refactored to a more central location
@@ -20,6 +20,8 @@
 #include "group.h"
 #include "wire.h"
 #include "operation.h"
+#include "godleyIcon.h"
+#include "switchIcon.h"
 #include "minsky.h"
 #include "cairoItems.h"
 #include <cairo_base.h>
@@ -91,20 +93,53 @@ namespace minsky
     return shared_ptr<Group>();
   }
 
+  bool GroupItems::inModel() const
+  {
+    auto g=dynamic_cast<const Group*>(this);
+    return g && &g->globalGroup()==cminsky().model.get();
+  }
+
+  void GroupItems::forgetWiring(const Item& it) const
+  {
+    if (!inModel()) return;
+    auto& order=minsky().wiringOrder;
+    order.remove(it);
+    if (auto g=dynamic_cast<const Group*>(&it))
+      for (auto& i: g->findItems([](const ItemPtr&){return true;}))
+        order.remove(*i);
+  }
+
   ItemPtr GroupItems::removeItem(const Item& it)
+  {
+    ItemPtr r=detachItem(it);
+    if (r) forgetWiring(*r);
+    return r;
+  }
+
+  GroupPtr GroupItems::removeGroup(const Group& group)
+  {
+    GroupPtr r=detachGroup(group);
+    if (r) forgetWiring(*r);
+    return r;
+  }
+
+  ItemPtr GroupItems::detachItem(const Item& it)
   {
     for (auto i=items.begin(); i!=items.end(); ++i)
       if (i->get()==&it)
         {
           ItemPtr r=*i;
           items.erase(i);
+          unindexItem(*r);
+          spatialIndex.remove(*r);
+          spatialIndex.unmeasured.erase(r.get());
           return r;
         }
 
     removeDisplayPlot();
     
     for (auto& g: groups)
-      if (ItemPtr r=g->removeItem(it))
+      if (ItemPtr r=g->detachItem(it))
         return r;
     return ItemPtr();
   }
@@ -125,18 +160,20 @@ namespace minsky
     return WirePtr();
   }
 
-  GroupPtr GroupItems::removeGroup(const Group& group)
+  GroupPtr GroupItems::detachGroup(const Group& group)
   {
     for (auto i=groups.begin(); i!=groups.end(); ++i)
       if (i->get()==&group)
         {
           GroupPtr r=*i;
           groups.erase(i);
+          spatialIndex.remove(*r);
+          spatialIndex.unmeasured.erase(r.get());
           return r;
         }
 
     for (auto& g: groups)
-      if (GroupPtr r=g->removeGroup(group))
+      if (GroupPtr r=g->detachGroup(group))
         return r;
     return GroupPtr();
   }
@@ -166,7 +203,7 @@ namespace minsky
 
     if (origGroup.get()==this) return it; // nothing to do.
     if (origGroup)
-      origGroup->removeItem(*it);
+      origGroup->detachItem(*it);
 
     // stash init value to initialise new variableValue
     string init;
@@ -200,15 +237,152 @@ namespace minsky
           if (auto oldG=intOp->intVar->group.lock())
             {
               if (oldG.get()!=this)
-                addItem(oldG->removeItem(*intOp->intVar));
+                addItem(oldG->detachItem(*intOp->intVar));
             }
           else
             addItem(intOp->intVar);
         }
     items.push_back(it);
+    indexItem(it);
+    if (spatialIndex.valid)
+      spatialIndex.unmeasured[it.get()]=it;
     return items.back();
   }
 
+  namespace
+  {
+    template <class T>
+    bool addToIndex(vector<shared_ptr<T>>& index, const ItemPtr& it)
+    {
+      if (auto x=dynamic_pointer_cast<T>(it))
+        {
+          it->kindIndexPos=index.size();
+          index.push_back(x);
+          return true;
+        }
+      return false;
+    }
+
+    /// remove \a it by moving the last entry into its place
+    template <class T>
+    bool removeFromIndex(vector<shared_ptr<T>>& index, const Item& it)
+    {
+      if (!dynamic_cast<const T*>(&it)) return false;
+      size_t i=it.kindIndexPos;
+      assert(i<index.size() && static_cast<const Item*>(index[i].get())==&it);
+      if (i+1<index.size())
+        {
+          index[i]=std::move(index.back());
+          index[i]->kindIndexPos=i;
+        }
+      index.pop_back();
+      return true;
+    }
+  }
+
+  void GroupItems::indexItem(const ItemPtr& it)
+  {
+    addToIndex(variables, it) || addToIndex(operations, it) ||
+      addToIndex(godleyIcons, it) || addToIndex(plots, it) ||
+      addToIndex(switches, it);
+  }
+
+  void GroupItems::unindexItem(const Item& it)
+  {
+    removeFromIndex(variables, it) || removeFromIndex(operations, it) ||
+      removeFromIndex(godleyIcons, it) || removeFromIndex(plots, it) ||
+      removeFromIndex(switches, it);
+  }
+
+  namespace
+  {
+    /// box relative to the group's position enclosing \a it's icon
+    /// and ports at any rotation, of radius \a r
+    BoundingBox boxAbout(const Item& it, float r)
+    {return BoundingBox(it.m_x-r, it.m_y-r, it.m_x+r, it.m_y+r);}
+
+    /// distance from the item's position to the furthest extent of
+    /// its icon and ports. As icons rotate about their position, this
+    /// does not depend on rotation.
+    float iconRadius(const Item& it)
+    {
+      ecolab::cairo::Surface dummySurf
+        (cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,nullptr));
+      it.draw(dummySurf.cairo());
+      double x,y,w,h;
+      cairo_recording_surface_ink_extents(dummySurf.surface(), &x, &y, &w, &h);
+      float r=0;
+      if (w>0 && h>0)
+        r=sqrt(max(x*x, (x+w)*(x+w)) + max(y*y, (y+h)*(y+h)));
+      for (auto& p: it.ports)
+        r=max(r, float(hypot(p->x()-it.x(), p->y()-it.y())+portRadius*it.zoomFactor));
+      return r;
+    }
+  }
+
+  void GroupItems::itemMoved(const Item& it) const
+  {
+    BoundingBox b;
+    if (spatialIndex.valid && spatialIndex.find(it, b))
+      {
+        float r=0.5*(b.x1-b.x0);
+        spatialIndex.update(it, boxAbout(it, r));
+      }
+  }
+
+  void GroupItems::itemResized(const Item& it) const
+  {
+    if (auto i=spatialIndex.remove(it))
+      spatialIndex.unmeasured[&it]=i;
+  }
+
+  void GroupItems::itemZoomed(const Item& it, float factor) const
+  {
+    BoundingBox b;
+    if (spatialIndex.valid && spatialIndex.find(it, b))
+      {
+        float r=0.5*(b.x1-b.x0)*factor;
+        spatialIndex.update(it, boxAbout(it, r));
+      }
+  }
+
+  BoundingBox wireBounds(const Wire& w)
+  {
+    if (!w.from() || !w.to()) return BoundingBox();
+    auto& c=w.geometry().coords;
+    if (c.size()<2) return BoundingBox();
+    // curves lie within the hull of their control points. Allow for
+    // the arrow head
+    const float arrow=6;
+    BoundingBox b(c[0]-arrow, c[1]-arrow, c[0]+arrow, c[1]+arrow);
+    for (size_t i=2; i+1<c.size(); i+=2)
+      b|=BoundingBox(c[i]-arrow, c[i+1]-arrow, c[i]+arrow, c[i+1]+arrow);
+    return b;
+  }
+
+  vector<ItemPtr> Group::itemsIntersecting(const BoundingBox& box) const
+  {
+    if (!spatialIndex.valid)
+      {
+        spatialIndex.clear();
+        spatialIndex.unmeasured.clear();
+        for (auto& i: items)
+          spatialIndex.unmeasured[i.get()]=i;
+        for (auto& i: groups)
+          spatialIndex.unmeasured[i.get()]=i;
+        spatialIndex.valid=true;
+      }
+    for (auto& i: spatialIndex.unmeasured)
+      spatialIndex.insert(i.second, boxAbout(*i.second, iconRadius(*i.second)));
+    spatialIndex.unmeasured.clear();
+
+    vector<ItemPtr> r;
+    float dx=x(), dy=y();
+    spatialIndex.query(BoundingBox(box.x0-dx, box.y0-dy, box.x1-dx, box.y1-dy),
+                       [&](const ItemPtr& i) {r.push_back(i);});
+    return r;
+  }
+
   void GroupItems::adjustWiresGroup(Wire& w)
   {
     // Find common ancestor group, and move wire to it
@@ -238,7 +412,12 @@ namespace minsky
           wiresToSplit.insert(w);
 
     for (auto w: wiresToSplit)
-      w->split();
+      {
+        w->split();
+        // split rewires w from an I/O variable
+        if (inModel())
+          minsky().wiringOrder.addWire(*w);
+      }
   }
 
 
@@ -285,7 +464,8 @@ namespace minsky
       i->moveTo(i->x()-dx, i->y()-dy);
 
     moveTo(xx,yy);
-
+    if (auto g=group.lock())
+      g->itemResized(*this);
   }
 
   bool Group::nocycles() const
@@ -303,10 +483,13 @@ namespace minsky
     auto origGroup=g->group.lock();
     if (origGroup.get()==this) return g; // nothing to do
     if (origGroup)
-      origGroup->removeGroup(*g);
+      origGroup->detachGroup(*g);
     if (auto _this=dynamic_cast<Group*>(this))
       g->group=_this->self();
+    g->invalidateGeometry();
     groups.push_back(g);
+    if (spatialIndex.valid)
+      spatialIndex.unmeasured[g.get()]=g;
     assert(nocycles());
     return groups.back();
   }
@@ -315,6 +498,9 @@ namespace minsky
   {
     assert(w->from() && w->to());
     wires.push_back(w);
+    // copies, eg the clipboard's, are not part of the model's order
+    if (inModel())
+      minsky().wiringOrder.addWire(*w);
     return wires.back();
   }
   WirePtr GroupItems::addWire(const Item& from, const Item& to, unsigned toPortIdx, const std::vector<float>& coords) {
@@ -340,6 +526,19 @@ namespace minsky
       if (w->from()==fromP)
         return WirePtr();
 
+    // disallow wires that would close a cycle of dependencies
+    if (inModel())
+      {
+        auto& order=minsky().wiringOrder;
+        if (!order.valid())
+          order.rebuild(*minsky().model);
+        if (order.valid() && order.wouldCycle(from, to))
+          {
+            cminsky().displayErrorItem(to);
+            return WirePtr();
+          }
+      }
+
     auto w=addWire(new Wire(fromP, toP, coords));
     adjustWiresGroup(*w);
 
@@ -473,6 +672,15 @@ namespace minsky
     return localZoom;
   }
 
+  void Group::resize(float w, float h)
+  {
+    width=w;
+    height=h;
+    invalidateGeometry();
+    if (auto g=group.lock())
+      g->itemResized(*this);
+  }
+
   float Group::computeDisplayZoom()
   {
     double x0, x1, y0, y1;
@@ -504,10 +712,12 @@ namespace minsky
     if (x0<x()-0.5*zoomFactor*width || x1>x()+0.5*zoomFactor*width || 
         y0<y()-0.5*zoomFactor*height || y1>y()+0.5*zoomFactor*height)
       return nullptr;
-    // at this point, this is a candidate. Check if any child groups are also
-    for (auto& g: groups)
-      if (auto mg=g->minimalEnclosingGroup(x0,y0,x1,y1))
-        return mg;
+    // at this point, this is a candidate. Check if any child groups
+    // near the rectangle are also
+    for (auto& i: itemsIntersecting(BoundingBox(x0,y0,x1,y1)))
+      if (auto g=dynamic_cast<const Group*>(i.get()))
+        if (auto mg=g->minimalEnclosingGroup(x0,y0,x1,y1))
+          return mg;
     return this;
   }
 
@@ -519,6 +729,7 @@ namespace minsky
     float lzoom=localZoom();
     for (auto& i: items)
       i->zoomFactor=lzoom;
+    invalidateSpatialIndex();
     m_displayContentsChanged = dpc!=displayContents();
     for (auto& i: groups)
       {
@@ -527,11 +738,23 @@ namespace minsky
       }
   }
 
+  void Group::invalidateGeometry() const
+  {
+    Item::invalidateGeometry();
+    for (auto& i: items)
+      i->invalidateGeometry();
+    for (auto& i: groups)
+      i->invalidateGeometry();
+  }
+
   void Group::zoom(float xOrigin, float yOrigin,float factor)
   {
      bool dpc=displayContents();
      Item::zoom(xOrigin, yOrigin, factor);
      m_displayContentsChanged = dpc!=displayContents();
+     // contents shown or hidden are not zoomed, so must be remeasured
+     if (m_displayContentsChanged)
+       invalidateSpatialIndex();
      for (auto& i: items)
        {
          i->m_visible=displayContents();
@@ -555,20 +778,54 @@ namespace minsky
   ClosestPort::ClosestPort(const Group& g, InOut io, float x, float y)
   {
     float minr2=std::numeric_limits<float>::max();
-    g.recursiveDo(&Group::items, [&](const Items& m, Items::const_iterator i)
-                  {
-                    for (auto& p: (*i)->ports)
-                      if ((io!=out && p->input()) || (io!=in && !p->input()))
-                        {
-                          float r2=sqr(p->x()-x)+sqr(p->y()-y);
-                          if (r2<minr2)
-                            {
-                              shared_ptr<Port>::operator=(p);
-                              minr2=r2;
-                            }
-                        }
-                    return false;
-                  });
+    auto closest=[&](const Item& i) {
+      for (auto& p: i.ports)
+        if ((io!=out && p->input()) || (io!=in && !p->input()))
+          {
+            float r2=sqr(p->x()-x)+sqr(p->y()-y);
+            if (r2<minr2)
+              {
+                shared_ptr<Port>::operator=(p);
+                minr2=r2;
+              }
+          }
+    };
+
+    // search squares of increasing size about (x,y). Indexed boxes
+    // enclose their items' ports, so once a port is found within the
+    // square, no closer port lies outside it. Contents of groups may
+    // lie outside their group's icon, so all groups are searched.
+    for (float r=100; ; r*=2)
+      {
+        BoundingBox square(x-r, y-r, x+r, y+r), extent(x,y,x,y);
+        GroupRecursiveDo
+          (g, &GroupItems::groups, [&](const Groups&, Groups::const_iterator i) {
+            for (auto& j: (*i)->itemsIntersecting(square))
+              if (!dynamic_cast<Group*>(j.get()))
+                closest(*j);
+            return false;
+          });
+        for (auto& j: g.itemsIntersecting(square))
+          if (!dynamic_cast<Group*>(j.get()))
+            closest(*j);
+        if (minr2<=r*r) break;
+
+        // stop once the square covers every indexed item
+        auto addExtent=[&](const Group& h) {
+          if (!h.spatialIndex.empty())
+            {
+              auto& b=h.spatialIndex.bounds();
+              extent|=BoundingBox(b.x0+h.x(), b.y0+h.y(), b.x1+h.x(), b.y1+h.y());
+            }
+        };
+        addExtent(g);
+        GroupRecursiveDo
+          (g, &GroupItems::groups, [&](const Groups&, Groups::const_iterator i) {
+            addExtent(**i);
+            return false;
+          });
+        if (square.contains(extent)) break;
+      }
   }
 
   void Group::draw(cairo_t* cairo) const
@@ -595,8 +852,9 @@ namespace minsky
     drawIORegion(cairo);
 
     cairo_translate(cairo, -0.5*width+leftMargin, -0.5*height);
-
-
+    // frame lines are stroked undistorted by the horizontal scaling
+    cairo_matrix_t frameMatrix;
+    cairo_get_matrix(cairo, &frameMatrix);
               
     double scalex=double(width-leftMargin-rightMargin)/width;
     cairo_scale(cairo, scalex, 1);
@@ -604,7 +862,7 @@ namespace minsky
     // draw a simple frame 
     cairo_rectangle(cairo,0,0,width,height);
     cairo_save(cairo);
-    cairo_identity_matrix(cairo);
+    cairo_set_matrix(cairo, &frameMatrix);
     cairo_set_line_width(cairo,1);
     cairo_stroke(cairo);
     cairo_restore(cairo);
@@ -686,8 +944,14 @@ namespace minsky
         cairo_rotate(cairo,M_PI*rotation/180);
         auto& v=vars[i];
         v->m_visible=false;
-        v->m_x=r.x(x,y); v->m_y=r.y(x,y);
-        v->zoomFactor=0.75*edgeScale();
+        float vx=r.x(x,y), vy=r.y(x,y), vz=0.75*edgeScale();
+        if (vx!=v->m_x || vy!=v->m_y || vz!=v->zoomFactor)
+          {
+            v->m_x=vx; v->m_y=vy;
+            v->zoomFactor=vz;
+            v->invalidateGeometry();
+            itemResized(*v);
+          }
         RenderVariable rv(*v,cairo);
         rv.draw();
         if (i==0)
@@ -27,10 +27,18 @@
 #include "variable.h"
 #include <function.h>
 #include "SVGItem.h"
+#include "spatialIndex.h"
 
 namespace minsky
 {
   class Group;
+  class OperationBase;
+  class GodleyIcon;
+  class SwitchIcon;
+
+  /// box enclosing \a w's curve and arrow head, in canvas coordinates
+  BoundingBox wireBounds(const Wire& w);
+
   class GroupPtr: public ItemPtr
   {
   public:
@@ -55,6 +63,19 @@ namespace minsky
     Groups groups;
     Wires wires;
     std::vector<VariablePtr> inVariables, outVariables;
+
+    /// items of the kinds visited by model-wide passes, also held in
+    /// items, so those passes need not dynamic_cast every item.
+    /// Maintained by addItem, removeItem and clear.
+    classdesc::Exclude<std::vector<std::shared_ptr<VariableBase> > > variables;
+    classdesc::Exclude<std::vector<std::shared_ptr<OperationBase> > > operations;
+    classdesc::Exclude<std::vector<std::shared_ptr<GodleyIcon> > > godleyIcons;
+    classdesc::Exclude<std::vector<std::shared_ptr<PlotWidget> > > plots;
+    classdesc::Exclude<std::vector<std::shared_ptr<SwitchIcon> > > switches;
+
+    /// bounding boxes of the items and groups directly within this group
+    mutable classdesc::Exclude<GroupSpatialIndex> spatialIndex;
+
     GroupItems() {}
     GroupItems(const GroupItems& x) {*this=x;}
     virtual ~GroupItems() {}
@@ -65,6 +86,12 @@ namespace minsky
       wires.clear();
       inVariables.clear();
       outVariables.clear();
+      variables.clear();
+      operations.clear();
+      godleyIcons.clear();
+      plots.clear();
+      switches.clear();
+      invalidateSpatialIndex();
     }
     bool empty() const {return items.empty() && groups.empty() && wires.empty();}
 
@@ -104,9 +131,23 @@ namespace minsky
     template <class R, class M, class C, class X>
     std::vector<R> findAll(C c, M (GroupItems::*m), X xfm) const;
 
+    /// apply \a f to the shared pointer of each item of the kind
+    /// indexed by \a kind (eg &GroupItems::plots), in this group and
+    /// its subgroups
+    template <class T, class F>
+    void forEachOfKind(classdesc::Exclude<std::vector<std::shared_ptr<T> > > GroupItems::*kind, F f) const;
+
     ItemPtr removeItem(const Item&);
     WirePtr removeWire(const Wire&);
     GroupPtr removeGroup(const Group&);
+    /// @{ as removeItem and removeGroup, for items about to be added
+    /// to another group of the model, so their wiring order is retained
+    ItemPtr detachItem(const Item&);
+    GroupPtr detachGroup(const Group&);
+    /// @}
+    /// true if these items belong to the current model, rather than
+    /// to a copy such as the clipboard's
+    bool inModel() const;
 
     /// finds item within this group or subgroups. Returns null if not found
     ItemPtr findItem(const Item& it) const; 
@@ -157,6 +198,26 @@ namespace minsky
 
     /// splits any wires that cross group boundaries
     void splitBoundaryCrossingWires();
+
+    /// update the spatial index for \a it, directly within this
+    /// group, which has moved
+    void itemMoved(const Item& it) const;
+    /// update the spatial index for \a it, directly within this
+    /// group, whose icon has changed size
+    void itemResized(const Item& it) const;
+    /// update the spatial index for \a it, directly within this
+    /// group, which has been zoomed by \a factor. Icons scale with
+    /// their zoom factor, so the box is scaled rather than remeasured
+    void itemZoomed(const Item& it, float factor) const;
+    /// discard the spatial index, eg when label fonts change
+    void invalidateSpatialIndex() const {spatialIndex.invalidate();}
+
+  private:
+    /// add \a it to, or remove it from, the index of its kind
+    void indexItem(const ItemPtr& it);
+    void unindexItem(const Item& it);
+    /// remove \a it, and any contents, from the model's wiring order
+    void forgetWiring(const Item& it) const;
   };
 
   template <class G, class M, class O>
@@ -179,15 +240,23 @@ namespace minsky
   public:
     std::string title;
     float width{100}, height{100}; // size of icon
+    /// set the icon size, keeping the enclosing group's spatial
+    /// index current. Use in preference to assigning width/height
+    void resize(float w, float h);
 
     /// @returns a shared_ptr to this. NULL if this cannot be found in parent group
     std::shared_ptr<Group> self() const;
-    void setItemGroup(const ItemPtr& it) const override {it->group=self();}
+    void setItemGroup(const ItemPtr& it) const override {
+      it->group=self();
+      it->invalidateGeometry();
+    }
     bool nocycles() const override; 
 
     static SVGRenderer svgRenderer;
 
     void draw(cairo_t*) const override;
+    /// drawing positions the I/O variables
+    bool iconCacheable() const override {return false;}
     void setCairoSurface(const ecolab::cairo::SurfacePtr& s) override 
     {if (displayPlot) displayPlot->groupPlot=s;}
 
@@ -248,6 +317,7 @@ namespace minsky
     /// zoomfactor on contained objects to the computed localzoom
     void setZoom(float factor);
     void zoom(float xOrigin, float yOrigin,float factor) override;
+    void invalidateGeometry() const override;
 
     /// scale used to render io variables. Smoothly interpolates
     /// between the scale at which internal items are displayed, and
@@ -274,6 +344,11 @@ namespace minsky
     const Group* minimalEnclosingGroup(float x0, float y0, float x1, float y1) const;
     Group* minimalEnclosingGroup(float x0, float y0, float x1, float y1) 
     {return const_cast<Group*>(const_cast<const Group*>(this)->minimalEnclosingGroup(x0,y0,x1,y1));}
+
+    /// returns the items and groups directly within this group whose
+    /// icons may intersect \a box, given in canvas coordinates, using
+    /// the spatial index. Candidates should be tested exactly.
+    std::vector<ItemPtr> itemsIntersecting(const BoundingBox& box) const;
       
     /// scaling factor to allow a rotated icon to fit on the bitmap
     float rotFactor() const;
@@ -321,6 +396,15 @@ namespace minsky
     return r;
   }
 
+  template <class T, class F>
+  void GroupItems::forEachOfKind(classdesc::Exclude<std::vector<std::shared_ptr<T> > > GroupItems::*kind, F f) const
+  {
+    for (auto& i: this->*kind)
+      f(i);
+    for (auto& g: groups)
+      g->forEachOfKind(kind, f);
+  }
+
 }
 
 #ifdef CLASSDESC
@@ -0,0 +1,166 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "iconCache.h"
+#include "item.h"
+#include <cairo_base.h>
+#include <cmath>
+#include <ecolab_epilogue.h>
+using namespace std;
+
+namespace minsky
+{
+  IconCache& iconCache()
+  {
+    // never destroyed, as items may outlive static destruction
+    static IconCache* cache=new IconCache;
+    return *cache;
+  }
+
+  void IconCache::draw(const Item& item, cairo_t* cairo)
+  {
+    // vector output (exports) must be drawn directly
+    switch (cairo_surface_get_type(cairo_get_target(cairo)))
+      {
+      case CAIRO_SURFACE_TYPE_PDF: case CAIRO_SURFACE_TYPE_PS:
+      case CAIRO_SURFACE_TYPE_SVG: case CAIRO_SURFACE_TYPE_RECORDING:
+        item.draw(cairo);
+        return;
+      default: break;
+      }
+    // images are only copied pixel for pixel. Ports shown under the
+    // mouse are drawn in canvas coordinates, so are not cached
+    cairo_matrix_t m;
+    cairo_get_matrix(cairo, &m);
+    if (m.xx!=1 || m.yy!=1 || m.xy!=0 || m.yx!=0 ||
+        item.mouseFocus || !item.iconCacheable())
+      {
+        item.draw(cairo);
+        return;
+      }
+
+    Key key;
+    key.state=item.iconState();
+    key.zoomFactor=item.zoomFactor;
+    key.rotation=item.rotation;
+    key.selected=item.selected;
+
+    shared_ptr<cairo_surface_t> image;
+    int x0, y0;
+    {
+      lock_guard<std::mutex> lock(mutex);
+      auto i=icons.find(&item);
+      if (i!=icons.end() && i->second.key==key)
+        {
+          ++m_hits;
+          lru.splice(lru.begin(), lru, i->second.lru);
+        }
+      else
+        {
+          ++m_misses;
+          if (i==icons.end())
+            {
+              i=icons.emplace(&item, Icon()).first;
+              i->second.lru=lru.insert(lru.begin(), &item);
+            }
+          else
+            lru.splice(lru.begin(), lru, i->second.lru);
+          m_bytes-=i->second.bytes;
+          i->second.key=key;
+          render(item, cairo, i->second);
+          m_bytes+=i->second.bytes;
+        }
+      image=i->second.image;
+      x0=i->second.x0;
+      y0=i->second.y0;
+      evict();
+    }
+
+    if (image)
+      {
+        // align the image with device pixels
+        cairo_save(cairo);
+        cairo_set_source_surface(cairo, image.get(), x0+round(m.x0)-m.x0, y0+round(m.y0)-m.y0);
+        cairo_paint(cairo);
+        cairo_restore(cairo);
+      }
+  }
+
+  void IconCache::render(const Item& item, cairo_t* target, Icon& icon)
+  {
+    ecolab::cairo::Surface rec
+      (cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,nullptr));
+    // draw with the target's settings
+    cairo_set_source(rec.cairo(), cairo_get_source(target));
+    cairo_set_line_width(rec.cairo(), cairo_get_line_width(target));
+    cairo_set_font_face(rec.cairo(), cairo_get_font_face(target));
+    cairo_matrix_t fontMatrix;
+    cairo_get_font_matrix(target, &fontMatrix);
+    cairo_set_font_matrix(rec.cairo(), &fontMatrix);
+    item.draw(rec.cairo());
+    double x,y,w,h;
+    cairo_recording_surface_ink_extents(rec.surface(), &x, &y, &w, &h);
+    icon.image.reset();
+    icon.bytes=0;
+    if (w<=0 || h<=0) return;
+    // allow a pixel for antialiasing
+    icon.x0=int(floor(x))-1;
+    icon.y0=int(floor(y))-1;
+    int width=int(ceil(x+w))+1-icon.x0, height=int(ceil(y+h))+1-icon.y0;
+    icon.image.reset(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height),
+                     cairo_surface_destroy);
+    cairo_t* cairo=cairo_create(icon.image.get());
+    cairo_set_source_surface(cairo, rec.surface(), -icon.x0, -icon.y0);
+    cairo_paint(cairo);
+    cairo_destroy(cairo);
+    cairo_surface_flush(icon.image.get());
+    icon.bytes=size_t(cairo_image_surface_get_stride(icon.image.get()))*height;
+  }
+
+  void IconCache::evict()
+  {
+    // always keep the icon just drawn
+    while (m_bytes>maxBytes && lru.size()>1)
+      {
+        auto i=icons.find(lru.back());
+        m_bytes-=i->second.bytes;
+        icons.erase(i);
+        lru.pop_back();
+      }
+  }
+
+  void IconCache::forget(const Item& item)
+  {
+    lock_guard<std::mutex> lock(mutex);
+    auto i=icons.find(&item);
+    if (i!=icons.end())
+      {
+        m_bytes-=i->second.bytes;
+        lru.erase(i->second.lru);
+        icons.erase(i);
+      }
+  }
+
+  void IconCache::clear()
+  {
+    lock_guard<std::mutex> lock(mutex);
+    icons.clear();
+    lru.clear();
+    m_bytes=0;
+  }
+}
@@ -0,0 +1,105 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+#include <cairo.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace minsky
+{
+  class Item;
+
+  /**
+     Rasterised icons of items, keyed by the state they were drawn
+     in, so that an unchanged icon is redrawn by copying its image.
+     Icons are drawn to the cache with their origin at the device
+     origin, and copied to raster surfaces whose transformation is a
+     whole pixel translation. Other targets, such as the vector
+     surfaces used for export, are drawn to directly.
+
+     Memory used by the images is bounded by maxBytes, the least
+     recently drawn icons being discarded first.
+  */
+  class IconCache
+  {
+  public:
+    /// memory budget for cached images, in bytes
+    size_t maxBytes=64<<20;
+
+    /// draw \a item's icon to \a cairo, whose origin is the item's
+    /// position, from the cache if possible
+    void draw(const Item& item, cairo_t* cairo);
+    /// discard \a item's icon, if cached
+    void forget(const Item& item);
+    void clear();
+
+    size_t hits() const {return m_hits;}
+    size_t misses() const {return m_misses;}
+    /// fraction of cacheable draws served from the cache
+    double hitRate() const
+    {return m_hits+m_misses? double(m_hits)/(m_hits+m_misses): 0;}
+    void resetStats() {m_hits=m_misses=0;}
+    /// memory held by cached images, in bytes
+    size_t bytes() const {return m_bytes;}
+    size_t size() const {return icons.size();}
+
+  private:
+    struct Key
+    {
+      std::string state;
+      float zoomFactor=1;
+      double rotation=0;
+      bool selected=false;
+      bool operator==(const Key& x) const {
+        return zoomFactor==x.zoomFactor && rotation==x.rotation &&
+          selected==x.selected && state==x.state;
+      }
+    };
+    struct Icon
+    {
+      Key key;
+      std::shared_ptr<cairo_surface_t> image;
+      /// position of the image's top left corner relative to the item
+      int x0=0, y0=0;
+      size_t bytes=0;
+      std::list<const Item*>::iterator lru;
+    };
+    std::unordered_map<const Item*, Icon> icons;
+    /// items by time last drawn, most recent first
+    std::list<const Item*> lru;
+    size_t m_bytes=0, m_hits=0, m_misses=0;
+    /// items may be destroyed on other threads
+    std::mutex mutex;
+
+    /// draw \a item to a new image, with the settings of \a target,
+    /// setting \a icon
+    static void render(const Item& item, cairo_t* target, Icon& icon);
+    void evict();
+  };
+
+  /// cache of icons drawn to the canvas
+  IconCache& iconCache();
+}
+
+#endif
@@ -23,6 +23,7 @@
 #include "variable.h"
 #include "latexMarkup.h"
 #include "geometry.h"
+#include "iconCache.h"
 #include <pango.h>
 #include <cairo_base.h>
 #include <ecolab_epilogue.h>
@@ -33,20 +34,35 @@ using namespace std;
 namespace minsky
 {
 
-  float Item::x() const 
+  void Item::updatePosition() const
   {
+    // compare owners, which does not need the group to be locked
+    if (position.valid && position.m_x==m_x && position.m_y==m_y &&
+        !position.group.owner_before(group) && !group.owner_before(position.group))
+      return;
+    position.m_x=m_x;
+    position.m_y=m_y;
+    position.group=group;
     if (auto g=group.lock())
-      return m_x+g->x();
+      {
+        position.x=m_x+g->x();
+        position.y=m_y+g->y();
+      }
     else
-      return m_x;
+      {
+        position.x=m_x;
+        position.y=m_y;
+      }
+    position.valid=true;
   }
 
-  float Item::y() const 
+  void Item::invalidateGeometry() const
   {
-    if (auto g=group.lock())
-      return m_y+g->y();
-    else
-      return m_y;
+    position.valid=false;
+    for (auto& p: ports)
+      if (p)
+        for (auto w: p->wires)
+          w->invalidateGeometry();
   }
 
   bool Item::visible() const 
@@ -75,11 +91,14 @@ namespace minsky
       {
         m_x=x-g->x();
         m_y=y-g->y();
+        invalidateGeometry();
+        g->itemMoved(*this);
       }
     else
       {
         m_x=x;
         m_y=y;
+        invalidateGeometry();
       }
     assert(near(x,this->x()) && near(y, this->y()));
   }
@@ -117,6 +136,8 @@ namespace minsky
             m_y*=factor;
           }
         zoomFactor*=factor;
+        invalidateGeometry();
+        if (g) g->itemZoomed(*this, factor);
       }
   }
 
@@ -134,6 +155,16 @@ namespace minsky
     cairo_restore(cairo);
   }
 
+  Item::~Item()
+  {
+    iconCache().forget(*this);
+  }
+
+  void Item::drawCached(cairo_t* cairo) const
+  {
+    iconCache().draw(*this, cairo);
+  }
+
   // default is just to display the detailed text (ie a "note")
   void Item::draw(cairo_t* cairo) const
   {
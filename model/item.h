@@ -55,14 +55,38 @@ namespace minsky
 
   class VariablePtr;
 
+  /// canvas position of an item, cached to avoid walking up its
+  /// group hierarchy. It is checked against the relative position and
+  /// group it was computed from, and invalidated when a group above
+  /// the item moves. Copies are invalid.
+  struct PositionCache
+  {
+    float x=0, y=0;
+    float m_x=0, m_y=0;
+    std::weak_ptr<Group> group;
+    bool valid=false;
+    PositionCache() {}
+    PositionCache(const PositionCache&) {}
+    PositionCache& operator=(const PositionCache&) {valid=false; return *this;}
+  };
+
   class Item: public NoteBase
   {
+    CLASSDESC_ACCESS(Item);
+    mutable classdesc::Exclude<PositionCache> position;
+    /// ensure position is valid
+    void updatePosition() const;
   public:
-    float m_x=0, m_y=0; ///< position in canvas, or within group
+    /// position in canvas, or within group. Call invalidateGeometry()
+    /// after assigning these directly
+    float m_x=0, m_y=0;
     float zoomFactor=1;
     double rotation=0; ///< rotation of icon, in degrees
     bool m_visible=true; ///< if false, then this item is invisible
     std::weak_ptr<Group> group;
+    /// position of this item in its group's index of its kind (eg
+    /// GroupItems::plots), maintained by GroupItems
+    size_t kindIndexPos=0;
     /// indicates this is a group I/O variable
     virtual bool ioVar() const {return false;}
     
@@ -72,8 +96,14 @@ namespace minsky
     virtual void setCairoSurface(const ecolab::cairo::SurfacePtr&) {}
 
     ItemPortVector ports;
-    float x() const; 
-    float y() const; 
+    /// canvas position. These update a cache on the item, so must
+    /// only be called from the GUI thread, not from export or plot
+    /// worker threads
+    float x() const {updatePosition(); return position.x;}
+    float y() const {updatePosition(); return position.y;}
+    /// discard cached positions of this item, its contents, and the
+    /// wires attached to them, after the item has moved
+    virtual void invalidateGeometry() const;
 
     virtual Item* clone() const {return new Item(*this);}
 
@@ -87,9 +117,22 @@ namespace minsky
 
     /// draw this item into a cairo context
     virtual void draw(cairo_t* cairo) const;
-    /// update display after a step()
+    /// draw this item into a cairo context, copying its icon from
+    /// iconCache() if it has not changed since last drawn
+    void drawCached(cairo_t* cairo) const;
+    /// false if this item's icon cannot be cached, eg because drawing
+    /// it positions other items
+    virtual bool iconCacheable() const {return true;}
+    /// state, besides zoom, rotation and selection, that determines
+    /// how the icon is drawn
+    virtual std::string iconState() const {return detailedText;}
+    /// true if this item's display depends on simulation values, and
+    /// so needs updateIcon() called after each step
+    virtual bool liveIcon() const {return false;}
+    /// update display after a step(). Only called for items
+    /// returning true from liveIcon()
     virtual void updateIcon(double t) {}
-    virtual ~Item() {}
+    virtual ~Item();
 
     void drawPorts(cairo_t* cairo) const;
 
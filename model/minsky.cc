@@ -20,6 +20,9 @@
 #include "minsky.h"
 #include "flowCoef.h"
 #include "cairoItems.h"
+#include "switchIcon.h"
+#include "pngStream.h"
+#include <pango.h>
 
 #include "TCL_obj_stl.h"
 #include <gsl/gsl_errno.h>
@@ -28,14 +31,13 @@
 
 //#include <schema/schema0.h>
 #include <schema/schema1.h>
+#include <schema/schema1Stream.h>
+#include <schema/schema1Binary.h>
 
 #include <cairo/cairo-ps.h>
 #include <cairo/cairo-pdf.h>
 #include <cairo/cairo-svg.h>
 
-// undocumented internal function in the Tk library
-extern "C" int TkMakeBezierCurve(Tk_Canvas,double*,int,int,void*,double*);
-
 using namespace minsky;
 using namespace classdesc;
 
@@ -43,93 +45,171 @@ namespace
 {
   const char* schemaURL="http://minsky.sf.net/minsky";
 
-  inline bool isFinite(const double y[], size_t n)
+  /// read a model file in either the XML or binary format
+  void readSchema(const string& filename, schema1::Minsky& m)
   {
-    for (size_t i=0; i<n; ++i)
-      if (!isfinite(y[i])) return false;
-    return true;
+    if (schema1::isBinaryModel(filename))
+      {
+        schema1::loadBinary(filename, m);
+        return;
+      }
+    ifstream inf(filename);
+    if (!inf)
+      throw runtime_error("failed to open "+filename);
+    schema1::streamUnpack(inf, m);
   }
 
-  /*
-    For using GSL Runge-Kutta routines
-  */
-
-  int RKfunction(double t, const double y[], double f[], void *params)
+  /// write a model file, in binary format if \a filename has a
+  /// .mkyb extension, XML otherwise
+  void writeSchema(const string& filename, const schema1::Minsky& m)
   {
-    if (params==NULL) return GSL_EBADFUNC;
-    try
+    if (schema1::isBinaryFileName(filename))
       {
-        ((Minsky*)params)->evalEquations(f,t,y);
+        schema1::saveBinary(m, filename);
+        return;
       }
-    catch (std::exception& e)
+    ofstream of(filename);
+    xml_pack_t saveFile(of, schemaURL);
+    saveFile.prettyPrint=true;
+    xml_pack(saveFile, "Minsky", m);
+    if (!of)
+      throw runtime_error("cannot save to "+filename);
+  }
+
+  /// write snapshot \a m of a model, and the equations compiled
+  /// from it (if any), replacing the existing files only once fully
+  /// written
+  void writeModel(const string& filename, schema1::Minsky& m,
+                  const shared_ptr<CompiledEquations>& equations)
+  {
+    m.relocateCanvas();
+    BackgroundSaver::writeAtomically
+      (filename, [&](const string& f){writeSchema(f, m);});
+    string eqFile=CompiledEquations::fileName(filename);
+    if (equations)
       {
-        Tcl_AppendResult(interp(),e.what(),NULL);
-        Tcl_AppendResult(interp(),"\n",NULL);
-        return GSL_EBADFUNC;
+        equations->modelHash=m.model.structuralHash();
+        BackgroundSaver::writeAtomically
+          (eqFile, [&](const string& f){equations->write(f);});
       }
-    return GSL_SUCCESS;
+    else
+      remove(eqFile.c_str());
   }
 
-  int jacobian(double t, const double y[], double * dfdy, double dfdt[], void * params)
+  inline bool isFinite(const double y[], size_t n)
   {
-   if (params==NULL) return GSL_EBADFUNC;
-   Minsky::Matrix jac(ValueVector::stockVars.size(), dfdy);
-   try
-     {
-       ((Minsky*)params)->jacobian(jac,t,y);
-     }
-    catch (std::exception& e)
-     {
-       Tcl_AppendResult(interp(),e.what(),NULL);
-       Tcl_AppendResult(interp(),"\n",NULL);
-       return GSL_EBADFUNC;
-     }   
-    return GSL_SUCCESS;
+    for (size_t i=0; i<n; ++i)
+      if (!isfinite(y[i])) return false;
+    return true;
   }
 }
 
 namespace minsky
 {
-
+  /*
+    For using GSL Runge-Kutta routines
+  */
   struct RKdata
   {
     gsl_odeiv2_system sys;
     gsl_odeiv2_driver* driver;
+    const Minsky& minsky;
+    /// flow variable initialisers. If null, those of minsky are used
+    const vector<double>* flowBase=nullptr;
+    /// if set, evaluation errors are reported here rather than to
+    /// the GUI (for integrators run on scenario threads)
+    string* errorMsg=nullptr;
 
     static void errHandler(const char* reason, const char* file, int line, int gsl_errno) {
       throw error("gsl: %s:%d: %s",file,line,reason);
     }
 
-    RKdata(Minsky* minsky) {
+    const vector<double>& flows() const
+    {return flowBase? *flowBase: minsky.flowBase();}
+
+    /// pass an evaluation error message back to the caller of the
+    /// integrator. The TCL interpreter may only be used from the GUI thread.
+    void reportError(const std::exception& e) const
+    {
+      if (errorMsg)
+        *errorMsg+=string(e.what())+"\n";
+      else if (minsky.solver && minsky.solver->onSolverThread())
+        minsky.solver->setError(e.what());
+      else
+        {
+          Tcl_AppendResult(interp(),e.what(),NULL);
+          Tcl_AppendResult(interp(),"\n",NULL);
+        }
+    }
+
+    static int function(double t, const double y[], double f[], void *params)
+    {
+      if (params==NULL) return GSL_EBADFUNC;
+      auto& rk=*(RKdata*)params;
+      try
+        {
+          rk.minsky.evalDerivatives(f,t,y,rk.flows());
+        }
+      catch (std::exception& e)
+        {
+          rk.reportError(e);
+          return GSL_EBADFUNC;
+        }
+      return GSL_SUCCESS;
+    }
+
+    static int jacobian(double t, const double y[], double * dfdy, double dfdt[], void * params)
+    {
+      if (params==NULL) return GSL_EBADFUNC;
+      auto& rk=*(RKdata*)params;
+      Minsky::Matrix jac(rk.sys.dimension, dfdy);
+      try
+        {
+          rk.minsky.evalJacobian(jac,t,y,rk.flows());
+        }
+      catch (std::exception& e)
+        {
+          rk.reportError(e);
+          return GSL_EBADFUNC;
+        }   
+      return GSL_SUCCESS;
+    }
+
+    /// \a dimension is the number of stock variables, fixed for the
+    /// life of the integrator
+    RKdata(const Minsky& minsky, size_t dimension): minsky(minsky) {
       gsl_set_error_handler(errHandler);
-      sys.function=RKfunction;
+      sys.function=function;
       sys.jacobian=jacobian;
-      sys.dimension=ValueVector::stockVars.size();
-      sys.params=minsky;
+      sys.dimension=dimension;
+      sys.params=this;
       const gsl_odeiv2_step_type* stepper;
-      switch (minsky->order)
+      switch (minsky.order)
         {
         case 1: 
-          if (!minsky->implicit)
+          if (!minsky.implicit)
             throw error("First order explicit solver not available");
           stepper=gsl_odeiv2_step_rk1imp;
           break;
         case 2: 
-          stepper=minsky->implicit? gsl_odeiv2_step_rk2imp: gsl_odeiv2_step_rk2;
+          stepper=minsky.implicit? gsl_odeiv2_step_rk2imp: gsl_odeiv2_step_rk2;
           break;
         case 4:
-          stepper=minsky->implicit? gsl_odeiv2_step_rk4imp: gsl_odeiv2_step_rkf45;
+          stepper=minsky.implicit? gsl_odeiv2_step_rk4imp: gsl_odeiv2_step_rkf45;
           break;
         default:
-          throw error("order %d solver not supported",minsky->order);
+          throw error("order %d solver not supported",minsky.order);
         }
       driver = gsl_odeiv2_driver_alloc_y_new
-        (&sys, stepper, minsky->stepMax, minsky->epsAbs, 
-         minsky->epsRel);
-      gsl_odeiv2_driver_set_hmax(driver, minsky->stepMax);
-      gsl_odeiv2_driver_set_hmin(driver, minsky->stepMin);
+        (&sys, stepper, minsky.stepMax, minsky.epsAbs, 
+         minsky.epsRel);
+      gsl_odeiv2_driver_set_hmax(driver, minsky.stepMax);
+      gsl_odeiv2_driver_set_hmin(driver, minsky.stepMin);
     }
     ~RKdata() {gsl_odeiv2_driver_free(driver);}
+    // sys.params refers to this
+    RKdata(const RKdata&)=delete;
+    void operator=(const RKdata&)=delete;
   };
 }
 
@@ -139,42 +219,74 @@ namespace minsky
 
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <limits>
 using namespace std;
 
 namespace minsky
 {
   void Minsky::openLogFile(const string& name)
   {
-    outputDataFile.reset(new ofstream(name));
-    *outputDataFile<< "#time";
+    closeLogFile(); // ensure any previous log is flushed first
+    vector<string> columns;
     for (auto& v: variableValues)
-      *outputDataFile<<" "<<v.first;
-    *outputDataFile<<endl;
+      if (logVarList.empty() || logVarList.count(v.first))
+        columns.push_back(v.first);
+    outputDataFile.reset
+      (new LogWriter(name, columns, logBufferSize, logDropWhenFull));
   }
 
-  /// write current state of all variables to the log file
-  void Minsky::logVariables() const
+  /// queue current state of logged variables for the log writer thread
+  void Minsky::logVariables()
   {
     if (outputDataFile)
       {
-        *outputDataFile<<t;
+        logRecord.clear();
+        logRecord.push_back(t);
         for (auto& v: variableValues)
-          *outputDataFile<<" "<<v.second.value();
-        *outputDataFile<<endl;
+          if (logVarList.empty() || logVarList.count(v.first))
+            logRecord.push_back(v.second.value());
+        outputDataFile->push(logRecord);
+        // stop logging on a write error, such as a full disk
+        if (outputDataFile->failed())
+          closeLogFile();
       }
   }        
-        
-      
+
+  unsigned Minsky::plotHistoryCapacity(unsigned c)
+  {
+    if (c<PlotHistory::minCapacity)
+      throw error("plot history capacity must be at least %d",int(PlotHistory::minCapacity));
+    return m_plotHistoryCapacity=c;
+  }
+
+  void Minsky::closeLogFile()
+  {
+    if (!outputDataFile) return;
+    outputDataFile->close();
+    bool failed=outputDataFile->failed();
+    string name=outputDataFile->fileName();
+    outputDataFile.reset();
+    if (failed)
+      throw error("error writing log file %s",name.c_str());
+  }
 
   void Minsky::clearAllMaps()
   {
     model->clear();
     equations.clear();
     integrals.clear();
+    liveIcons.clear();
     variableValues.clear();
     
     flowVars.clear();
     stockVars.clear();
+    pendingEquations.reset();
+    pendingItems.clear();
+    wiringOrder.invalidate();
 //    evalGodley.initialiseGodleys(makeGodleyIt(godleyItems.begin()),
 //        makeGodleyIt(godleyItems.end()), variables.values);
 
@@ -186,6 +298,7 @@ namespace minsky
 //#endif
 
     flags=reset_needed;
+    equationViewStale=true;
   }
 
 
@@ -212,17 +325,15 @@ namespace minsky
 
     if (!topLevel) topLevel=&*model;
 
-    for (auto& i: topLevel->items)
-      if (i->visible() && lasso.intersects(*i))
-        {
-          currentSelection.items.push_back(i);
-          i->selected=true;
-        }
-
-    for (auto& i: topLevel->groups)
+    // only items near the lasso need be tested against it
+    for (auto& i: topLevel->itemsIntersecting
+           (BoundingBox(lasso.x0, lasso.y0, lasso.x1, lasso.y1)))
       if (i->visible() && lasso.intersects(*i))
         {
-          currentSelection.groups.push_back(i);
+          if (auto g=dynamic_pointer_cast<Group>(i))
+            currentSelection.groups.push_back(g);
+          else
+            currentSelection.items.push_back(i);
           i->selected=true;
         }
 
@@ -230,7 +341,11 @@ namespace minsky
       if (i->visible() && lasso.contains(*i))
         currentSelection.wires.push_back(i);
 
-    copy();
+    // the clipboard refers to the selection, and is only serialised
+    // if some application asks for it
+    clipboard.reset();
+    clipboardXML.clear();
+    clipboardOwned=clipboardOnDemand=claimClipboard();
   }
 
   void Minsky::cut()
@@ -254,13 +369,35 @@ namespace minsky
     currentSelection.clear();
   }
 
-  void Minsky::copy() const
+  void Minsky::copy()
   {
+    // snapshot in binary form, as the selection may subsequently be
+    // edited. XML is only produced for other applications
     schema1::Minsky m(currentSelection);
-    ostringstream os;
-    xml_pack_t packer(os, schemaURL);
-    xml_pack(packer, "Minsky", m);
-    putClipboard(os.str());
+    clipboard.reset(new pack_t);
+    *clipboard<<m;
+    clipboardXML.clear();
+    clipboardOnDemand=claimClipboard();
+    if (!clipboardOnDemand)
+      putClipboard(clipboardText());
+    clipboardOwned=true;
+  }
+
+  string Minsky::clipboardText() const
+  {
+    if (clipboardXML.empty())
+      {
+        schema1::Minsky m;
+        if (clipboard)
+          clipboard->reseto()>>m;
+        else
+          m=schema1::Minsky(currentSelection);
+        ostringstream os;
+        xml_pack_t packer(os, schemaURL);
+        xml_pack(packer, "Minsky", m);
+        clipboardXML=os.str();
+      }
+    return clipboardXML;
   }
 
   void Minsky::saveSelectionAsFile(const string& fileName) const
@@ -281,10 +418,24 @@ namespace minsky
 
   GroupPtr Minsky::paste()
   {
-    istringstream is(getClipboard());
-    xml_unpack_t unpacker(is);
     schema1::Minsky m;
-    xml_unpack(unpacker, "Minsky", m);
+    // without an on demand clipboard, another application may have
+    // replaced the copy placed there
+    if (clipboardOwned && !clipboardOnDemand && getClipboard()!=clipboardText())
+      clipboardLost();
+    if (clipboardOwned)
+      {
+        if (clipboard)
+          clipboard->reseto()>>m;
+        else
+          m=schema1::Minsky(currentSelection);
+      }
+    else
+      {
+        istringstream is(getClipboard());
+        xml_unpack_t unpacker(is);
+        xml_unpack(unpacker, "Minsky", m);
+      }
     GroupPtr g(new Group);
     m.populateGroup(*model->addGroup(g));
     return g;
@@ -299,9 +450,7 @@ namespace minsky
   GroupPtr Minsky::insertGroupFromFile(const char* file)
   {
     schema1::Minsky currentSchema;
-    ifstream inf(file);
-    xml_unpack_t saveFile(inf);
-    xml_unpack(saveFile, "Minsky", currentSchema);
+    readSchema(file, currentSchema);
 
     if (currentSchema.version != currentSchema.schemaVersion)
       throw error("Invalid Minsky schema file");
@@ -353,16 +502,13 @@ namespace minsky
     set<string> existingNames;
     existingNames.insert("constant:zero");
     existingNames.insert("constant:one");
-    model->recursiveDo(&Group::items, 
-                       [&](Items&,Items::iterator i) {
-                         if (auto v=dynamic_cast<VariableBase*>(i->get()))
+    // ensure Godley table variables are the correct types
+    model->forEachOfKind(&GroupItems::godleyIcons,
+                         [&](const shared_ptr<GodleyIcon>& g) {g->update();});
+    model->forEachOfKind(&GroupItems::variables, 
+                         [&](const shared_ptr<VariableBase>& v) {
                            existingNames.insert(v->valueId());
-                         // ensure Godley table variables are the correct types
-                         if (auto g=dynamic_cast<GodleyIcon*>(i->get()))
-                           g->update();
-                         return false;
-                       }
-                       );
+                         });
     for (auto i=variableValues.begin(); i!=variableValues.end(); )
       if (existingNames.count(i->first))
         ++i;
@@ -393,12 +539,20 @@ namespace minsky
   void Minsky::renderEquationsToImage(const char* image)
   {
     ecolab::cairo::TkPhotoSurface surf(Tk_FindPhoto(interp(),image));
+    updateEquationView();
     cairo_move_to(surf.cairo(),0,0);
-    MathDAG::SystemOfEquations system(*this);
-    system.renderEquations(surf);
+    equationView.draw(surf.cairo());
     surf.blit();
   }
 
+  void Minsky::updateEquationView() const
+  {
+    if (!equationViewStale) return;
+    MathDAG::SystemOfEquations system(*this);
+    equationView.update(system);
+    equationViewStale=false;
+  }
+
   void Minsky::constructEquations()
   {
     if (cycleCheck()) throw error("cyclic network detected");
@@ -410,32 +564,241 @@ namespace minsky
     assert(variableValues.validEntries());
     system.populateEvalOpVector(equations, integrals);
     assert(variableValues.validEntries());
+    initialStockVars=stockVars;
+    initialFlowVars=flowVars;
+    attachEquations();
+  }
 
+  void Minsky::attachEquations()
+  {
     // attach the plots
-    model->recursiveDo
-      (&Group::items,
-       [&](Items& m, Items::iterator i)
+    model->forEachOfKind
+      (&GroupItems::plots,
+       [&](const shared_ptr<PlotWidget>& p)
        {
-         if (auto p=dynamic_cast<PlotWidget*>(i->get()))
+         p->yvars.clear(); // clear any old associations
+         p->xvars.clear(); 
+         p->clearPenAttributes();
+         p->autoScale();
+         for (size_t i=0; i<p->ports.size(); ++i)
            {
-             p->yvars.clear(); // clear any old associations
-             p->xvars.clear(); 
-             p->clearPenAttributes();
-             p->autoScale();
-             for (size_t i=0; i<p->ports.size(); ++i)
-               {
-                 auto& pp=p->ports[i];
-                 if (pp->wires.size()>0 && pp->getVariableValue().idx()>=0)
-                   p->connectVar(pp->getVariableValue(), i);
-               }
+             auto& pp=p->ports[i];
+             if (pp->wires.size()>0 && pp->getVariableValue().idx()>=0)
+               p->connectVar(pp->getVariableValue(), i);
            }
-         return false;
        });
+    // register icons needing updates during simulation
+    liveIcons.clear();
+    auto registerLive=[&](const shared_ptr<Item>& i)
+      {if (i->liveIcon()) liveIcons.push_back(i);};
+    model->forEachOfKind(&GroupItems::variables, registerLive);
+    model->forEachOfKind(&GroupItems::operations, registerLive);
+    model->forEachOfKind(&GroupItems::godleyIcons, registerLive);
+    model->forEachOfKind(&GroupItems::plots, registerLive);
+    model->forEachOfKind(&GroupItems::switches, registerLive);
 
     for (EvalOpVector::iterator e=equations.begin(); e!=equations.end(); ++e)
       (*e)->reset();
   }
 
+  namespace
+  {
+    /// replace the scope of group local \a valueId, which is derived
+    /// from the group's address, using \a scopes. @return false if
+    /// the scope is not in \a scopes
+    bool rescope(string& valueId, const map<string,string>& scopes)
+    {
+      auto colon=valueId.find(':');
+      if (colon==0 || colon==string::npos || valueId.compare(0,colon,"constant")==0)
+        return true;
+      auto i=scopes.find(valueId.substr(0,colon));
+      if (i==scopes.end()) return false;
+      valueId.replace(0,colon,i->second);
+      return true;
+    }
+
+    /// scope prefix of variables local to \a g
+    string scopeOf(const Group* g)
+    {
+      string id=VariableValue::valueId(size_t(g),"x");
+      return id.substr(0,id.find(':'));
+    }
+  }
+
+  shared_ptr<CompiledEquations> Minsky::compileEquations
+  (const map<const Item*,int>& ids) const
+  {
+    shared_ptr<CompiledEquations> r;
+    // equations must be current, ie constructed from the model as saved
+    if (!storeEquations || reset_flag()) return r;
+
+    auto id=[&](const Item* x) {
+      if (!x) return -1;
+      auto i=ids.find(x);
+      if (i==ids.end())
+        throw error("item not in saved model");
+      return i->second;
+    };
+
+    shared_ptr<CompiledEquations> c(new CompiledEquations);
+    try
+      {
+        for (auto& e: equations)
+          {
+            CompiledOp op;
+            op.type=e->type();
+            op.out=e->out; op.in1=e->in1; op.in2=e->in2;
+            op.flow1=e->flow1; op.flow2=e->flow2;
+            op.state=id(e->state.get());
+            if (auto ce=dynamic_cast<const ConstantEvalOp*>(e.get()))
+              op.value=ce->value;
+            c->equations.push_back(op);
+          }
+        for (auto& i: integrals)
+          {
+            CompiledIntegral ci;
+            ci.stock=i.stock;
+            ci.input=i.input;
+            ci.operation=id(i.operation);
+            c->integrals.push_back(ci);
+          }
+      }
+    catch (const std::exception&)
+      {
+        // equations refer to items that are not saved, so cannot be stored
+        return r;
+      }
+
+    // group local valueIds are stored relative to the group's schema id
+    map<string,string> scopes;
+    for (auto& i: ids)
+      if (auto g=dynamic_cast<const Group*>(i.first))
+        scopes[scopeOf(g)]="@"+to_string(i.second);
+    for (auto& v: variableValues)
+      {
+        c->variableValues.push_back(v);
+        if (!rescope(c->variableValues.back().first, scopes))
+          return r;
+      }
+    for (auto& i: ids)
+      for (unsigned p=0; p<i.first->ports.size(); ++p)
+        {
+          auto& port=i.first->ports[p];
+          if (port && !port->input() &&
+              port->getVariableValue().type()!=VariableType::undefined)
+            {
+              CompiledPortValue pv;
+              pv.item=i.second;
+              pv.port=p;
+              pv.value=port->getVariableValue();
+              c->portValues.push_back(pv);
+            }
+        }
+    c->stockVars=initialStockVars;
+    c->flowVars=initialFlowVars;
+    c->godley=evalGodley;
+    return c;
+  }
+
+  void Minsky::loadEquations(const string& filename, unsigned long long modelHash,
+                             map<int,ItemPtr>& items)
+  {
+    pendingEquations.reset();
+    pendingItems.clear();
+    shared_ptr<CompiledEquations> c(new CompiledEquations);
+    if (c->read(CompiledEquations::fileName(filename)) && c->modelHash==modelHash)
+      {
+        pendingEquations=c;
+        pendingItems.swap(items);
+      }
+  }
+
+  bool Minsky::restoreEquations()
+  {
+    if (!pendingEquations) return false;
+    shared_ptr<CompiledEquations> c;
+    c.swap(pendingEquations);
+    map<int,ItemPtr> items;
+    items.swap(pendingItems);
+
+    auto item=[&](int id)->ItemPtr {
+      if (id<0) return ItemPtr();
+      auto i=items.find(id);
+      if (i==items.end())
+        throw error("stored equations refer to a nonexistent item");
+      return i->second;
+    };
+
+    try
+      {
+        EvalOpVector newEquations;
+        for (auto& op: c->equations)
+          {
+            newEquations.push_back
+              (EvalOpPtr(OperationType::Type(op.type), op.out, op.in1, op.in2,
+                         op.flow1, op.flow2));
+            auto& e=*newEquations.back();
+            if (auto ce=dynamic_cast<ConstantEvalOp*>(&e))
+              ce->value=op.value;
+            if (op.state>=0)
+              {
+                auto state=dynamic_pointer_cast<OperationBase>(item(op.state));
+                if (!state)
+                  throw error("stored equation state is not an operation");
+                e.setState(state);
+              }
+          }
+        vector<Integral> newIntegrals;
+        for (auto& i: c->integrals)
+          {
+            newIntegrals.emplace_back(i.input);
+            newIntegrals.back().stock=i.stock;
+            if (i.operation>=0)
+              if (!(newIntegrals.back().operation=dynamic_cast<IntOp*>(item(i.operation).get())))
+                throw error("stored integral does not refer to an integral");
+          }
+        for (auto& p: c->portValues)
+          {
+            auto it=item(p.item);
+            if (p.port>=it->ports.size() || !it->ports[p.port])
+              throw error("stored port value does not refer to a port");
+          }
+
+        map<string,string> scopes;
+        for (auto& i: items)
+          if (auto g=dynamic_cast<const Group*>(i.second.get()))
+            scopes["@"+to_string(i.first)]=scopeOf(g);
+        VariableValues newValues;
+        for (auto& v: c->variableValues)
+          {
+            string valueId=v.first;
+            if (!rescope(valueId, scopes))
+              throw error("stored variable refers to a nonexistent group");
+            newValues[valueId]=v.second;
+          }
+        for (auto& i: items)
+          if (auto v=dynamic_cast<const VariableBase*>(i.second.get()))
+            if (!newValues.count(v->valueId()))
+              throw error("variable %s missing from stored equations",v->name().c_str());
+
+        // stored program fits the model, so install it
+        equations.swap(newEquations);
+        integrals.swap(newIntegrals);
+        variableValues.swap(newValues);
+        for (auto& p: c->portValues)
+          item(p.item)->ports[p.port]->setVariableValue(p.value);
+        stockVars=initialStockVars=c->stockVars;
+        flowVars=initialFlowVars=c->flowVars;
+        evalGodley=c->godley;
+      }
+    catch (const std::exception&)
+      {
+        return false;
+      }
+    attachEquations();
+    return true;
+  }
+
   std::set<string> Minsky::matchingTableColumns(GodleyTable& currTable, GodleyAssetClass::AssetClass ac)
   {
     std::set<string> r;
@@ -502,16 +865,14 @@ namespace minsky
     const string& colName=trimWS(srcTable.cell(0,srcCol));
     if (colName.empty()) return; //ignore blank columns
 
-    model->recursiveDo
-      (&Group::items,
-       [&](Items& m, Items::iterator i)
+    model->forEachOfKind
+      (&GroupItems::godleyIcons,
+       [&](const shared_ptr<GodleyIcon>& gi)
        {
-         if (auto gi=dynamic_cast<GodleyIcon*>(i->get()))
-           if (&gi->table!=&srcTable) // skip source table
-             for (size_t col=1; col<gi->table.cols(); col++)
-               if (trimWS(gi->table.cell(0,col))==colName) // we have a match
-                 balanceDuplicateColumns(*gi, col);
-         return false;
+         if (&gi->table!=&srcTable) // skip source table
+           for (size_t col=1; col<gi->table.cols(); col++)
+             if (trimWS(gi->table.cell(0,col))==colName) // we have a match
+               balanceDuplicateColumns(*gi, col);
        });
   }
 
@@ -627,9 +988,10 @@ namespace minsky
       GodleyIt(const Super& x): Super(x) {}
       GodleyIcon& operator*() {return *Super::operator*();}
       GodleyIcon* operator->() {return Super::operator*();}
-      const std::vector<std::vector<std::string> >& data() const {
-        return Super::operator*()->table.getData();
-      }
+      size_t rows() const {return Super::operator*()->table.rows();}
+      size_t cols() const {return Super::operator*()->table.cols();}
+      const FlowCoef& cell(size_t row, size_t col) const
+      {return Super::operator*()->table.parsedCell(row,col).flow;}
       const GodleyAssetClass::AssetClass assetClass(size_t col) const
       {return Super::operator*()->table._assetClass(col);}
       bool signConventionReversed(int col) const
@@ -647,38 +1009,59 @@ namespace minsky
 
   void Minsky::initGodleys()
   {
-    auto toGodleyIcon=[](const ItemPtr& i) {return dynamic_cast<GodleyIcon*>(i.get());};
-    auto godleyItems=model->findAll<GodleyIcon*>
-      (toGodleyIcon, &GroupItems::items, toGodleyIcon);
+    vector<GodleyIcon*> godleyItems;
+    model->forEachOfKind(&GroupItems::godleyIcons, [&](const shared_ptr<GodleyIcon>& g)
+                         {godleyItems.push_back(g.get());});
     evalGodley.initialiseGodleys(GodleyIt(godleyItems.begin()), 
                                  GodleyIt(godleyItems.end()), variableValues);
   }
 
   void Minsky::reset()
   {
+    if (solver)
+      {
+        // discard any states computed from the old model
+        solver->stop();
+        SolverThread::State s;
+        while (solver->pop(s));
+      }
+    simulationPaused=false;
+    checkpoints.clear();
+    // scenario results refer to the old model
+    scenarioPrefix.reset();
+    for (auto& s: scenarios)
+      s.second.results.reset();
     EvalOpBase::t=t=0;
-    constructEquations();
+    auto start=chrono::steady_clock::now();
+    // reuse the equations stored with the model, if it is unchanged
+    bool restored=restoreEquations();
+    if (!restored)
+      constructEquations();
+    equationBuildTime=chrono::duration<double>(chrono::steady_clock::now()-start).count();
     // if no stock variables in system, add a dummy stock variable to
     // make the simulation proceed
     if (stockVars.empty()) stockVars.resize(1,0);
 
-    initGodleys();
+    if (!restored)
+      initGodleys();
+    evalGodley.fuseIntegrals(stockVars.size(), integrals);
+    unwiredIntegral=-1;
+    for (size_t i=0; i<integrals.size(); ++i)
+      if (integrals[i].input.idx()<0)
+        {
+          unwiredIntegral=i;
+          break;
+        }
 
-    model->recursiveDo
-      (&Group::items,
-       [&](Items& m, Items::iterator i)
-       {
-         if (auto p=dynamic_cast<PlotWidget*>(i->get()))
-           p->clear();
-         return false;
-       });
+    model->forEachOfKind
+      (&GroupItems::plots, [](const shared_ptr<PlotWidget>& p) {p->clear();});
 
     if (stockVars.size()>0)
       {
         if (order==1 && !implicit)
           ode.reset(); // do explicit Euler
         else
-          ode.reset(new RKdata(this)); // set up GSL ODE routines
+          ode.reset(new RKdata(*this, stockVars.size())); // set up GSL ODE routines
       }
 
     flags &= ~reset_needed;
@@ -692,11 +1075,30 @@ namespace minsky
     if (reset_flag())
       reset();
 
+    integrate(t, stockVars);
+
+    // update flow variables
+    for (size_t i=0; i<equations.size(); ++i)
+      equations[i]->eval(&flowVars[0], &stockVars[0]);
+
+    logVariables();
+    updateLiveIcons();
+    checkpointIfDue(odeStepSize());
+  }
+
+  void Minsky::integrate(double& t, vector<double>& stock)
+  {
+    integrateWith(ode.get(), t, &stock[0], stock.size(), flowBase());
+  }
+
+  void Minsky::integrateWith(RKdata* ode, double& t, double stock[], size_t dimension,
+                             const vector<double>& flowBase) const
+  {
     if (ode)
       {
         gsl_odeiv2_driver_set_nmax(ode->driver, nSteps);
         int err=gsl_odeiv2_driver_apply(ode->driver, &t, numeric_limits<double>::max(), 
-                                        &stockVars[0]);
+                                        stock);
         switch (err)
           {
           case GSL_SUCCESS: case GSL_EMAXITER: break;
@@ -711,25 +1113,296 @@ namespace minsky
       }
     else // do explicit Euler method
       {
-        vector<double> d(stockVars.size());
+        vector<double> d(dimension);
         for (int i=0; i<nSteps; ++i, t+=stepMax)
           {
-            evalEquations(&d[0], t, &stockVars[0]);
+            evalDerivatives(&d[0], t, stock, flowBase);
             for (size_t j=0; j<d.size(); ++j)
-              stockVars[j]+=d[j];
+              stock[j]+=d[j];
           }
       }
+  }
 
-    // update flow variables
-    for (size_t i=0; i<equations.size(); ++i)
-      equations[i]->eval(&flowVars[0], &stockVars[0]);
+  double Minsky::odeStepSize() const
+  {
+    return ode? ode->driver->h: stepMax;
+  }
 
-    logVariables();
+  void Minsky::checkpointIfDue(double stepSize)
+  {
+    if (checkpointInterval>0 &&
+        (checkpoints.empty() || t>=checkpoints.back().t+checkpointInterval))
+      recordCheckpoint(stepSize);
+  }
 
-    model->recursiveDo
-      (&Group::items, 
-       [&](Items&, Items::iterator i) 
-       {(*i)->updateIcon(t); return false;});
+  void Minsky::recordCheckpoint(double stepSize)
+  {
+    Checkpoint c;
+    c.t=t;
+    c.stepSize=stepSize;
+    c.stock=stockVars;
+    c.flow=flowVars;
+    for (auto& i: liveIcons)
+      if (auto p=dynamic_pointer_cast<PlotWidget>(i.lock()))
+        c.plotCursors.push_back(p->historyCursor());
+    checkpoints.maxInMemory=maxCheckpoints;
+    checkpoints.spillDir=checkpointSpillDir;
+    checkpoints.push(move(c));
+  }
+
+  double Minsky::checkpointTime(size_t i) const
+  {
+    if (i>=checkpoints.size())
+      throw error("checkpoint %d does not exist",int(i));
+    return checkpoints[i].t;
+  }
+
+  void Minsky::restoreCheckpoint(size_t i)
+  {
+    // checkpoints refer to the equations in force when they were taken
+    if (reset_flag())
+      throw error("model has changed since checkpoint was taken");
+    Checkpoint c=checkpoints.restore(i);
+    if (c.stock.size()!=stockVars.size() || c.flow.size()!=flowVars.size())
+      throw error("checkpoint inconsistent with model");
+    EvalOpBase::t=t=c.t;
+    stockVars=c.stock;
+    flowVars=c.flow;
+    // step size is restored, but the stepper's internal state cannot
+    // be, so is restarted
+    if (ode && c.stepSize>0)
+      gsl_odeiv2_driver_reset_hstart(ode->driver, c.stepSize);
+    size_t plot=0;
+    for (auto& i: liveIcons)
+      if (auto p=dynamic_pointer_cast<PlotWidget>(i.lock()))
+        {
+          if (plot<c.plotCursors.size())
+            p->truncateHistory(c.plotCursors[plot++]);
+          p->redraw();
+        }
+  }
+
+  void Minsky::runScenarioPrefix(double tEnd)
+  {
+    if (reset_flag())
+      reset();
+    auto prefix=std::make_shared<Trajectory>(stockVars.size(), flowVars.size());
+    prefix->append(t, stockVars, flowVars);
+    while (t<tEnd)
+      {
+        step();
+        prefix->append(t, stockVars, flowVars);
+      }
+    scenarioPrefix=prefix;
+    for (auto& s: scenarios)
+      s.second.results.reset();
+  }
+
+  void Minsky::setScenarioParameter
+  (const string& name, const string& valueId, double value)
+  {
+    auto s=scenarios.find(name);
+    if (s==scenarios.end())
+      throw error("scenario %s not defined",name.c_str());
+    s->second.parameters[valueId]=value;
+  }
+
+  const ScenarioBranch& Minsky::scenario(const string& name) const
+  {
+    auto s=scenarios.find(name);
+    if (s==scenarios.end())
+      throw error("scenario %s not defined",name.c_str());
+    return s->second;
+  }
+
+  void Minsky::runScenarios(double tEnd)
+  {
+    if (reset_flag())
+      reset();
+    if (!scenarioPrefix || scenarioPrefix->size()==0)
+      {
+        auto prefix=std::make_shared<Trajectory>(stockVars.size(), flowVars.size());
+        prefix->append(t, stockVars, flowVars);
+        scenarioPrefix=prefix;
+      }
+
+    // set up each branch here, as the model's maps and GSL's error
+    // handler are not safe to use concurrently
+    struct Branch
+    {
+      ScenarioBranch* scenario;
+      double t;
+      vector<double> stock, flow;
+      unique_ptr<RKdata> ode;
+    };
+    vector<Branch> branches;
+    branches.reserve(scenarios.size()); // pointers into branches are retained
+    for (auto& s: scenarios)
+      {
+        branches.emplace_back();
+        auto& b=branches.back();
+        b.scenario=&s.second;
+        scenarioPrefix->state(scenarioPrefix->size()-1, b.t, b.stock, b.flow);
+        for (auto& p: s.second.parameters)
+          {
+            auto v=variableValues.find(p.first);
+            if (v==variableValues.end() || v->second.idx()<0)
+              throw error("scenario %s: variable %s not found",
+                          s.first.c_str(), p.first.c_str());
+            (v->second.isFlowVar()? b.flow: b.stock)[v->second.idx()]=p.second;
+          }
+        if (ode)
+          {
+            b.ode.reset(new RKdata(*this, b.stock.size()));
+            b.ode->flowBase=&b.flow;
+            b.ode->errorMsg=&s.second.error;
+          }
+        s.second.error.clear();
+        s.second.results=std::make_shared<Trajectory>
+          (stockVars.size(), flowVars.size(), scenarioPrefix);
+      }
+
+    // equations, Godley tables and integrals are shared read only
+    vector<thread> threads;
+    for (auto& b: branches)
+      threads.emplace_back([&b,tEnd,this]{
+          runScenario(*b.scenario, b.ode.get(), b.t, b.stock, b.flow, tEnd);});
+    for (auto& th: threads)
+      th.join();
+  }
+
+  void Minsky::runScenario(ScenarioBranch& s, RKdata* ode, double t,
+                           vector<double>& stock, vector<double>& flow,
+                           double tEnd) const
+  {
+    try
+      {
+        while (t<tEnd)
+          {
+            integrateWith(ode, t, &stock[0], stock.size(), flow);
+            EvalOpBase::t=t;
+            for (auto& e: equations)
+              e->eval(&flow[0], &stock[0]);
+            s.results->append(t, stock, flow);
+          }
+      }
+    catch (const std::exception& e)
+      {
+        s.error+=e.what();
+      }
+  }
+
+  vector<double> Minsky::scenarioTimes(const string& name) const
+  {
+    vector<double> r;
+    if (auto& results=scenario(name).results)
+      for (size_t i=0; i<results->size(); ++i)
+        r.push_back(results->time(i));
+    return r;
+  }
+
+  vector<double> Minsky::scenarioValues
+  (const string& name, const string& valueId) const
+  {
+    auto v=variableValues.find(valueId);
+    if (v==variableValues.end() || v->second.idx()<0)
+      throw error("variable %s not found",valueId.c_str());
+    vector<double> r;
+    if (auto& results=scenario(name).results)
+      for (size_t i=0; i<results->size(); ++i)
+        r.push_back(results->value(i, v->second.isFlowVar(), v->second.idx()));
+    return r;
+  }
+
+  void Minsky::startSimulation()
+  {
+    if (reset_flag())
+      reset();
+    // check for unwired integrals here, as the error can only be
+    // indicated on the canvas from this thread
+    for (auto& i: integrals)
+      if (i.input.idx()<0)
+        {
+          if (i.operation)
+            displayErrorItem(*i.operation);
+          throw error("integral not wired");
+        }
+    if (!solver)
+      solver.reset(new SolverThread(*this, simulationQueueSize));
+    simulationPaused=false;
+    solver->start();
+  }
+
+  void Minsky::stopSimulation()
+  {
+    simulationPaused=false;
+    if (solver)
+      {
+        solver->stop();
+        applySolverStates();
+      }
+  }
+
+  void Minsky::pauseSimulation()
+  {
+    if (solver && solver->running())
+      {
+        solver->stop();
+        applySolverStates();
+        simulationPaused=true;
+      }
+  }
+
+  size_t Minsky::syncSimulation()
+  {
+    if (!solver) return 0;
+    size_t n=applySolverStates();
+    if (auto errorItem=solver->takeErrorItem())
+      displayErrorItem(*errorItem);
+    string err=solver->takeError();
+    if (!err.empty())
+      {
+        stopSimulation();
+        throw error("%s",err.c_str());
+      }
+    if (simulationPaused)
+      startSimulation();
+    return n;
+  }
+
+  size_t Minsky::applySolverStates()
+  {
+    size_t n=0;
+    while (solver->pop(solverState))
+      {
+        t=solverState.t;
+        // swap rather than copy - the old storage goes back to the
+        // solver on the next pop
+        if (solverState.stock.size()==stockVars.size())
+          stockVars.swap(solverState.stock);
+        if (solverState.flow.size()==flowVars.size())
+          flowVars.swap(solverState.flow);
+        logVariables();
+        updateLiveIcons();
+        checkpointIfDue(solverState.stepSize);
+        ++n;
+      }
+    return n;
+  }
+
+  void Minsky::flushPlotFrames()
+  {
+    vector<PlotWidget*> plots;
+    model->forEachOfKind
+      (&GroupItems::plots,
+       [&](const shared_ptr<PlotWidget>& p)
+       {
+         p->requestFrame();
+         plots.push_back(p.get());
+       });
+    plotRenderer().waitIdle();
+    for (auto p: plots)
+      p->pollFrame();
   }
 
   string Minsky::diagnoseNonFinite() const
@@ -748,56 +1421,58 @@ namespace minsky
   }
 
   void Minsky::evalEquations(double result[], double t, const double vars[])
+  {
+    evalDerivatives(result, t, vars, flowBase());
+  }
+
+  void Minsky::evalDerivatives(double result[], double t, const double vars[],
+                               const vector<double>& flowBase) const
   {
     EvalOpBase::t=t;
     // firstly evaluate the flow variables. Initialise to flowVars so
     // that no input vars are correctly initialised
-    vector<double> flow(flowVars);
+    vector<double> flow(flowBase);
     for (size_t i=0; i<equations.size(); ++i)
       equations[i]->eval(&flow[0], vars);
 
-    // then create the result using the Godley table
-    for (size_t i=0; i<stockVars.size(); ++i) result[i]=0;
-    evalGodley.eval(result, &flow[0]);
-    // integrations are kind of a copy
-    for (vector<Integral>::iterator i=integrals.begin(); i<integrals.end(); ++i)
+    if (unwiredIntegral>=0 && size_t(unwiredIntegral)<integrals.size())
       {
-        if (i->input.idx()<0)
-          {
-            if (i->operation)
-              displayErrorItem(*i->operation);
-            throw error("integral not wired");
-          }
-        result[i->stock.idx()] = i->input.isFlowVar()? flow[i->input.idx()]: vars[i->input.idx()];
+        if (auto op=integrals[unwiredIntegral].operation)
+          displayErrorItem(*op);
+        throw error("integral not wired");
       }
+    // then create the result using the Godley table and integrals
+    evalGodley.evalDerivatives(result, vars, &flow[0]);
   }
 
   void Minsky::jacobian(Matrix& jac, double t, const double sv[])
+  {
+    evalJacobian(jac, t, sv, flowBase());
+  }
+
+  void Minsky::evalJacobian(Matrix& jac, double t, const double sv[],
+                            const vector<double>& flowBase) const
   {
     EvalOpBase::t=t;
     // firstly evaluate the flow variables. Initialise to flowVars so
     // that no input vars are correctly initialised
-    vector<double> flow=flowVars;
+    vector<double> flow=flowBase;
     for (size_t i=0; i<equations.size(); ++i)
       equations[i]->eval(&flow[0], sv);
 
-    // then determine the derivatives with respect to variable j
-    for (size_t j=0; j<stockVars.size(); ++j)
+    // then determine the derivatives with respect to variable j. The
+    // dimensions are those of the arguments, as this may be called
+    // from the solver thread
+    size_t n=jac.size();
+    for (size_t j=0; j<n; ++j)
       {
-        vector<double> ds(stockVars.size()), df(flowVars.size());
+        vector<double> ds(n), df(flowBase.size());
         ds[j]=1;
         for (size_t i=0; i<equations.size(); ++i)
           equations[i]->deriv(&df[0], &ds[0], sv, &flow[0]);
-        vector<double> d(stockVars.size());
-        evalGodley.eval(&d[0], &df[0]);
-        for (vector<Integral>::iterator i=integrals.begin(); 
-             i!=integrals.end(); ++i)
-          {
-            assert(i->stock.idx()>=0 && i->input.idx()>=0);
-            d[i->stock.idx()] = 
-              i->input.isFlowVar()? df[i->input.idx()]: ds[i->input.idx()];
-          }
-        for (size_t i=0; i<stockVars.size(); i++)
+        vector<double> d(n);
+        evalGodley.evalDerivatives(&d[0], &ds[0], &df[0]);
+        for (size_t i=0; i<n; i++)
           jac(i,j)=d[i];
       }
   
@@ -805,84 +1480,80 @@ namespace minsky
 
   void Minsky::save(const std::string& filename)
   {
-    ofstream of(filename);
-    xml_pack_t saveFile(of, schemaURL);
-    saveFile.prettyPrint=true;
-    schema1::Minsky m(*this);
-    m.relocateCanvas();
-    xml_pack(saveFile, "Minsky", m);
-    if (!of)
-      throw runtime_error("cannot save to "+filename);
+    map<const Item*,int> ids;
+    schema1::Minsky m(*this, &ids);
+    writeModel(filename, m, compileEquations(ids));
+    flags &= ~is_edited;
+  }
+
+  void Minsky::saveInBackground(const std::string& filename)
+  {
+    // only the snapshot is taken here, serialisation happens on the
+    // saver's thread
+    map<const Item*,int> ids;
+    shared_ptr<schema1::Minsky> m(new schema1::Minsky(*this, &ids));
+    auto equations=compileEquations(ids);
+    if (!saver) saver.reset(new BackgroundSaver);
+    saver->submit(filename, [m,equations](const string& f)
+                  {writeModel(f, *m, equations);});
     flags &= ~is_edited;
   }
 
+  string Minsky::takeSaveError()
+  {
+    string r;
+    BackgroundSaver::Result result;
+    while (saver && saver->takeResult(result))
+      if (!result.error.empty())
+        {
+          // the model is no longer saved
+          flags |= is_edited;
+          if (!r.empty()) r+="\n";
+          r+=result.error;
+        }
+    return r;
+  }
+
+  void Minsky::convertModelFile(const string& from, const string& to) const
+  {
+    schema1::Minsky m;
+    readSchema(from, m);
+    writeSchema(to, m);
+  }
+
 
   void Minsky::load(const std::string& filename) 
   {
-  
+    typedef chrono::steady_clock Clock;
+    auto start=Clock::now();
     clearAllMaps();
 
     // current schema
     schema1::Minsky currentSchema;
-    ifstream inf(filename);
-    if (!inf)
-      throw runtime_error("failed to open "+filename);
-    xml_unpack_t saveFile(inf);
-    xml_unpack(saveFile, "Minsky", currentSchema);
+    readSchema(filename, currentSchema);
     // fix corruption caused by ticket #329
     currentSchema.removeIntVarOrphans();
+    auto parsed=Clock::now();
+    loadParseTime=chrono::duration<double>(parsed-start).count();
 
     if (currentSchema.version == currentSchema.schemaVersion)
-      *this = currentSchema;
+      {
+        Minsky m;
+        map<int,ItemPtr> items;
+        currentSchema.populateMinsky(m, &loadLayoutTime, &items);
+        *this=m;
+        loadEquations(filename, currentSchema.model.structuralHash(), items);
+      }
     else
       {
         throw error("Schema 0 not yet supported");
       }
-//      { // fall back to the ill-defined schema '0'
-//        schema0::Minsky m;
-//        m.load(filename.c_str());
-//        *this=m;
-//      }
-//
-//    variables.makeConsistent();
-
-    
+    loadBuildTime=chrono::duration<double>(Clock::now()-parsed).count()-loadLayoutTime;
 
-//    for (GodleyItems::iterator g=godleyItems.begin(); g!=godleyItems.end(); ++g)
-//      g->update();
-//
-//    for (GroupIcons::iterator g=groupItems.begin(); g!=groupItems.end(); ++g)
-//      {
-//        // ensure group attributes correctly set
-//        const vector<int>& vars= g->variables();
-//        for (vector<int>::const_iterator i=vars.begin(); i!=vars.end(); ++i)
-//          {
-//            const VariablePtr& v=variables[*i];
-//            v->group=g->id();
-//            v->visible=g->displayContents();
-//          }
-//        const vector<int>& ops= g->operations();
-//        for (vector<int>::const_iterator i=ops.begin(); i!=ops.end(); ++i)
-//          {
-//            OperationPtr& o=operations[*i];
-//            o->group=g->id();
-//            o->visible=g->displayContents();
-//          }
-//        const vector<int>& gwires= g->wires();
-//        for (vector<int>::const_iterator i=gwires.begin(); i!=gwires.end(); ++i)
-//          {
-//            Wire& w=wires[*i];
-//            w.group=g->id();
-//            w.visible=g->displayContents();
-//          }
-//      }
-//
-//    removeDuplicateWires();
-//
-    // try resetting the system, but ignore any errors
-    try {reset();}
-    catch (...) {}
+    // equations are constructed on the first simulation request
+    equationBuildTime=0;
     flags=reset_needed;
+    equationViewStale=true;
   }
 
   void Minsky::exportSchema(const char* filename, int schemaLevel)
@@ -947,14 +1618,27 @@ namespace minsky
     
   bool Minsky::cycleCheck() const
   {
-    // construct the network schematic
+    // a wiring order implies there are no cycles
+    if (wiringOrder.valid() || wiringOrder.rebuild(*model)) return false;
+
+    // otherwise, locate the cycle by walking the network schematic
     Network net;
     for (auto& w: model->findWires([](WirePtr){return true;}))
       net.emplace(w->from().get(), w->to().get());
-    for (auto& i: model->findItems([](ItemPtr){return true;}))
-      if (!dynamic_cast<IntOp*>(i.get()) && !dynamic_cast<GodleyIcon*>(i.get()))
-        for (unsigned j=1; j<i->ports.size(); ++j)
-          net.emplace(i->ports[j].get(), i->ports[0].get());
+    // outputs depend on inputs for all but integrals (and Godley
+    // tables); plots have no outputs
+    auto passThrough=[&](const Item& i) {
+      for (unsigned j=1; j<i.ports.size(); ++j)
+        net.emplace(i.ports[j].get(), i.ports[0].get());
+    };
+    model->forEachOfKind(&GroupItems::variables,
+                         [&](const shared_ptr<VariableBase>& v) {passThrough(*v);});
+    model->forEachOfKind(&GroupItems::operations,
+                         [&](const shared_ptr<OperationBase>& o) {
+                           if (!dynamic_cast<IntOp*>(o.get())) passThrough(*o);
+                         });
+    model->forEachOfKind(&GroupItems::switches,
+                         [&](const shared_ptr<SwitchIcon>& s) {passThrough(*s);});
     
     for (auto& i: net)
       if (!i.first->input() && !net.portsVisited.count(i.first))
@@ -1019,14 +1703,36 @@ namespace minsky
 
   void Minsky::displayErrorItem(const Item& op) const
   {
+    // item positions, and the canvas, may only be accessed from the
+    // GUI thread
+    if (this_thread::get_id()!=mainThread) return;
+    float x, y;
     if (op.visible())
-      displayErrorItem(op.x(),op.y());
+      {
+        x=op.x(); y=op.y();
+      }
     else if (auto g=op.group.lock())
       {
         while (g && !g->visible()) g=g->group.lock();
         if (g && g->visible())
-          displayErrorItem(g->x(), g->y());
+          {
+            x=g->x(); y=g->y();
+          }
+        else
+          return;
       }
+    else
+      return;
+    displayErrorItem(x,y);
+  }
+
+  void Minsky::displayErrorItem(const std::shared_ptr<Item>& op) const
+  {
+    if (!op) return;
+    if (solver && solver->onSolverThread())
+      solver->setErrorItem(op);
+    else
+      displayErrorItem(*op);
   }
   
   bool Minsky::pushHistoryIfDifferent()
@@ -1036,27 +1742,20 @@ namespace minsky
     schema1::Minsky m(*this);
     pack_t buf;
     buf<<m;
-    if (history.empty() || memcmp(buf.data(), history.back().data(), buf.size())!=0)
-      {
-        // This bit of code outputs an XML representation that can be
-        //        used for debugging issues related to unnecessary
-        //        history pushes.
-        // xml_pack_t tb(cout);
-        // xml_pack(tb,"Minsky",m); 
-        // cout<<"------"<<endl;
-        history.resize(history.size()+1);
-        buf.swap(history.back());
-        return true;
-      }
-    return false;
+    // This bit of code outputs an XML representation that can be
+    //        used for debugging issues related to unnecessary
+    //        history pushes.
+    // xml_pack_t tb(cout);
+    // xml_pack(tb,"Minsky",m); 
+    // cout<<"------"<<endl;
+    return history.push(buf.data(), buf.size());
   }
 
   void Minsky::pushHistory()
   {
-    history.resize(historyPtr);
+    history.truncate(historyPtr);
     pushHistoryIfDifferent();
-    while (history.size()>maxHistory)
-      history.pop_front();
+    history.trim(maxHistory, maxHistoryBytes);
     historyPtr=history.size();
   }
   
@@ -1068,8 +1767,12 @@ namespace minsky
     historyPtr-=changes;
     if (historyPtr > 0 && historyPtr <= history.size())
       {
+        UndoHistory::Buffer state;
+        history.get(historyPtr-1, state);
+        pack_t buf;
+        buf.packraw(state.data(), state.size());
         schema1::Minsky m;
-        history[historyPtr-1].reseto()>>m;
+        buf>>m;
         clearAllMaps();
         *this=m;
       }
@@ -1110,17 +1813,25 @@ namespace minsky
       default: break;
       }
 
-    // convert all references
+    // convert all references. Converted variables are new objects,
+    // so are swapped into their groups through removeItem/addItem,
+    // which keep the per-kind and spatial indexes consistent
+    vector<ItemPtr> refs;
     model->recursiveDo(&Group::items,
                        [&](Items&, Items::iterator i) {
-                         if (auto v=VariablePtr(*i))
+                         if (auto v=dynamic_cast<VariableBase*>(i->get()))
                            if (v->valueId()==name)
-                             {
-                               v.retype(type);
-                               *i=v;
-                             }
+                             refs.push_back(*i);
                          return false;
                        });
+    for (auto& r: refs)
+      if (auto g=r->group.lock())
+        {
+          VariablePtr v(r);
+          v.retype(type);
+          g->removeItem(*r);
+          g->addItem(v);
+        }
     i->second=VariableValue(type,i->second.name,i->second.init);
   }
 
@@ -1141,6 +1852,43 @@ namespace minsky
     return r;
   }
 
+  namespace
+  {
+    void drawItem(cairo_t* cairo, const Item& it)
+    {
+      cairo_save(cairo);
+      cairo_translate(cairo,it.x(), it.y());
+      it.drawCached(cairo);
+      cairo_restore(cairo);
+    }
+
+    void drawWire(cairo_t* cairo, const Wire& wire)
+    {
+      auto& points=wire.geometry().curve;
+      size_t n=points.size();
+      if (n<4) return;
+
+      cairo_move_to(cairo, points[0], points[1]);
+      for (size_t i=2; i<n; i+=2)
+        cairo_line_to(cairo, points[i], points[i+1]);
+      cairo_stroke(cairo);
+      double angle=atan2(points[n-1]-points[n-3], points[n-2]-points[n-4]);
+      double lastx=points[n-2], lasty=points[n-1];
+
+      // draw arrow
+      cairo_save(cairo);
+      cairo_translate(cairo, lastx, lasty);
+      cairo_rotate(cairo,angle);
+      cairo_move_to(cairo,0,0);
+      cairo_line_to(cairo,-5,-3); 
+      cairo_line_to(cairo,-3,0); 
+      cairo_line_to(cairo,-5,3);
+      cairo_close_path(cairo);
+      cairo_fill(cairo);
+      cairo_restore(cairo);
+    }
+  }
+
   void Minsky::renderCanvas(cairo_t* cairo) const
   {
     cairo_set_line_width(cairo, 1);
@@ -1153,8 +1901,7 @@ namespace minsky
            {
              cairo_save(cairo);
              cairo_identity_matrix(cairo);
-             cairo_translate(cairo,it.x(), it.y());
-             it.draw(cairo);
+             drawItem(cairo, it);
              cairo_restore(cairo);
            }
          return false;
@@ -1169,8 +1916,7 @@ namespace minsky
            {
              cairo_save(cairo);
              cairo_identity_matrix(cairo);
-             cairo_translate(cairo,it.x(), it.y());
-             it.draw(cairo);
+             drawItem(cairo, it);
              cairo_restore(cairo);
            }
          return false;
@@ -1181,88 +1927,211 @@ namespace minsky
     model->recursiveDo
       (&GroupItems::wires, [&](const Wires&, Wires::const_iterator i)
        {
+         if ((*i)->visible())
+           drawWire(cairo, **i);
+         return false;
+       });
+  }
 
-         auto coords=(*i)->coords();
-         if (coords.size()<4 || !(*i)->visible()) return false;
+  namespace
+  {
+    /// apply \a f to \a g, and to each group nested within it whose
+    /// contents are displayed
+    template <class F> void forEachDisplayedGroup(const Group& g, F f)
+    {
+      f(g);
+      for (auto& i: g.groups)
+        if (i->displayContents())
+          forEachDisplayedGroup(*i, f);
+    }
+  }
 
-         double angle, lastx, lasty;
-         if (coords.size()==4)
-           {
-             cairo_move_to(cairo,coords[0],coords[1]);
-             cairo_line_to(cairo, coords[2], coords[3]);
-             angle=atan2(coords[3]-coords[1], coords[2]-coords[0]);
-             lastx=coords[2]; lasty=coords[3];
-           }
-         else
-           {
-             // need to convert to double precision for Tk
-             vector<double> dcoords(coords.begin(), coords.end());
-             // Use Tk's smoothing algorithm for computing curves
-             const int numSteps=100;
-             // Tk's documentation doesn't say how big this buffer should
-             // be, hopefully this is ample.
-             vector<double> points(2*numSteps*(dcoords.size()+1));
-             int numPoints=
-               TkMakeBezierCurve(0,dcoords.data(),dcoords.size()/2,numSteps,
-                                 nullptr,points.data());
-             
-             cairo_move_to(cairo, points[0], points[1]);
-             for (int i=2; i<2*numPoints; i+=2)
-               cairo_line_to(cairo, points[i], points[i+1]);
-             cairo_stroke(cairo);
-             angle=atan2(points[2*numPoints-1]-points[2*numPoints-3], 
-                         points[2*numPoints-2]-points[2*numPoints-4]);
-             lastx=points[2*numPoints-2]; lasty=points[2*numPoints-1];
-           }
-         cairo_stroke(cairo);
-
-         // draw arrow
-         cairo_save(cairo);
-         cairo_translate(cairo, lastx, lasty);
-         cairo_rotate(cairo,angle);
-         cairo_move_to(cairo,0,0);
-         cairo_line_to(cairo,-5,-3); 
-         cairo_line_to(cairo,-3,0); 
-         cairo_line_to(cairo,-5,3);
-         cairo_close_path(cairo);
-         cairo_fill(cairo);
-         cairo_restore(cairo);
-         
+  void Minsky::renderRegion(cairo_t* cairo, const BoundingBox& region) const
+  {
+    cairo_set_line_width(cairo, 1);
+    // as for renderCanvas, items are drawn first, then groups, then
+    // wires, restricted to those the spatial index places near region
+    vector<ItemPtr> items, groups;
+    forEachDisplayedGroup(*model, [&](const Group& g) {
+        for (auto& i: g.itemsIntersecting(region))
+          if (i->visible())
+            (dynamic_cast<Group*>(i.get())? groups: items).push_back(i);
+      });
+    for (auto& i: items)
+      drawItem(cairo, *i);
+    for (auto& i: groups)
+      drawItem(cairo, *i);
+
+    // wires are few compared with items, so are culled directly
+    forEachDisplayedGroup(*model, [&](const Group& g) {
+        for (auto& w: g.wires)
+          if (w->visible() && wireBounds(*w).intersects(region))
+            drawWire(cairo, *w);
+      });
+  }
+
+  void Minsky::fontsChanged()
+  {
+    clearLabelExtents();
+    iconCache().clear();
+    equationView.clear();
+    equationViewStale=true;
+    // icon sizes depend on their labels
+    model->invalidateSpatialIndex();
+    model->recursiveDo
+      (&GroupItems::groups, [](const Groups&, Groups::const_iterator i)
+       {
+         (*i)->invalidateSpatialIndex();
          return false;
        });
   }
 
+  namespace
+  {
+    // storage for the family name ecolab::Pango refers to
+    string labelFont;
+  }
+
+  string Minsky::defaultFont() const
+  {return labelFont;}
+
+  string Minsky::defaultFont(const string& family)
+  {
+    if (family==labelFont) return labelFont;
+    labelFont=family;
+    ecolab::Pango::defaultFamily=labelFont.empty()? nullptr: labelFont.c_str();
+    fontsChanged();
+    return labelFont;
+  }
+
+  BoundingBox Minsky::canvasBounds() const
+  {
+    const float big=numeric_limits<float>::max();
+    const BoundingBox everything(-big,-big,big,big);
+    BoundingBox r;
+    bool empty=true;
+    auto add=[&](const BoundingBox& b) {
+      if (empty) r=b; else r|=b;
+      empty=false;
+    };
+    forEachDisplayedGroup(*model, [&](const Group& g) {
+        float x=g.x(), y=g.y();
+        BoundingBox b;
+        for (auto& i: g.itemsIntersecting(everything))
+          if (i->visible() && g.spatialIndex.find(*i,b))
+            add(BoundingBox(b.x0+x, b.y0+y, b.x1+x, b.y1+y));
+        for (auto& w: g.wires)
+          if (w->visible())
+            add(wireBounds(*w));
+      });
+    return r;
+  }
+
+  namespace
+  {
+    /// margin around exported canvases
+    const float exportMargin=10;
+  }
+
+  // vector surfaces write their output as it is drawn, so the canvas
+  // is sized from the spatial indexes rather than by drawing it twice
   void Minsky::renderCanvasToPS(const char* filename) const 
   {
-    cairo::Surface rs(cairo_recording_surface_create
-                      (CAIRO_CONTENT_COLOR_ALPHA,nullptr));
-    renderCanvas(rs.cairo());
-    cairo::Surface s(cairo_ps_surface_create(filename, rs.width()-rs.left()+20, rs.height()-rs.top()+20));
+    auto b=canvasBounds();
+    cairo::Surface s(cairo_ps_surface_create(filename, b.x1-b.x0+2*exportMargin, b.y1-b.y0+2*exportMargin));
     cairo_ps_surface_set_eps(s.surface(),true);
-    cairo_surface_set_device_offset(s.surface(), -rs.left(), -rs.top());
+    cairo_surface_set_device_offset(s.surface(), exportMargin-b.x0, exportMargin-b.y0);
     renderCanvas(s.cairo());
   }
 
   void Minsky::renderCanvasToPDF(const char* filename) const 
   {
-    cairo::Surface rs(cairo_recording_surface_create
-                      (CAIRO_CONTENT_COLOR_ALPHA,nullptr));
-    renderCanvas(rs.cairo());
-    cairo::Surface s(cairo_pdf_surface_create(filename, rs.width()-rs.left()+20, rs.height()-rs.top()+20));
-    cairo_surface_set_device_offset(s.surface(), -rs.left(), -rs.top());
+    auto b=canvasBounds();
+    cairo::Surface s(cairo_pdf_surface_create(filename, b.x1-b.x0+2*exportMargin, b.y1-b.y0+2*exportMargin));
+    cairo_surface_set_device_offset(s.surface(), exportMargin-b.x0, exportMargin-b.y0);
     renderCanvas(s.cairo());
   }
 
   void Minsky::renderCanvasToSVG(const char* filename) const 
   {
-    cairo::Surface rs(cairo_recording_surface_create
-                      (CAIRO_CONTENT_COLOR_ALPHA,nullptr));
-    renderCanvas(rs.cairo());
-    // extra space required on right hand edge for some reason
-    cairo::Surface s(cairo_svg_surface_create(filename, rs.width()-rs.left()+20, rs.height()-rs.top()+20));
-    cairo_surface_set_device_offset(s.surface(), -rs.left(), -rs.top());
+    auto b=canvasBounds();
+    cairo::Surface s(cairo_svg_surface_create(filename, b.x1-b.x0+2*exportMargin, b.y1-b.y0+2*exportMargin));
+    cairo_surface_set_device_offset(s.surface(), exportMargin-b.x0, exportMargin-b.y0);
     renderCanvas(s.cairo());
   }
 
+  void Minsky::renderCanvasToPNG(const char* filename, double scale) const
+  {
+    if (!(scale>0))
+      throw error("invalid export scale %g",scale);
+    auto b=canvasBounds();
+    double x0=b.x0-exportMargin, y0=b.y0-exportMargin;
+    unsigned width=ceil(scale*(b.x1-b.x0+2*exportMargin));
+    unsigned height=ceil(scale*(b.y1-b.y0+2*exportMargin));
+    PNGStream png(filename, width, height);
+
+    // the image is produced in bands of rows, limiting the memory
+    // used by bands in flight. Each band is recorded on this thread,
+    // as drawing updates the model's caches, then rasterised on a
+    // worker thread while later bands are recorded. Cairo image
+    // surfaces are at most 32767 pixels wide, so a band is rasterised
+    // as columns of tiles sharing the band's pixel buffer.
+    const size_t bandBytes=16<<20;
+    const unsigned maxTileWidth=32767;
+    unsigned bandHeight=max<size_t>(1, min<size_t>(256, bandBytes/(4*size_t(width)+1)));
+    unsigned workers=max(1u, thread::hardware_concurrency());
+    typedef shared_ptr<cairo_surface_t> SurfacePtr;
+    typedef shared_ptr<vector<uint32_t>> Band;
+    deque<future<Band>> bands;
+    auto writeBand=[&]() {
+      auto band=bands.front().get();
+      bands.pop_front();
+      png.write(reinterpret_cast<const unsigned char*>(band->data()),
+                4*width, band->size()/width);
+    };
+
+    for (unsigned top=0; top<height; top+=bandHeight)
+      {
+        unsigned rows=min(bandHeight, height-top);
+        BoundingBox region(x0, y0+top/scale, x0+width/scale, y0+(top+rows)/scale);
+        SurfacePtr recording(cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,nullptr),
+                             cairo_surface_destroy);
+        if (cairo_surface_status(recording.get())!=CAIRO_STATUS_SUCCESS)
+          throw error("cannot record export band: %s",
+                      cairo_status_to_string(cairo_surface_status(recording.get())));
+        cairo_t* cairo=cairo_create(recording.get());
+        renderRegion(cairo, region);
+        cairo_destroy(cairo);
+
+        bands.push_back(async(launch::async, [=]() {
+              Band band(new vector<uint32_t>(size_t(width)*rows));
+              for (unsigned left=0; left<width; left+=maxTileWidth)
+                {
+                  SurfacePtr tile
+                    (cairo_image_surface_create_for_data
+                     (reinterpret_cast<unsigned char*>(band->data()+left),
+                      CAIRO_FORMAT_ARGB32, min(maxTileWidth, width-left), rows, 4*width),
+                     cairo_surface_destroy);
+                  if (cairo_surface_status(tile.get())!=CAIRO_STATUS_SUCCESS)
+                    throw error("cannot rasterise export band: %s",
+                                cairo_status_to_string(cairo_surface_status(tile.get())));
+                  cairo_t* cairo=cairo_create(tile.get());
+                  cairo_translate(cairo, -double(left), 0);
+                  cairo_scale(cairo, scale, scale);
+                  cairo_set_source_surface(cairo, recording.get(), -region.x0, -region.y0);
+                  cairo_paint(cairo);
+                  cairo_destroy(cairo);
+                  cairo_surface_flush(tile.get());
+                }
+              return band;
+            }));
+        if (bands.size()>=workers)
+          writeBand();
+      }
+    while (!bands.empty())
+      writeBand();
+    png.close();
+  }
+
 }
 
@@ -34,8 +34,19 @@
 #include "latexMarkup.h"
 #include "integral.h"
 #include "variableValue.h"
+#include "logWriter.h"
+#include "solverThread.h"
+#include "checkpoint.h"
+#include "scenario.h"
+#include "undoHistory.h"
+#include "compiledEquations.h"
+#include "backgroundSaver.h"
+#include "wiringOrder.h"
+#include "iconCache.h"
+#include "equationView.h"
 
 #include <vector>
+#include <algorithm>
 #include <string>
 #include <set>
 #include <deque>
@@ -60,8 +71,57 @@ namespace minsky
   {
     EvalOpVector equations;
     vector<Integral> integrals;
+    /// index of the first integral without an input (-1 if none),
+    /// reported when the system is evaluated. Set by reset
+    int unwiredIntegral=-1;
     shared_ptr<RKdata> ode;
-    shared_ptr<ofstream> outputDataFile;
+    shared_ptr<LogWriter> outputDataFile;
+    /// recycled storage for the record passed to outputDataFile
+    std::vector<double> logRecord;
+    /// background integrator, if simulation is run threaded
+    shared_ptr<SolverThread> solver;
+    /// recycled storage for states received from solver
+    SolverThread::State solverState;
+    /// flow variable initialisers to use in place of flowVars while
+    /// the solver thread is running
+    const std::vector<double>* flowInit=nullptr;
+    /// true if solver thread has been stopped to allow an edit
+    bool simulationPaused=false;
+    /// items that display simulation values, updated after each
+    /// step. Held weakly, so deleting an item releases it
+    std::vector<std::weak_ptr<Item>> liveIcons;
+    Checkpoints checkpoints;
+    /// common starting trajectory of scenario branches
+    std::shared_ptr<const Trajectory> scenarioPrefix;
+    std::map<std::string, ScenarioBranch> scenarios;
+    /// binary snapshot of items copied to the clipboard. If null, the
+    /// clipboard refers to the current selection
+    shared_ptr<classdesc::pack_t> clipboard;
+    /// true if the system clipboard holds this process's data
+    bool clipboardOwned=false;
+    /// true if the system clipboard is supplied on demand (see
+    /// claimClipboard()). Otherwise it holds a copy of clipboardXML,
+    /// and the internal clipboard is used while the two match
+    bool clipboardOnDemand=false;
+    /// XML rendering of the clipboard, produced on request
+    mutable std::string clipboardXML;
+    /// thread the model was created on, which owns the GUI
+    std::thread::id mainThread=std::this_thread::get_id();
+    /// equation program read with the model, used by the next reset
+    /// unless the model is edited in the meantime
+    shared_ptr<CompiledEquations> pendingEquations;
+    /// items of the loaded model by schema id, to resolve pendingEquations
+    std::map<int,ItemPtr> pendingItems;
+    /// variable vectors as initialised by the last equation construction
+    std::vector<double> initialStockVars, initialFlowVars;
+    /// writes files for saveInBackground, created on first use
+    shared_ptr<BackgroundSaver> saver;
+    /// topological order of the wiring, maintained as wires are added
+    mutable WiringOrder wiringOrder;
+    /// rendered rows of the equations pane, brought up to date by
+    /// updateEquationView() when equationViewStale
+    mutable EquationView equationView;
+    mutable bool equationViewStale=true;
 
     enum StateFlags {is_edited=1, reset_needed=2};
     int flags=reset_needed;
@@ -72,15 +132,15 @@ namespace minsky
     // doesn't need to change this
     MinskyExclude(): historyPtr(0) {}
     MinskyExclude(const MinskyExclude&): historyPtr(0) {}
-    MinskyExclude& operator=(const MinskyExclude&) {return *this;}
+    MinskyExclude& operator=(const MinskyExclude&) {
+      // the model has been replaced
+      wiringOrder.invalidate();
+      equationViewStale=true;
+      return *this;
+    }
   protected:
     /// save history of model for undo
-    /* 
-       TODO: it should be sufficient to add move semantics to pack_t,
-       but for some reason copy semantics are required, requiring the
-       use of shared_ptr
-     */
-    std::deque<classdesc::pack_t> history;
+    UndoHistory history;
     size_t historyPtr;
   };
 
@@ -92,6 +152,7 @@ namespace minsky
     CLASSDESC_ACCESS(MinskyMatrix);
   public:
     MinskyMatrix(size_t n, double* data): n(n), data(data) {}
+    size_t size() const {return n;}
     double& operator()(size_t i, size_t j) {return data[i*n+j];}
     double operator()(size_t i, size_t j) const {return data[i*n+j];}
   };
@@ -106,8 +167,69 @@ namespace minsky
     /// NaN. Either a variable name, or and operator type.
     std::string diagnoseNonFinite() const;
 
-    /// write current state of all variables to the log file
-    void logVariables() const;
+    /// queue current state of logged variables for writing to the log file
+    void logVariables();
+
+    friend class SolverThread;
+    friend struct RKdata;
+    /// advance \a stock from time \a t by nSteps of the integrator
+    void integrate(double& t, std::vector<double>& stock);
+    /// as integrate, but using the integrator \a ode (explicit Euler
+    /// if null), and flow initialisers \a flowBase. \a stock has
+    /// \a dimension elements - the global stockVars may be swapped
+    /// by the GUI thread whilst this runs.
+    void integrateWith(RKdata* ode, double& t, double stock[], size_t dimension,
+                       const std::vector<double>& flowBase) const;
+    /// flow variable initialisers for the current run
+    const std::vector<double>& flowBase() const
+    {return flowInit? *flowInit: flowVars;}
+    /// @{ evalEquations and jacobian with explicit flow initialisers,
+    /// safe to call concurrently
+    void evalDerivatives(double result[], double t, const double vars[],
+                         const std::vector<double>& flowBase) const;
+    void evalJacobian(MinskyMatrix& jac, double t, const double vars[],
+                      const std::vector<double>& flowBase) const;
+    /// @}
+    /// integrate scenario \a s from state (\a t, \a stock, \a flow) until \a tEnd
+    void runScenario(ScenarioBranch& s, RKdata* ode, double t,
+                     std::vector<double>& stock, std::vector<double>& flow,
+                     double tEnd) const;
+    const ScenarioBranch& scenario(const std::string& name) const;
+    /// copy states published by the solver into the model, logging
+    /// them and updating icons. @return number of states consumed
+    size_t applySolverStates();
+    /// update icons displaying simulation values
+    void updateLiveIcons() {
+      // drop icons deleted since the equations were attached
+      liveIcons.erase(std::remove_if(liveIcons.begin(), liveIcons.end(),
+                                     [](const std::weak_ptr<Item>& i)
+                                     {return i.expired();}), liveIcons.end());
+      for (auto& w: liveIcons)
+        if (auto i=w.lock())
+          i->updateIcon(t);
+    }
+    /// current integrator step size
+    double odeStepSize() const;
+    /// take a checkpoint if checkpointInterval has elapsed since the last
+    void checkpointIfDue(double stepSize);
+    void recordCheckpoint(double stepSize);
+
+    /// connect plots and live icons to the constructed equations
+    void attachEquations();
+    /// reinstate pendingEquations. @return false if there are none,
+    /// or they do not fit the model, in which case equations need to
+    /// be constructed
+    bool restoreEquations();
+    /// snapshot of the current equations, referring to items by their
+    /// schema \a ids. @return null if the equations cannot be stored
+    shared_ptr<CompiledEquations> compileEquations
+    (const std::map<const Item*,int>& ids) const;
+    /// read the equations stored alongside \a filename into
+    /// pendingEquations, if they match \a modelHash
+    void loadEquations(const std::string& filename, unsigned long long modelHash,
+                       std::map<int,ItemPtr>& items);
+    /// validated by its setter, so plotting never throws
+    unsigned m_plotHistoryCapacity{8192};
 
   protected:
     /// contents of current selection
@@ -120,7 +242,11 @@ namespace minsky
     /// true if reset needs to be called prior to numerical integration
     bool reset_flag() const {return flags & reset_needed;}
     /// indicate model has been changed since last saved
-    void markEdited() {flags |= is_edited | reset_needed;}
+    void markEdited() {
+      flags |= is_edited | reset_needed;
+      pendingEquations.reset();
+      equationViewStale=true;
+    }
 
     /// @{ push and pop state of the flags
     void pushFlags() {flagStack.push_back(flags);}
@@ -153,6 +279,7 @@ namespace minsky
 
     // reset m_edited as the GodleyIcon constructor calls markEdited
     Minsky() {model->height=model->width=std::numeric_limits<float>::max();}
+    ~Minsky() {if (solver) solver->stop();}
 
     GroupPtr model{new Group};
 
@@ -196,7 +323,7 @@ namespace minsky
     /// erase items in current selection, put copy into clipboard
     void cut();
     /// copy items in current selection into clipboard
-    void copy() const;
+    void copy();
     /// paste  clipboard as a new group. @return id of nre group
     GroupPtr paste();
     void saveSelectionAsFile(const string& fileName) const;
@@ -206,7 +333,21 @@ namespace minsky
     /// @{ override to provide clipboard handling functionality
     virtual void putClipboard(const string&) const {}
     virtual std::string getClipboard() const {return "";}
+    /// take ownership of the system clipboard, its contents to be
+    /// supplied when requested by clipboardChunk(). @return false if
+    /// the platform cannot supply clipboard contents on demand
+    virtual bool claimClipboard() {return false;}
     /// @}
+    /// XML representation of the clipboard contents
+    std::string clipboardText() const;
+    /// \a maxChars characters of clipboardText() from \a offset
+    std::string clipboardChunk(size_t offset, size_t maxChars) const
+    {
+      clipboardText();
+      return offset<clipboardXML.size()? clipboardXML.substr(offset,maxChars): "";
+    }
+    /// called when another application takes ownership of the clipboard
+    void clipboardLost() {clipboardOwned=false; clipboard.reset(); clipboardXML.clear();}
 
     /// toggle selected status of given item
     void toggleSelected(ItemType itemType, int item);
@@ -223,10 +364,25 @@ namespace minsky
     bool cycleCheck() const;
 
     /// opens the log file, and writes out a header line describing
-    /// names of all variables
+    /// names of all variables. Records are written on a background
+    /// thread
     void openLogFile(const string&);
-    /// closes log file
-    void closeLogFile() {outputDataFile.reset();}
+    /// closes log file, after all queued records have been written
+    /// @throw if any record could not be written
+    void closeLogFile();
+
+    /// valueIds of variables to be logged. If empty, all variables are logged
+    std::set<string> logVarList;
+    /// number of records that can be queued for the log writer thread
+    unsigned logBufferSize{1024};
+    /// if true, records are discarded when the log writer falls
+    /// behind, otherwise the simulation waits for it
+    bool logDropWhenFull{false};
+    /// @{ log writer statistics
+    size_t logQueueDepth() const {return outputDataFile? outputDataFile->queueDepth(): 0;}
+    size_t logStalls() const {return outputDataFile? outputDataFile->stalls(): 0;}
+    size_t logDropped() const {return outputDataFile? outputDataFile->dropped(): 0;}
+    /// @}
 
     /// construct the equations based on input data
     /// @throws ecolab::error if the data is inconsistent
@@ -259,17 +415,113 @@ namespace minsky
     void reset(); ///<resets the variables back to their initial values
     void step();  ///< step the equations (by n steps, default 1)
 
-    /// save to a file
+    /// @{ run the simulation on a background thread (see SolverThread)
+    /// start the solver thread
+    void startSimulation();
+    /// stop the solver thread, and bring the model up to date
+    void stopSimulation();
+    /// temporarily stop the solver thread to allow the model to be
+    /// edited. It is restarted by the next call to syncSimulation()
+    void pauseSimulation();
+    /// bring the model up to date with states published by the solver
+    /// thread, and resume it if paused. Called periodically by the GUI
+    /// @return number of steps consumed
+    /// @throw ecolab::error if the solver stopped on an error
+    size_t syncSimulation();
+    bool simulationRunning() const
+    {return simulationPaused || (solver && solver->running());}
+    /// maximum number of steps the solver may run ahead of the GUI
+    unsigned simulationQueueSize{1024};
+    /// @}
+
+    /// @{ checkpoints allow the simulation to be rewound without
+    /// re-integrating from the start
+    /// simulation time between automatic checkpoints. 0 disables
+    double checkpointInterval{0};
+    /// maximum number of checkpoints held in memory
+    unsigned maxCheckpoints{100};
+    /// directory to write older checkpoints to. If empty, they are discarded
+    string checkpointSpillDir;
+    /// record a checkpoint of the current simulation state
+    void takeCheckpoint() {recordCheckpoint(odeStepSize());}
+    size_t numCheckpoints() const {return checkpoints.size();}
+    /// simulation time of checkpoint \a i
+    double checkpointTime(size_t i) const;
+    /// return the simulation to checkpoint \a i, discarding later
+    /// checkpoints and plot data
+    /// @throw ecolab::error if the model has changed since the checkpoint
+    void restoreCheckpoint(size_t i);
+    /// @}
+
+    /// @{ scenarios are variations of the model, each run from the
+    /// end of a common prefix, concurrently with each other. The
+    /// prefix's trajectory is shared by all scenario results.
+    /// run the simulation until \a tEnd, recording its trajectory as
+    /// the prefix of subsequently run scenarios
+    void runScenarioPrefix(double tEnd);
+    /// define a scenario called \a name, initially identical to the model
+    void addScenario(const std::string& name) {scenarios[name];}
+    void removeScenario(const std::string& name) {scenarios.erase(name);}
+    /// override the value of variable \a valueId at the branch point
+    /// of scenario \a name. Parameters not defined by an equation
+    /// retain the value throughout the scenario.
+    void setScenarioParameter(const std::string& name, const std::string& valueId,
+                              double value);
+    /// run all scenarios concurrently until \a tEnd. If no prefix has
+    /// been run, the current state is used.
+    void runScenarios(double tEnd);
+    /// times of the records of scenario \a name, including its prefix
+    std::vector<double> scenarioTimes(const std::string& name) const;
+    /// values of variable \a valueId in scenario \a name, including its prefix
+    std::vector<double> scenarioValues(const std::string& name,
+                                       const std::string& valueId) const;
+    /// error that terminated scenario \a name, if any
+    std::string scenarioError(const std::string& name) const
+    {return scenario(name).error;}
+    /// @}
+
+    /// save to a file. A .mkyb extension selects the binary format
     void save(const std::string& filename);
-    /// load from a file
+    /// @{ save to a file on a background thread. The model is
+    /// snapshotted before returning, and may be edited or simulated
+    /// while the file is written. Poll saveInProgress() for
+    /// completion, then collect any error with takeSaveError()
+    void saveInBackground(const std::string& filename);
+    bool saveInProgress() const {return saver && saver->busy();}
+    /// wait for background saves to complete
+    void waitForSave() {if (saver) saver->wait();}
+    /// error message of a failed background save (empty if none),
+    /// which is then cleared. A failed save marks the model as edited
+    std::string takeSaveError();
+    /// @}
+    /// if true, save also stores the compiled equations in a file
+    /// alongside the model, which load uses to skip constructing
+    /// them when the model is unchanged. Off by default, as it
+    /// writes a second file next to the user's model
+    bool storeEquations{false};
+    /// load from a file, in either XML or binary format. Equations
+    /// are constructed when the simulation is next run or reset
     void load(const std::string& filename);
+    /// convert model file \a from into \a to, between the XML and
+    /// binary (.mkyb) formats, without loading it into this model
+    void convertModelFile(const std::string& from, const std::string& to) const;
+    /// @{ time (in seconds) spent parsing the file, building the
+    /// model and indexing its layout during the last load, and
+    /// constructing equations during the last reset
+    double loadParseTime{0}, loadBuildTime{0}, loadLayoutTime{0};
+    double equationBuildTime{0};
+    /// @}
 
     void exportSchema(const char* filename, int schemaLevel=1);
 
     /// indicate position of error on canvas
     virtual void displayErrorItem(float x, float y) const {}
-    /// indicate operation item has error, if visible, otherwise contining group
+    /// indicate operation item has error, if visible, otherwise
+    /// contining group. Ignored other than on the GUI thread
     void displayErrorItem(const Item& op) const;
+    /// as above, but may also be called from the solver thread, in
+    /// which case the item is indicated by the next syncSimulation()
+    void displayErrorItem(const std::shared_ptr<Item>& op) const;
 
     /// returns operation ID for a given EvalOp. -1 if a temporary
     //    int opIdOfEvalOp(const EvalOpBase&) const;
@@ -282,6 +534,30 @@ namespace minsky
     string ecolabVersion() {return VERSION;}
 
     unsigned maxHistory{100}; ///< maximum no. of history states to save
+    /// maximum memory used by history states. The most recent is
+    /// always retained
+    size_t maxHistoryBytes{64*1024*1024};
+    /// @{ memory used by the undo history
+    size_t historyBytes() const {return history.bytes();}
+    size_t historyEntryBytes(size_t i) const {return history.entryBytes(i);}
+    size_t historySize() const {return history.size();}
+    /// @}
+    /// @{ maximum number of points retained per plot pen. Older
+    /// points are kept at progressively lower resolution.
+    unsigned plotHistoryCapacity() const {return m_plotHistoryCapacity;}
+    /// @throw if \a c is less than PlotHistory::minCapacity
+    unsigned plotHistoryCapacity(unsigned c);
+    /// @}
+    /// maximum rate (frames per second) at which plots are rendered
+    /// during simulation
+    double plotFrameRate{25};
+    /// render all plots with their latest data, and wait for completion
+    void flushPlotFrames();
+    /// @{ plot render thread statistics
+    size_t plotFramesRendered() const {return plotRenderer().frames();}
+    size_t plotFramesDropped() const {return plotRenderer().dropped();}
+    double plotRenderTime() const {return plotRenderer().renderTime();}
+    /// @}
 
     /// clear history
     void clearHistory() {history.clear(); historyPtr=0;}
@@ -298,6 +574,8 @@ namespace minsky
 
     /// set a Tk image to render equations to
     void renderEquationsToImage(const char* image);
+    /// rerender any equations changed since the model was last edited
+    void updateEquationView() const;
 
     /// Converts variable(s) named by \a name into a variable of type \a type.
     /// @throw if conversion is disallowed
@@ -308,6 +586,27 @@ namespace minsky
 
     /// render canvas to a cairo context
     void renderCanvas(cairo_t*) const;
+    /// render the part of the canvas within \a region to a cairo
+    /// context whose origin is the canvas origin
+    void renderRegion(cairo_t*, const BoundingBox& region) const;
+    /// fraction of icons drawn from the icon cache since the last
+    /// resetIconCacheStats()
+    double iconCacheHitRate() const {return iconCache().hitRate();}
+    void resetIconCacheStats() {iconCache().resetStats();}
+    /// memory used by the icon cache, in bytes
+    size_t iconCacheBytes() const {return iconCache().bytes();}
+    /// @{ memory budget of the icon cache, in bytes
+    size_t iconCacheBudget() const {return iconCache().maxBytes;}
+    void iconCacheBudget(size_t bytes) {iconCache().maxBytes=bytes;}
+    /// @}
+    /// discard memoised sizes and images of labels, after the font
+    /// they are drawn with has changed
+    void fontsChanged();
+    /// @{ family of the font labels are drawn in, empty for Pango's
+    /// default. Setting it calls fontsChanged()
+    std::string defaultFont() const;
+    std::string defaultFont(const std::string&);
+    /// @}
 
     /// render canvas to a postscript file
     void renderCanvasToPS(const char* filename) const;
@@ -315,6 +614,11 @@ namespace minsky
     void renderCanvasToPDF(const char* filename) const;
     /// render canvas to an SVG file
     void renderCanvasToSVG(const char* filename) const;
+    /// render canvas to a PNG file at \a scale pixels per canvas
+    /// unit. Memory used is bounded independently of the image size
+    void renderCanvasToPNG(const char* filename, double scale) const;
+    /// bounds of the visible canvas contents, from the spatial indexes
+    BoundingBox canvasBounds() const;
 
 
   };
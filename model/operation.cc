@@ -290,6 +290,14 @@ namespace minsky
     return r;
   }
 
+  string OperationBase::iconState() const
+  {
+    string r=name();
+    if (auto c=dynamic_cast<const NamedOp*>(this))
+      r+=":"+c->description;
+    return r;
+  }
+
   void Constant::adjustSliderBounds()
   {
     if (sliderMax<value) sliderMax=value;
@@ -337,6 +345,9 @@ namespace minsky
   }
 
   double DataOp::interpolate(double x) const
+  {return interpolate(data, x);}
+
+  double DataOp::interpolate(const map<double, double>& data, double x)
   {
     // not terribly sensible, but need to return something
     if (data.empty()) return 0;
@@ -361,6 +372,9 @@ namespace minsky
   }
 
   double DataOp::deriv(double x) const
+  {return deriv(data, x);}
+
+  double DataOp::deriv(const map<double, double>& data, double x)
   {
     map<double, double>::const_iterator v=data.lower_bound(x);
     if (v==data.end() || v==data.begin())
@@ -388,6 +402,7 @@ namespace minsky
 
   template <> void Operation<OperationType::data>::iconDraw(cairo_t* cairo) const
   {
+    cairo_save(cairo);
     cairo_translate(cairo,-1,0);
     cairo_scale(cairo,1.5,0.75);
     cairo_arc(cairo,0,-3,3,0,2*M_PI);
@@ -396,7 +411,9 @@ namespace minsky
     cairo_line_to(cairo,-3,-3);
     cairo_move_to(cairo,3,3);
     cairo_line_to(cairo,3,-3);
-    cairo_identity_matrix(cairo);
+    // stroke in the icon's own coordinates, undistorted by the
+    // scaling above. The path is retained by cairo_restore
+    cairo_restore(cairo);
     cairo_set_line_width(cairo,1);
     cairo_stroke(cairo);
   }
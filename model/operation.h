@@ -92,6 +92,7 @@ namespace minsky
     virtual void addPorts();
 
     void draw(cairo_t*) const override;
+    std::string iconState() const override;
 
   protected:
 
@@ -192,6 +193,8 @@ namespace minsky
       assert(intVar);
       return ports.size()>0 && intVar->ports.size()>0 && ports[0]==intVar->ports[0];
     }
+    /// a coupled integral positions its variable when drawn
+    bool iconCacheable() const override {return !coupled();}
 
     void setZoomOnAttachedVariable() {
       assert(intVar);
@@ -216,6 +219,10 @@ namespace minsky
     // derivative is defined as the weighted average of the left & right
     // derivatives, weighted by the respective intervals
     double deriv(double) const;
+    /// @{ as above, on \a data rather than this operation's data
+    static double interpolate(const std::map<double, double>& data, double);
+    static double deriv(const std::map<double, double>& data, double);
+    /// @}
 
     void pack(pack_t& x, const string& d) const override;
     void unpack(unpack_t& x, const string& d) override;
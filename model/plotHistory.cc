@@ -0,0 +1,196 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "plotHistory.h"
+#include <error.h>
+#include <algorithm>
+using namespace std;
+
+namespace minsky
+{
+  const unsigned PlotHistory::numLevels;
+  const unsigned PlotHistory::fanout;
+  const size_t PlotHistory::minCapacity;
+
+  void PlotHistory::Bucket::merge(const Bucket& b)
+  {
+    xlo=min(xlo,b.xlo);
+    xhi=max(xhi,b.xhi);
+    if (b.lo.y<lo.y) {lo=b.lo; loIdx=b.loIdx;}
+    if (b.hi.y>hi.y) {hi=b.hi; hiIdx=b.hiIdx;}
+    first=min(first,b.first);
+    count+=b.count;
+  }
+
+  void PlotHistory::setCapacity(size_t c)
+  {
+    if (c<minCapacity)
+      throw ecolab::error("plot history capacity must be at least %d",int(minCapacity));
+    m_capacity=c;
+    // the raw tail and each level in use hold at most levelCapacity
+    // entries, which must allow a merge per level
+    levelCapacity=max(size_t(fanout), c/(numLevels+1));
+    m_levels=min(size_t(numLevels), c/levelCapacity-1);
+    for (auto& p: pens)
+      {
+        // fold levels no longer in use into the coarsest, oldest first
+        auto& coarsest=p.levels[m_levels-1];
+        for (size_t l=m_levels; l<numLevels; ++l)
+          {
+            coarsest.insert(coarsest.begin(), p.levels[l].begin(), p.levels[l].end());
+            p.levels[l].clear();
+          }
+        enforceCapacity(p);
+      }
+  }
+
+  void PlotHistory::append(unsigned pen, double x, double y)
+  {
+    if (pen>=pens.size())
+      pens.resize(pen+1);
+    Pen& p=pens[pen];
+    p.raw.emplace_back(x,y);
+    p.count++;
+    enforceCapacity(p);
+  }
+
+  void PlotHistory::enforceCapacity(Pen& p)
+  {
+    // index of the oldest raw point
+    size_t rawStart=p.count-p.raw.size();
+    while (p.raw.size()>levelCapacity)
+      {
+        Bucket b(p.raw.front(), rawStart++);
+        p.raw.pop_front();
+        for (unsigned i=1; i<fanout && !p.raw.empty(); ++i)
+          {
+            b.merge(Bucket(p.raw.front(), rawStart++));
+            p.raw.pop_front();
+          }
+        p.levels[0].push_back(b);
+      }
+
+    // each level holds data older than the one below it, so
+    // overflowing entries are appended to the back of the next level
+    for (size_t l=0; l<m_levels; ++l)
+      {
+        auto& level=p.levels[l];
+        if (l+1<m_levels)
+          while (level.size()>levelCapacity)
+            {
+              Bucket b=level.front();
+              level.pop_front();
+              for (unsigned i=1; i<fanout && !level.empty(); ++i)
+                {
+                  b.merge(level.front());
+                  level.pop_front();
+                }
+              p.levels[l+1].push_back(b);
+            }
+        else
+          // coarsest level - halve resolution in place
+          while (level.size()>levelCapacity)
+            {
+              size_t j=0;
+              for (size_t i=0; i<level.size(); i+=fanout, ++j)
+                {
+                  level[j]=level[i];
+                  for (size_t k=i+1; k<i+fanout && k<level.size(); ++k)
+                    level[j].merge(level[k]);
+                }
+              level.resize(j);
+            }
+      }
+  }
+
+  void PlotHistory::truncate(unsigned pen, size_t n)
+  {
+    if (pen>=pens.size() || n>=pens[pen].count) return;
+    Pen& p=pens[pen];
+    size_t rawStart=p.count-p.raw.size();
+    p.raw.resize(n>rawStart? n-rawStart: 0);
+    for (auto& level: p.levels)
+      while (!level.empty() && level.back().first+level.back().count>n)
+        level.pop_back();
+    p.count=n;
+  }
+
+  size_t PlotHistory::storedEntries() const
+  {
+    size_t r=0;
+    for (auto& p: pens)
+      {
+        r+=p.raw.size();
+        for (auto& l: p.levels)
+          r+=l.size();
+      }
+    return r;
+  }
+
+  void PlotHistory::query
+  (unsigned pen, vector<double>& x, vector<double>& y, size_t maxPoints,
+   double x0, double x1) const
+  {
+    x.clear(); y.clear();
+    if (pen>=pens.size()) return;
+    const Pen& p=pens[pen];
+
+    // gather entries overlapping the requested range, oldest first
+    vector<Bucket> selected;
+    for (size_t l=numLevels; l-->0;)
+      for (auto& b: p.levels[l])
+        if (b.xhi>=x0 && b.xlo<=x1)
+          selected.push_back(b);
+    size_t idx=p.count-p.raw.size();
+    for (auto& pt: p.raw)
+      {
+        if (pt.x>=x0 && pt.x<=x1)
+          selected.emplace_back(pt, idx);
+        ++idx;
+      }
+
+    // each bucket may emit two points, so merge further if the
+    // selection exceeds the caller's budget
+    size_t maxBuckets=max(size_t(1), maxPoints/2);
+    if (maxPoints>0 && selected.size()>maxBuckets)
+      {
+        size_t stride=(selected.size()+maxBuckets-1)/maxBuckets, j=0;
+        for (size_t i=0; i<selected.size(); i+=stride, ++j)
+          {
+            selected[j]=selected[i];
+            for (size_t k=i+1; k<i+stride && k<selected.size(); ++k)
+              selected[j].merge(selected[k]);
+          }
+        selected.resize(j);
+      }
+
+    for (auto& b: selected)
+      if (b.loIdx==b.hiIdx)
+        {
+          x.push_back(b.lo.x); y.push_back(b.lo.y);
+        }
+      else
+        {
+          // emit extremes in the order they were sampled
+          const Point& first=b.loIdx<b.hiIdx? b.lo: b.hi;
+          const Point& second=b.loIdx<b.hiIdx? b.hi: b.lo;
+          x.push_back(first.x); y.push_back(first.y);
+          x.push_back(second.x); y.push_back(second.y);
+        }
+  }
+}
@@ -0,0 +1,120 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PLOTHISTORY_H
+#define PLOTHISTORY_H
+#include <deque>
+#include <vector>
+#include <limits>
+#include <stddef.h>
+
+namespace minsky
+{
+  /**
+     Bounded memory store of plot data.
+
+     Each pen keeps the most recent points at full resolution, with
+     older points summarised in a pyramid of successively coarser
+     levels. Each entry of a level records the extreme (minimum and
+     maximum y) points of a run of consecutive samples, so spikes
+     survive decimation. When the raw tail overflows, its oldest points
+     are merged into the first level, which overflows into the next,
+     and so on. The coarsest level halves its resolution in place when
+     full, so total storage per pen never exceeds the configured
+     capacity.
+  */
+  class PlotHistory
+  {
+  public:
+    struct Point
+    {
+      double x, y;
+      Point(double x=0, double y=0): x(x), y(y) {}
+    };
+
+    /// summary of a run of consecutive samples
+    struct Bucket
+    {
+      double xlo, xhi;  ///< x extent of the run
+      Point lo, hi;     ///< points with minimum and maximum y
+      size_t loIdx, hiIdx; ///< sample number of lo and hi
+      size_t first;     ///< sample number of first sample in run
+      size_t count;     ///< number of samples summarised
+      Bucket() {}
+      Bucket(const Point& p, size_t idx):
+        xlo(p.x), xhi(p.x), lo(p), hi(p), loIdx(idx), hiIdx(idx),
+        first(idx), count(1) {}
+      void merge(const Bucket&);
+    };
+
+    /// number of pyramid levels above the raw tail
+    static const unsigned numLevels=8;
+    /// number of entries merged into a single entry of the next level
+    static const unsigned fanout=2;
+
+    explicit PlotHistory(size_t capacity=8192) {setCapacity(capacity);}
+
+    /// smallest capacity supported
+    static const size_t minCapacity=2*fanout;
+    /// set the maximum number of entries stored per pen. Small
+    /// capacities use fewer pyramid levels.
+    /// @throw if less than minCapacity
+    void setCapacity(size_t);
+    size_t capacity() const {return m_capacity;}
+
+    /// append a point to \a pen
+    void append(unsigned pen, double x, double y);
+    void clear() {pens.clear();}
+    /// number of pens with data
+    size_t numPens() const {return pens.size();}
+    /// total number of points ever appended to \a pen
+    size_t count(unsigned pen) const
+    {return pen<pens.size()? pens[pen].count: 0;}
+    /// number of entries currently stored across all pens
+    size_t storedEntries() const;
+    /// discard all samples of \a pen from sample number \a n
+    /// onwards. Summary entries straddling \a n are discarded too, as
+    /// their extremes may come from discarded samples.
+    void truncate(unsigned pen, size_t n);
+
+    /// retrieve at most \a maxPoints points of \a pen lying within
+    /// [\a x0, \a x1], in sample order, at the finest resolution
+    /// available within that budget
+    void query(unsigned pen, std::vector<double>& x, std::vector<double>& y,
+               size_t maxPoints,
+               double x0=-std::numeric_limits<double>::max(),
+               double x1=std::numeric_limits<double>::max()) const;
+
+  private:
+    struct Pen
+    {
+      std::deque<Point> raw;
+      std::vector<std::deque<Bucket> > levels=
+        std::vector<std::deque<Bucket> >(numLevels);
+      size_t count=0;
+    };
+    std::vector<Pen> pens;
+    size_t m_capacity, levelCapacity;
+    /// number of pyramid levels in use, at most numLevels
+    unsigned m_levels;
+    /// restore the storage bound on \a p after an append or capacity change
+    void enforceCapacity(Pen& p);
+  };
+}
+
+#endif
@@ -0,0 +1,141 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "plotRenderer.h"
+#include <chrono>
+#include <ecolab_epilogue.h>
+using namespace std;
+
+namespace minsky
+{
+  bool PlotFrame::blit(cairo_t* cairo, double w, double h)
+  {
+    // vector output (exports) must be drawn from the data itself
+    switch (cairo_surface_get_type(cairo_get_target(cairo)))
+      {
+      case CAIRO_SURFACE_TYPE_PDF: case CAIRO_SURFACE_TYPE_PS:
+      case CAIRO_SURFACE_TYPE_SVG: case CAIRO_SURFACE_TYPE_RECORDING:
+        return false;
+      default: break;
+      }
+    lock_guard<std::mutex> lock(mutex);
+    // only use the frame if it reflects the loaded data, or a newer
+    // one is on its way
+    if (!front || (frontGeneration!=generation && outstanding==0) ||
+        cairo_image_surface_get_width(front)!=int(w) ||
+        cairo_image_surface_get_height(front)!=int(h))
+      return false;
+    cairo_save(cairo);
+    cairo_set_source_surface(cairo, front, 0, 0);
+    cairo_paint(cairo);
+    cairo_restore(cairo);
+    return true;
+  }
+
+  PlotRenderer::~PlotRenderer()
+  {
+    {
+      lock_guard<std::mutex> lock(mutex);
+      running=false;
+    }
+    jobAvailable.notify_one();
+    if (worker.joinable())
+      worker.join();
+  }
+
+  void PlotRenderer::submit(const shared_ptr<PlotFrame>& frame,
+                            const ecolab::Plot& plot, int width, int height)
+  {
+    if (width<=0 || height<=0) return;
+    lock_guard<std::mutex> lock(mutex);
+    if (!worker.joinable())
+      worker=thread([this]{run();});
+    for (auto& j: jobs)
+      if (j.frame==frame)
+        {
+          // supersede the pending snapshot
+          j.plot.reset(new ecolab::Plot(plot));
+          j.width=width; j.height=height;
+          j.generation=frame->generation;
+          m_dropped++;
+          return;
+        }
+    frame->outstanding++;
+    jobs.push_back(Job{frame, unique_ptr<ecolab::Plot>(new ecolab::Plot(plot)),
+          width, height, frame->generation});
+    jobAvailable.notify_one();
+  }
+
+  void PlotRenderer::waitIdle()
+  {
+    unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]{return jobs.empty() && !busy;});
+  }
+
+  void PlotRenderer::run()
+  {
+    unique_lock<std::mutex> lock(mutex);
+    while (running)
+      {
+        jobAvailable.wait(lock, [this]{return !jobs.empty() || !running;});
+        while (!jobs.empty())
+          {
+            Job job=move(jobs.front());
+            jobs.pop_front();
+            busy=true;
+            lock.unlock();
+            render(job);
+            lock.lock();
+            busy=false;
+          }
+        idle.notify_all();
+      }
+  }
+
+  void PlotRenderer::render(Job& job)
+  {
+    auto start=chrono::steady_clock::now();
+    cairo_surface_t* back=cairo_image_surface_create
+      (CAIRO_FORMAT_ARGB32, job.width, job.height);
+    cairo_t* cairo=cairo_create(back);
+    cairo_set_line_width(cairo,1);
+    job.plot->draw(cairo, job.width, job.height);
+    cairo_destroy(cairo);
+    cairo_surface_flush(back);
+
+    {
+      lock_guard<std::mutex> lock(job.frame->mutex);
+      swap(back, job.frame->front);
+      job.frame->frontGeneration=job.generation;
+    }
+    if (back) cairo_surface_destroy(back);
+    job.frame->outstanding--;
+    job.frame->ready=true;
+
+    m_frames++;
+    // atomic<double> has no fetch_add
+    double elapsed=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    for (double r=m_renderTime; !m_renderTime.compare_exchange_weak(r, r+elapsed););
+  }
+
+  PlotRenderer& plotRenderer()
+  {
+    static PlotRenderer renderer;
+    return renderer;
+  }
+}
@@ -0,0 +1,117 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PLOTRENDERER_H
+#define PLOTRENDERER_H
+#include "plot.h"
+#include <cairo.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace minsky
+{
+  /// double buffered raster image of a plot's data area. The back
+  /// buffer is private to the render thread; the front buffer is
+  /// swapped in under \a mutex.
+  class PlotFrame
+  {
+    std::mutex mutex;
+    cairo_surface_t* front=nullptr;
+    unsigned frontGeneration=0;
+    friend class PlotRenderer;
+  public:
+    /// size of plot area at last draw (main thread only)
+    double width=0, height=0;
+    /// generation of data currently loaded into the widget (main thread only)
+    unsigned generation=0;
+    /// number of frames submitted but not yet rendered
+    std::atomic<int> outstanding{0};
+    /// set by the render thread when a new front buffer is available
+    std::atomic<bool> ready{false};
+
+    PlotFrame() {}
+    PlotFrame(const PlotFrame&)=delete;
+    void operator=(const PlotFrame&)=delete;
+    ~PlotFrame() {if (front) cairo_surface_destroy(front);}
+
+    /// paint the front buffer at the origin of \a cairo, if it is
+    /// current and of size \a w x \a h. @return true if painted
+    bool blit(cairo_t* cairo, double w, double h);
+  };
+
+  /// gives each copy of a widget its own frame
+  struct PlotFrameRef: public std::shared_ptr<PlotFrame>
+  {
+    PlotFrameRef(): std::shared_ptr<PlotFrame>(new PlotFrame) {}
+    PlotFrameRef(const PlotFrameRef&): PlotFrameRef() {}
+    PlotFrameRef& operator=(const PlotFrameRef&) {return *this;}
+  };
+
+  /**
+     Rasterises plot snapshots on a worker thread. Snapshots submitted
+     for a frame that has not yet been started replace the pending one,
+     so a slow renderer drops frames rather than holding up the
+     simulation.
+  */
+  class PlotRenderer
+  {
+    struct Job
+    {
+      std::shared_ptr<PlotFrame> frame;
+      std::unique_ptr<ecolab::Plot> plot;
+      int width, height;
+      unsigned generation;
+    };
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable, idle;
+    bool running=true, busy=false;
+    std::thread worker;
+    std::atomic<size_t> m_frames{0}, m_dropped{0};
+    std::atomic<double> m_renderTime{0};
+    void run();
+    void render(Job&);
+  public:
+    PlotRenderer() {}
+    ~PlotRenderer();
+    PlotRenderer(const PlotRenderer&)=delete;
+    void operator=(const PlotRenderer&)=delete;
+
+    /// queue \a plot to be rendered into \a frame at \a width x \a height pixels
+    void submit(const std::shared_ptr<PlotFrame>& frame, const ecolab::Plot& plot,
+                int width, int height);
+    /// wait until all submitted frames have been rendered
+    void waitIdle();
+
+    /// number of frames rendered
+    size_t frames() const {return m_frames;}
+    /// number of snapshots superseded before being rendered
+    size_t dropped() const {return m_dropped;}
+    /// total time (in seconds) spent rendering
+    double renderTime() const {return m_renderTime;}
+  };
+
+  /// render worker shared by all plots
+  PlotRenderer& plotRenderer();
+}
+
+#endif
@@ -114,6 +114,15 @@ namespace minsky
     xvars.resize(numLines);
    }
 
+  void PlotWidget::resize(int w, int h)
+  {
+    width=w;
+    height=h;
+    invalidateGeometry();
+    if (auto g=group.lock())
+      g->itemResized(*this);
+  }
+
   void PlotWidget::draw(cairo::Surface& cairoSurface)
   {
     displayNTicks = min(10.0f, 3*zoomFactor);
@@ -209,7 +218,10 @@ namespace minsky
 
    cairo_translate(cairo, 10*zoomFactor,yoffs);
     cairo_set_line_width(cairo,1);
-    Plot::draw(cairo,w-20*zoomFactor,h-yoffs);
+    frame->width=w-20*zoomFactor;
+    frame->height=h-yoffs;
+    if (!frame->blit(cairo,frame->width,frame->height))
+      Plot::draw(cairo,frame->width,frame->height);
     
     cairo_restore(cairo);
     if (mouseFocus)
@@ -243,6 +255,7 @@ namespace minsky
     justDataChanged=true; // assume plot same size, don't do unnecessary stuff
     // store previous min/max values to determine if plot scale changes
     double minmax[]={minx,maxx,miny,maxy,miny1,maxy1};
+    loadPlotData();
     scalePlot();
     if (cairoSurface.get())
       cairoSurface->requestRedraw();
@@ -257,17 +270,40 @@ namespace minsky
      
   }
 
+  void PlotWidget::loadPlotData()
+  {
+    size_t pixels=width*zoomFactor;
+    if (expandedPlot.get())
+      pixels=max(pixels, size_t(expandedPlot->width()));
+    // restrict to the visible x range, if specified
+    double x0=-numeric_limits<double>::max(), x1=numeric_limits<double>::max();
+    if (xminVar.idx()>-1) x0=xminVar.value();
+    if (xmaxVar.idx()>-1) x1=xmaxVar.value();
+
+    Plot::clear();
+    frame->generation++;
+    vector<double> xs, ys;
+    for (unsigned pen=0; pen<history.numPens(); ++pen)
+      {
+        // min/max pairs, so two points per pixel
+        history.query(pen, xs, ys, 2*pixels, x0, x1);
+        for (size_t i=0; i<xs.size(); ++i)
+          Plot::addPt(pen, xs[i], ys[i]);
+      }
+  }
+
   void PlotWidget::makeDisplayPlot() {
     if (auto g=group.lock())
       g->displayPlot=dynamic_pointer_cast<PlotWidget>(g->findItem(*this));
   }
 
   
-  static ptime epoch=microsec_clock::local_time(), accumulatedBlitTime=epoch;
-
   void PlotWidget::addPlotPt(double t)
   {
-    for (size_t pen=0; pen<2*numLines; ++pen)
+    if (history.capacity()!=cminsky().plotHistoryCapacity())
+      history.setCapacity(cminsky().plotHistoryCapacity());
+    // yvars is empty until a variable is connected
+    for (size_t pen=0; pen<yvars.size(); ++pen)
       if (yvars[pen].idx()>=0)
         {
           double x,y;
@@ -292,19 +328,45 @@ namespace minsky
                 throw error("x input not wired for pen %d",(int)pen+1);
               break;
             }
-          addPt(pen, x, y);
+          history.append(pen, x, y);
         }
 
-    // throttle plot redraws
-    static time_duration maxWait=milliseconds(1000);
-    if ((microsec_clock::local_time()-(ptime&)lastAdd) >
-        min((accumulatedBlitTime-(ptime&)lastAccumulatedBlitTime) * 2, maxWait))
+    pollFrame();
+    // submit frames at no more than plotFrameRate, and not while the
+    // previous one is still being rendered. Hidden plots just
+    // accumulate data.
+    double frameRate=cminsky().plotFrameRate;
+    if (frameRate>0 && frame->outstanding==0 &&
+        microsec_clock::local_time()-(ptime&)lastAdd > microseconds(long(1e6/frameRate))
+        && (visible() || expandedPlot.get()))
+      requestFrame();
+  }
+
+  void PlotWidget::requestFrame()
+  {
+    lastAdd=microsec_clock::local_time();
+    loadPlotData();
+    justDataChanged=true;
+    scalePlot();
+    if (frame->width>0 && (cairoSurface.get() || groupPlot.get()))
+      plotRenderer().submit(frame, *this, frame->width, frame->height);
+    // popup windows are rarely open, so are still drawn synchronously
+    if (expandedPlot.get())
+      {
+        expandedPlot->clear();
+        Plot::draw(*expandedPlot);
+        expandedPlot->blit();
+      }
+  }
+
+  void PlotWidget::pollFrame()
+  {
+    if (frame->ready.exchange(false))
       {
-        ptime timerStart=microsec_clock::local_time();
-        redraw();
-        lastAccumulatedBlitTime = accumulatedBlitTime;
-        lastAdd=microsec_clock::local_time();
-        accumulatedBlitTime += lastAdd - timerStart;
+        if (cairoSurface.get())
+          cairoSurface->requestRedraw();
+        if (groupPlot.get())
+          groupPlot->requestRedraw();
       }
   }
 
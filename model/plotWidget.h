@@ -24,6 +24,8 @@
 #include "plot.h"
 #include "variable.h"
 #include "zoom.h"
+#include "plotHistory.h"
+#include "plotRenderer.h"
 
 #include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/date_time/posix_time/ptime.hpp>
@@ -36,14 +38,19 @@ namespace minsky
   {
     CLASSDESC_ACCESS(PlotWidget);
     friend class SchemaHelper;
-    // timestamp of last time this widget was blitted and also the
-    // accumulated blit time at last add.
+    // timestamp of last frame submitted for rendering
     classdesc::Exclude<boost::posix_time::ptime> 
-      lastAdd{boost::posix_time::microsec_clock::local_time()},
-      lastAccumulatedBlitTime{boost::posix_time::microsec_clock::local_time()};
+      lastAdd{boost::posix_time::microsec_clock::local_time()};
+    /// rendered image of the plot area, updated by the render thread
+    classdesc::Exclude<PlotFrameRef> frame;
     // overrides placement of ports etc when just data has changed
     bool justDataChanged=false;
     classdesc::Exclude<Tk_Canvas> canvas; // canvas this widget will be displayed on
+    /// all data points added to this plot, decimated to bounded memory
+    classdesc::Exclude<PlotHistory> history;
+    /// reload the plot's pens from history, with at most one point
+    /// per pixel of the widest open window
+    void loadPlotData();
     friend struct PlotItem;
   public:
     using Item::x;
@@ -65,22 +72,53 @@ namespace minsky
     std::string title;
  
     int width{150}, height{150};
+    /// set the icon size, keeping the enclosing group's spatial
+    /// index current. Use in preference to assigning width/height
+    void resize(int w, int h);
 
     PlotWidget();
 
     void addPlotPt(double t); ///< add another plot point
+    /// add a point to \a pen directly, retaining it in history so it
+    /// survives a redraw
+    void addPt(unsigned pen, double x, double y)
+    {history.append(pen, x, y); Plot::addPt(pen, x, y);}
+    /// clear plot data, including history
+    void clear() {history.clear(); Plot::clear(); frame->generation++;}
+    /// number of points (over all pens) currently retained in history
+    size_t historyEntries() const {return history.storedEntries();}
+    /// number of points added to each pen
+    std::vector<size_t> historyCursor() const {
+      std::vector<size_t> r;
+      for (unsigned pen=0; pen<history.numPens(); ++pen)
+        r.push_back(history.count(pen));
+      return r;
+    }
+    /// discard points added since \a cursor was obtained from historyCursor()
+    void truncateHistory(const std::vector<size_t>& cursor) {
+      for (unsigned pen=0; pen<history.numPens(); ++pen)
+        history.truncate(pen, pen<cursor.size()? cursor[pen]: 0);
+    }
+    bool liveIcon() const override {return true;}
     void updateIcon(double t) override {addPlotPt(t);}
     /// connect variable \a var to port \a port. 
     void connectVar(const VariableValue& var, unsigned port);
     // draw canvas widget
     void draw(ecolab::cairo::Surface&) override;
     void draw(cairo_t* cairo) const override;
+    /// plots keep their own rendered frame
+    bool iconCacheable() const override {return false;}
     /// surfaces to draw into for redraw. expandedPlot refers to
     /// separate popup plot window
     Exclude<cairo::SurfacePtr> cairoSurface, expandedPlot, groupPlot; 
     void setCairoSurface(const ecolab::cairo::SurfacePtr& s) override 
     {cairoSurface=s;}
     void redraw(); // redraw plot using current data to all open windows
+    /// submit a snapshot of current data to the render thread
+    void requestFrame();
+    /// request redraw of canvas views if the render thread has
+    /// produced a new frame
+    void pollFrame();
 
     /// add this as a display plot to its group
     void makeDisplayPlot();
@@ -0,0 +1,149 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pngStream.h"
+#include <error.h>
+#include <stdint.h>
+#include <string.h>
+using namespace std;
+
+namespace minsky
+{
+  namespace
+  {
+    void put32(unsigned char* p, uint32_t x)
+    {
+      p[0]=x>>24; p[1]=x>>16; p[2]=x>>8; p[3]=x;
+    }
+  }
+
+  PNGStream::PNGStream(const string& filename, unsigned width, unsigned height):
+    f(fopen(filename.c_str(),"wb")), m_width(width), m_height(height),
+    row(1+4*size_t(width)), out(1<<16)
+  {
+    if (!f)
+      throw ecolab::error("cannot open %s",filename.c_str());
+    memset(&zs,0,sizeof(zs));
+    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION)!=Z_OK)
+      {
+        fclose(f);
+        throw ecolab::error("cannot initialise compression");
+      }
+    zs.next_out=out.data();
+    zs.avail_out=out.size();
+    static const unsigned char signature[]={0x89,'P','N','G','\r','\n',0x1a,'\n'};
+    fwrite(signature,1,sizeof(signature),f);
+    unsigned char ihdr[13];
+    put32(ihdr, width);
+    put32(ihdr+4, height);
+    ihdr[8]=8; // bit depth
+    ihdr[9]=6; // RGBA
+    ihdr[10]=ihdr[11]=ihdr[12]=0; // deflate, adaptive filtering, no interlace
+    chunk("IHDR",ihdr,sizeof(ihdr));
+  }
+
+  PNGStream::~PNGStream()
+  {
+    if (f)
+      {
+        deflateEnd(&zs);
+        fclose(f);
+      }
+  }
+
+  void PNGStream::chunk(const char* type, const unsigned char* data, size_t size)
+  {
+    unsigned char buf[8];
+    put32(buf, size);
+    memcpy(buf+4, type, 4);
+    fwrite(buf,1,8,f);
+    fwrite(data,1,size,f);
+    uLong crc=crc32(0, (const Bytef*)type, 4);
+    if (size) crc=crc32(crc, data, size);
+    put32(buf, crc);
+    fwrite(buf,1,4,f);
+  }
+
+  void PNGStream::deflate(int flush)
+  {
+    zs.next_in=row.data();
+    zs.avail_in=flush==Z_FINISH? 0: row.size();
+    for (;;)
+      {
+        int err=::deflate(&zs, flush);
+        if (err==Z_STREAM_ERROR)
+          throw ecolab::error("compression failed");
+        if (zs.avail_out==0)
+          {
+            chunk("IDAT", out.data(), out.size());
+            zs.next_out=out.data();
+            zs.avail_out=out.size();
+          }
+        else if (zs.avail_in==0 && (flush!=Z_FINISH || err==Z_STREAM_END))
+          break;
+      }
+  }
+
+  void PNGStream::write(const unsigned char* data, int stride, unsigned rows)
+  {
+    if (!f) throw ecolab::error("PNG file already closed");
+    for (unsigned r=0; r<rows && m_rows<m_height; ++r, ++m_rows)
+      {
+        auto src=reinterpret_cast<const uint32_t*>(data+r*stride);
+        unsigned char* dst=row.data();
+        *dst++=0; // no filtering
+        for (unsigned i=0; i<m_width; ++i)
+          {
+            uint32_t p=src[i];
+            unsigned a=p>>24, red=(p>>16)&0xff, green=(p>>8)&0xff, blue=p&0xff;
+            // PNG colours are not premultiplied by alpha
+            if (a>0 && a<255)
+              {
+                red=(red*255+a/2)/a;
+                green=(green*255+a/2)/a;
+                blue=(blue*255+a/2)/a;
+              }
+            *dst++=red; *dst++=green; *dst++=blue; *dst++=a;
+          }
+        deflate(Z_NO_FLUSH);
+      }
+  }
+
+  void PNGStream::close()
+  {
+    if (!f) return;
+    // pad any rows not supplied with transparent pixels
+    if (m_rows<m_height)
+      {
+        vector<uint32_t> blank(m_width);
+        while (m_rows<m_height)
+          write(reinterpret_cast<const unsigned char*>(blank.data()), 0, m_height-m_rows);
+      }
+    deflate(Z_FINISH);
+    if (zs.avail_out<out.size())
+      chunk("IDAT", out.data(), out.size()-zs.avail_out);
+    chunk("IEND", nullptr, 0);
+    deflateEnd(&zs);
+    bool failed=ferror(f);
+    failed|=fclose(f)!=0;
+    f=nullptr;
+    if (failed)
+      throw ecolab::error("error writing PNG file");
+  }
+}
@@ -0,0 +1,69 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PNGSTREAM_H
+#define PNGSTREAM_H
+#include <zlib.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace minsky
+{
+  /**
+     Writes an 8 bit RGBA PNG file a band of rows at a time, so an
+     image need never be held in memory as a whole. Rows are supplied
+     top to bottom in cairo's ARGB32 format.
+  */
+  class PNGStream
+  {
+  public:
+    /// @throw if \a filename cannot be opened
+    PNGStream(const std::string& filename, unsigned width, unsigned height);
+    ~PNGStream();
+    PNGStream(const PNGStream&)=delete;
+    void operator=(const PNGStream&)=delete;
+
+    /// append \a rows rows of premultiplied native endian ARGB32
+    /// pixels, starting at \a data, each \a stride bytes apart
+    void write(const unsigned char* data, int stride, unsigned rows);
+    /// finish the file, after all rows have been written
+    /// @throw if the file could not be written
+    void close();
+
+    unsigned width() const {return m_width;}
+    unsigned height() const {return m_height;}
+    unsigned rowsWritten() const {return m_rows;}
+
+  private:
+    FILE* f;
+    z_stream zs;
+    unsigned m_width, m_height, m_rows=0;
+    /// a row converted to PNG's filtered RGBA layout
+    std::vector<unsigned char> row;
+    /// compressed data awaiting output as an IDAT chunk
+    std::vector<unsigned char> out;
+
+    void chunk(const char* type, const unsigned char* data, size_t size);
+    /// compress the contents of row, emitting full output buffers
+    void deflate(int flush);
+  };
+}
+
+#endif
@@ -39,8 +39,12 @@ namespace minsky
 
   void Port::moveTo(float x, float y)
   {
-    m_x=x-item.x();
-    m_y=y-item.y();
+    float dx=x-item.x(), dy=y-item.y();
+    if (dx==m_x && dy==m_y) return;
+    m_x=dx;
+    m_y=dy;
+    for (auto w: wires)
+      w->invalidateGeometry();
   }
 
   GroupPtr Port::group() const
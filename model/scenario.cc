@@ -0,0 +1,67 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "scenario.h"
+#include <error.h>
+using namespace std;
+
+namespace minsky
+{
+  Trajectory::Trajectory(size_t nStock, size_t nFlow,
+                         const shared_ptr<const Trajectory>& prefix):
+    nStock(nStock), nFlow(nFlow), prefix(prefix)
+  {
+    if (prefix && (prefix->nStock!=nStock || prefix->nFlow!=nFlow))
+      throw ecolab::error("trajectory does not match its prefix");
+  }
+
+  void Trajectory::append(double t, const vector<double>& stock,
+                          const vector<double>& flow)
+  {
+    if (stock.size()!=nStock || flow.size()!=nFlow)
+      throw ecolab::error("state does not match trajectory");
+    data.push_back(t);
+    data.insert(data.end(), stock.begin(), stock.end());
+    data.insert(data.end(), flow.begin(), flow.end());
+  }
+
+  size_t Trajectory::size() const
+  {
+    return ownSize()+(prefix? prefix->size(): 0);
+  }
+
+  const double* Trajectory::record(size_t i) const
+  {
+    size_t prefixSize=prefix? prefix->size(): 0;
+    if (i<prefixSize)
+      return prefix->record(i);
+    i-=prefixSize;
+    if (i>=ownSize())
+      throw ecolab::error("trajectory record %d out of range",int(i+prefixSize));
+    return &data[i*stride()];
+  }
+
+  void Trajectory::state(size_t i, double& t, vector<double>& stock,
+                         vector<double>& flow) const
+  {
+    const double* r=record(i);
+    t=r[0];
+    stock.assign(r+1, r+1+nStock);
+    flow.assign(r+1+nStock, r+1+nStock+nFlow);
+  }
+}
@@ -0,0 +1,80 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SCENARIO_H
+#define SCENARIO_H
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+namespace minsky
+{
+  /**
+     Values of all stock and flow variables at each step of a run.
+
+     A trajectory may continue from a \a prefix, which is shared
+     between all trajectories branching from it rather than copied.
+     Records are indexed from the start of the prefix.
+  */
+  class Trajectory
+  {
+    size_t nStock, nFlow;
+    /// records of t, stocks, flows, packed contiguously
+    std::vector<double> data;
+    size_t stride() const {return 1+nStock+nFlow;}
+  public:
+    const std::shared_ptr<const Trajectory> prefix;
+
+    Trajectory(size_t nStock, size_t nFlow,
+               const std::shared_ptr<const Trajectory>& prefix=nullptr);
+
+    void append(double t, const std::vector<double>& stock,
+                const std::vector<double>& flow);
+    /// number of records, including those of the prefix
+    size_t size() const;
+    /// number of records held by this trajectory
+    size_t ownSize() const {return data.size()/stride();}
+    double time(size_t i) const {return record(i)[0];}
+    /// value of the stock (\a isFlow false) or flow variable \a idx at record \a i
+    double value(size_t i, bool isFlow, size_t idx) const
+    {return record(i)[1+(isFlow? nStock: 0)+idx];}
+    /// copy the state at record \a i
+    void state(size_t i, double& t, std::vector<double>& stock,
+               std::vector<double>& flow) const;
+    /// memory used by the records of this trajectory, excluding the prefix
+    size_t bytes() const {return sizeof(double)*data.size();}
+  private:
+    const double* record(size_t i) const;
+  };
+
+  /// a variation of the model run concurrently from the end of a
+  /// shared prefix
+  struct ScenarioBranch
+  {
+    /// values overriding those of the base model at the branch
+    /// point, keyed by valueId
+    std::map<std::string,double> parameters;
+    std::shared_ptr<Trajectory> results;
+    /// error that terminated the branch, if any
+    std::string error;
+  };
+}
+
+#endif
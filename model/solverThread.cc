@@ -0,0 +1,120 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "solverThread.h"
+#include "minsky.h"
+#include <chrono>
+#include <cmath>
+#include <ecolab_epilogue.h>
+using namespace std;
+
+namespace minsky
+{
+  void SolverThread::start()
+  {
+    if (m_running) return;
+    if (thread.joinable()) thread.join();
+    state.t=minsky.t;
+    state.stock=ValueVector::stockVars;
+    state.flow=flowInit=ValueVector::flowVars;
+    minsky.flowInit=&flowInit;
+    stopRequested=false;
+    m_steps=0;
+    m_running=true;
+    thread=std::thread([this]{run();});
+  }
+
+  void SolverThread::stop()
+  {
+    stopRequested=true;
+    if (thread.joinable()) thread.join();
+    m_running=false;
+    minsky.flowInit=nullptr;
+  }
+
+  void SolverThread::setError(const string& msg)
+  {
+    lock_guard<mutex> lock(errorMutex);
+    // keep the original cause, as subsequent errors tend to be generic
+    if (m_error.empty())
+      m_error=msg;
+    else
+      m_error+="\n"+msg;
+    stopRequested=true;
+  }
+
+  string SolverThread::takeError()
+  {
+    lock_guard<mutex> lock(errorMutex);
+    string r;
+    swap(r,m_error);
+    return r;
+  }
+
+  void SolverThread::setErrorItem(const weak_ptr<Item>& item)
+  {
+    lock_guard<mutex> lock(errorMutex);
+    errorItem=item;
+  }
+
+  shared_ptr<Item> SolverThread::takeErrorItem()
+  {
+    lock_guard<mutex> lock(errorMutex);
+    auto r=errorItem.lock();
+    errorItem.reset();
+    return r;
+  }
+
+  void SolverThread::run()
+  {
+    State published;
+    try
+      {
+        while (!stopRequested)
+          {
+            minsky.integrate(state.t, state.stock);
+            state.stepSize=minsky.odeStepSize();
+            // update flow variables
+            for (auto& e: minsky.equations)
+              e->eval(&state.flow[0], &state.stock[0]);
+            m_steps++;
+
+            published=state; // reuses storage recycled by the queue
+            while (!queue.push(published))
+              {
+                if (stopRequested) break;
+                this_thread::sleep_for(chrono::milliseconds(1));
+              }
+
+            // same delay scale as the Tk simulation speed slider
+            if (minsky.simulationDelay>0)
+              {
+                auto wakeup=chrono::steady_clock::now()+chrono::milliseconds
+                  (int(pow(10, minsky.simulationDelay/4.0)));
+                while (!stopRequested && chrono::steady_clock::now()<wakeup)
+                  this_thread::sleep_for(chrono::milliseconds(10));
+              }
+          }
+      }
+    catch (const std::exception& e)
+      {
+        setError(e.what());
+      }
+    m_running=false;
+  }
+}
@@ -0,0 +1,104 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SOLVERTHREAD_H
+#define SOLVERTHREAD_H
+#include "ringBuffer.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace minsky
+{
+  class Minsky;
+  class Item;
+
+  /**
+     Runs Minsky's integrator on a separate thread.
+
+     The solver works on a private copy of the stock and flow
+     variables, and publishes the state after each step through a
+     single producer/single consumer queue. The GUI thread pops these
+     states and copies them into the global variable vectors, so it
+     always sees a consistent snapshot, and the solver never touches
+     state the GUI reads. If the GUI falls behind, the solver waits
+     for the queue to drain.
+
+     While running, the model structure (equations, Godley tables,
+     integrals) must not be modified - call stop() first.
+  */
+  class SolverThread
+  {
+  public:
+    struct State
+    {
+      double t=0;
+      double stepSize=0; ///< integrator step size
+      std::vector<double> stock, flow;
+    };
+
+    SolverThread(Minsky& minsky, size_t queueSize):
+      minsky(minsky), queue(queueSize) {}
+    ~SolverThread() {stop();}
+    SolverThread(const SolverThread&)=delete;
+    void operator=(const SolverThread&)=delete;
+
+    /// start integrating from the current global state
+    void start();
+    /// stop integration, waiting for the current step to complete.
+    /// Published states remain available to pop()
+    void stop();
+    bool running() const {return m_running;}
+    /// true if called from the solver thread
+    bool onSolverThread() const {return std::this_thread::get_id()==thread.get_id();}
+
+    /// retrieve the oldest unconsumed state, swapping its storage with \a s
+    bool pop(State& s) {return queue.pop(s);}
+
+    /// record an error message, stopping the solver
+    void setError(const std::string&);
+    /// error that stopped the solver (if any), which is then cleared
+    std::string takeError();
+    /// record an item in error, for display by the GUI thread
+    void setErrorItem(const std::weak_ptr<Item>&);
+    /// retrieve the recorded item in error, which is then
+    /// cleared. @return null if none, or if it has since been deleted
+    std::shared_ptr<Item> takeErrorItem();
+
+    /// number of steps taken since start
+    size_t steps() const {return m_steps;}
+  private:
+    Minsky& minsky;
+    RingBuffer<State> queue;
+    State state;
+    /// flow variable initialisers, constant over a run
+    std::vector<double> flowInit;
+    std::thread thread;
+    std::atomic<bool> m_running{false}, stopRequested{false};
+    std::atomic<size_t> m_steps{0};
+    std::mutex errorMutex;
+    std::string m_error;
+    std::weak_ptr<Item> errorItem;
+    void run();
+  };
+}
+
+#endif
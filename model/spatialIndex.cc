@@ -0,0 +1,120 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "spatialIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <ecolab_epilogue.h>
+using namespace std;
+
+namespace minsky
+{
+  namespace
+  {
+    /// limit on the depth of nodes below the root
+    const unsigned maxDepth=16;
+    /// half width of the initial root
+    const float initialHalf=256;
+  }
+
+  BoundingBox& BoundingBox::operator|=(const BoundingBox& b)
+  {
+    x0=min(x0,b.x0); y0=min(y0,b.y0);
+    x1=max(x1,b.x1); y1=max(y1,b.y1);
+    return *this;
+  }
+
+  void SpatialIndex::enclose(const BoundingBox& b)
+  {
+    float cx=0.5f*(b.x0+b.x1), cy=0.5f*(b.y0+b.y1);
+    float h=0.5f*max(b.x1-b.x0, b.y1-b.y0);
+    if (!root)
+      root.reset(new Node(cx, cy, max(h, initialHalf)));
+    // double the root towards the entry, making the old root one of
+    // the new root's children
+    while (h>root->half || abs(cx-root->cx)>root->half || abs(cy-root->cy)>root->half)
+      {
+        float half=root->half;
+        bool right=cx>=root->cx, up=cy>=root->cy;
+        unique_ptr<Node> newRoot
+          (new Node(root->cx+(right? half: -half), root->cy+(up? half: -half), 2*half));
+        // old root lies in the quadrant opposite the direction of growth
+        newRoot->child[(right? 0: 1)+(up? 0: 2)]=move(root);
+        root=move(newRoot);
+      }
+  }
+
+  void SpatialIndex::insert(const ItemPtr& it, const BoundingBox& b)
+  {
+    remove(*it);
+    if (location.empty())
+      extent=b;
+    else
+      extent|=b;
+    enclose(b);
+    float cx=0.5f*(b.x0+b.x1), cy=0.5f*(b.y0+b.y1);
+    float h=0.5f*max(b.x1-b.x0, b.y1-b.y0);
+    Node* n=root.get();
+    for (unsigned depth=0; depth<maxDepth && h<=0.5f*n->half; ++depth)
+      {
+        bool right=cx>=n->cx, up=cy>=n->cy;
+        auto& c=n->child[(right? 1: 0)+(up? 2: 0)];
+        if (!c)
+          {
+            float q=0.5f*n->half;
+            c.reset(new Node(n->cx+(right? q: -q), n->cy+(up? q: -q), q));
+          }
+        n=c.get();
+      }
+    Entry e;
+    e.item=it;
+    e.box=b;
+    n->entries.push_back(e);
+    location[it.get()]=n;
+  }
+
+  ItemPtr SpatialIndex::remove(const Item& it)
+  {
+    ItemPtr r;
+    auto l=location.find(&it);
+    if (l==location.end()) return r;
+    auto& entries=l->second->entries;
+    for (auto e=entries.begin(); e!=entries.end(); ++e)
+      if (e->item.get()==&it)
+        {
+          r=e->item;
+          entries.erase(e);
+          break;
+        }
+    location.erase(l);
+    return r;
+  }
+
+  bool SpatialIndex::find(const Item& it, BoundingBox& b) const
+  {
+    auto l=location.find(&it);
+    if (l==location.end()) return false;
+    for (auto& e: l->second->entries)
+      if (e.item.get()==&it)
+        {
+          b=e.box;
+          return true;
+        }
+    return false;
+  }
+}
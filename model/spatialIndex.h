@@ -0,0 +1,137 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <map>
+
+namespace minsky
+{
+  class Item;
+  typedef std::shared_ptr<Item> ItemPtr;
+
+  /// axis aligned rectangle
+  struct BoundingBox
+  {
+    float x0=0, y0=0, x1=0, y1=0;
+    BoundingBox() {}
+    BoundingBox(float x0, float y0, float x1, float y1):
+      x0(x0), y0(y0), x1(x1), y1(y1) {}
+    bool intersects(const BoundingBox& b) const
+    {return x0<=b.x1 && b.x0<=x1 && y0<=b.y1 && b.y0<=y1;}
+    bool contains(const BoundingBox& b) const
+    {return x0<=b.x0 && b.x1<=x1 && y0<=b.y0 && b.y1<=y1;}
+    BoundingBox& operator|=(const BoundingBox&);
+  };
+
+  /**
+     Loose quadtree of item bounding boxes. Each entry is stored in
+     the smallest node whose square contains the entry's centre, and
+     whose square doubled in size contains the entry, so insertion,
+     removal and query cost depend on the depth of the tree and the
+     number of nearby entries, not on the total number of entries. The
+     root grows outwards as entries are added beyond it.
+  */
+  class SpatialIndex
+  {
+  public:
+    SpatialIndex() {}
+    // the tree is a cache, which is not copied with its owner
+    SpatialIndex(const SpatialIndex&) {}
+    SpatialIndex& operator=(const SpatialIndex&) {clear(); return *this;}
+
+    void insert(const ItemPtr&, const BoundingBox&);
+    /// @return the entry removed, or null if \a it is not indexed
+    ItemPtr remove(const Item& it);
+    /// replace the box \a it is indexed with
+    /// @return false if \a it is not indexed
+    bool update(const Item& it, const BoundingBox& b) {
+      if (auto i=remove(it)) {insert(i,b); return true;}
+      return false;
+    }
+    /// retrieve the box \a it was indexed with
+    /// @return false if \a it is not indexed
+    bool find(const Item& it, BoundingBox&) const;
+    void clear() {root.reset(); location.clear(); extent=BoundingBox();}
+    size_t size() const {return location.size();}
+    bool empty() const {return location.empty();}
+    /// a box containing every entry ever inserted since the last clear
+    const BoundingBox& bounds() const {return extent;}
+
+    /// call \a f with each entry whose box intersects \a b
+    template <class F> void query(const BoundingBox& b, F f) const
+    {if (root) query(*root, b, f);}
+
+  private:
+    struct Entry
+    {
+      ItemPtr item;
+      BoundingBox box;
+    };
+    struct Node
+    {
+      float cx, cy, half; ///< centre and half width of the tight bounds
+      std::vector<Entry> entries;
+      std::unique_ptr<Node> child[4];
+      Node(float cx, float cy, float half): cx(cx), cy(cy), half(half) {}
+      /// bounds of entries stored at or below this node
+      BoundingBox looseBounds() const
+      {return BoundingBox(cx-2*half, cy-2*half, cx+2*half, cy+2*half);}
+    };
+    std::unique_ptr<Node> root;
+    std::unordered_map<const Item*, Node*> location;
+    BoundingBox extent;
+
+    /// grow the root until it can hold \a b
+    void enclose(const BoundingBox& b);
+
+    template <class F> static void query(const Node& n, const BoundingBox& b, F& f)
+    {
+      if (!n.looseBounds().intersects(b)) return;
+      for (auto& e: n.entries)
+        if (e.box.intersects(b))
+          f(e.item);
+      for (auto& c: n.child)
+        if (c) query(*c, b, f);
+    }
+  };
+
+  /// spatial index of the items and groups directly within a group,
+  /// in coordinates relative to the group's position. It is built on
+  /// first use, and entries whose size is unknown are measured lazily.
+  struct GroupSpatialIndex: public SpatialIndex
+  {
+    bool valid=false;
+    std::map<const Item*, ItemPtr> unmeasured;
+    GroupSpatialIndex() {}
+    GroupSpatialIndex(const GroupSpatialIndex&) {}
+    GroupSpatialIndex& operator=(const GroupSpatialIndex&) {invalidate(); return *this;}
+    void invalidate() {
+      if (!valid) return;
+      valid=false;
+      clear();
+      unmeasured.clear();
+    }
+  };
+}
+
+#endif
@@ -144,6 +144,19 @@ namespace minsky
       return unsigned(x);
   }
 
+  void SwitchIcon::updateIcon(double t)
+  {
+    int v=value();
+    // displayedValue is updated when the redraw happens
+    if (v!=displayedValue && cairoSurface && visible())
+      cairoSurface->requestRedraw();
+  }
+
+  std::string SwitchIcon::iconState() const
+  {
+    return std::to_string(numCases())+(flipped? "f:": ":")+std::to_string(value());
+  }
+
   void SwitchIcon::draw(cairo_t* cairo) const
   {
     cairo_set_line_width(cairo,1);
@@ -170,8 +183,9 @@ namespace minsky
         ports[i]->moveTo(x()+-0.5*w-o, y()+y1);
       }
     // draw indicating arrow
+    displayedValue=value();
     cairo_move_to(cairo,0.5*w, 0);
-    y1=-0.5*width+0.5*dy+value()*dy;
+    y1=-0.5*width+0.5*dy+displayedValue*dy;
     cairo_line_to(cairo,-0.45*w,0.9*y1);
     cairo_stroke(cairo);
 
@@ -29,6 +29,8 @@ namespace minsky
     CLASSDESC_ACCESS(SwitchIcon);
     friend class SchemaHelper;
     ecolab::cairo::SurfacePtr cairoSurface;
+    /// value currently shown on the icon, -1 if not yet drawn
+    mutable int displayedValue=-1;
   public:
     SwitchIcon();
 
@@ -40,8 +42,9 @@ namespace minsky
     void setNumCases(unsigned);
     /// @}
 
-    void updateIcon(double t) override 
-    {if (cairoSurface) cairoSurface->requestRedraw();}
+    bool liveIcon() const override {return true;}
+    /// redraw only if the selected case has changed
+    void updateIcon(double t) override;
     void setCairoSurface(const ecolab::cairo::SurfacePtr& s) override 
     {cairoSurface=s;}
 
@@ -52,6 +55,7 @@ namespace minsky
 
     /// draw icon to \a context
     void draw(cairo_t* context) const override;
+    std::string iconState() const override;
   };
 }
 
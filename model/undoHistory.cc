@@ -0,0 +1,159 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "undoHistory.h"
+#include <error.h>
+#include <zlib.h>
+#include <algorithm>
+#include <string.h>
+using namespace std;
+
+namespace minsky
+{
+  namespace
+  {
+    template <class D>
+    size_t deltaBytes(const D& d) {return sizeof(d)+d.data.capacity();}
+  }
+
+  UndoHistory::Delta UndoHistory::diff(const Buffer& older, const Buffer& newer)
+  {
+    Delta d;
+    size_t n=min(older.size(), newer.size());
+    d.prefix=mismatch(older.begin(), older.begin()+n, newer.begin()).first-older.begin();
+    n-=d.prefix;
+    d.suffix=mismatch(older.rbegin(), older.rbegin()+n, newer.rbegin()).first-older.rbegin();
+    d.size=older.size()-d.prefix-d.suffix;
+
+    const char* middle=older.data()+d.prefix;
+    uLongf len=compressBound(d.size);
+    d.data.resize(len);
+    d.compressed=d.size>0 &&
+      compress2((Bytef*)d.data.data(), &len, (const Bytef*)middle, d.size,
+                Z_BEST_SPEED)==Z_OK && len<d.size;
+    if (d.compressed)
+      d.data.resize(len);
+    else
+      d.data.assign(middle, middle+d.size);
+    d.data.shrink_to_fit();
+    return d;
+  }
+
+  void UndoHistory::apply(const Delta& d, Buffer& state)
+  {
+    if (d.prefix+d.suffix>state.size())
+      throw ecolab::error("corrupt undo history");
+    Buffer r(d.prefix+d.size+d.suffix);
+    copy(state.begin(), state.begin()+d.prefix, r.begin());
+    if (d.compressed)
+      {
+        uLongf len=d.size;
+        if (uncompress((Bytef*)&r[d.prefix], &len, (const Bytef*)d.data.data(),
+                       d.data.size())!=Z_OK || len!=d.size)
+          throw ecolab::error("corrupt undo history");
+      }
+    else
+      copy(d.data.begin(), d.data.end(), r.begin()+d.prefix);
+    copy(state.end()-d.suffix, state.end(), r.end()-d.suffix);
+    state.swap(r);
+  }
+
+  bool UndoHistory::push(const char* data, size_t size)
+  {
+    if (!head.empty() && head.size()==size && memcmp(head.data(), data, size)==0)
+      return false;
+    Buffer state(data, data+size);
+    if (!head.empty())
+      {
+        deltas.push_back(diff(head, state));
+        m_bytes+=deltaBytes(deltas.back());
+      }
+    m_bytes-=head.size();
+    m_bytes+=state.size();
+    head.swap(state);
+    return true;
+  }
+
+  void UndoHistory::truncate(size_t n)
+  {
+    if (n>=size()) return;
+    if (n==0)
+      {
+        clear();
+        return;
+      }
+    Buffer state;
+    get(n-1, state);
+    while (deltas.size()>n-1)
+      {
+        m_bytes-=deltaBytes(deltas.back());
+        deltas.pop_back();
+      }
+    m_bytes-=head.size();
+    m_bytes+=state.size();
+    head.swap(state);
+  }
+
+  size_t UndoHistory::trim(size_t maxEntries, size_t maxBytes)
+  {
+    size_t removed=0;
+    while (!deltas.empty() && (size()>maxEntries || m_bytes>maxBytes))
+      {
+        m_bytes-=deltaBytes(deltas.front());
+        deltas.pop_front();
+        removed++;
+      }
+    if (cursorIdx<removed)
+      cursorValid=false;
+    else
+      cursorIdx-=removed;
+    return removed;
+  }
+
+  void UndoHistory::get(size_t i, Buffer& state) const
+  {
+    if (i>=size())
+      throw ecolab::error("undo history entry %d does not exist",int(i));
+    if (!cursorValid || cursorIdx<i)
+      {
+        cursor=head;
+        cursorIdx=deltas.size();
+      }
+    cursorValid=false; // in case of exception
+    for (; cursorIdx>i; --cursorIdx)
+      apply(deltas[cursorIdx-1], cursor);
+    cursorValid=true;
+    state=cursor;
+  }
+
+  void UndoHistory::clear()
+  {
+    deltas.clear();
+    Buffer().swap(head);
+    Buffer().swap(cursor);
+    cursorValid=false;
+    m_bytes=0;
+  }
+
+  size_t UndoHistory::entryBytes(size_t i) const
+  {
+    if (i>=size())
+      throw ecolab::error("undo history entry %d does not exist",int(i));
+    return i==deltas.size()? head.size(): deltaBytes(deltas[i]);
+  }
+}
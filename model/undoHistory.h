@@ -0,0 +1,89 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+#include <deque>
+#include <vector>
+#include <stddef.h>
+
+namespace minsky
+{
+  /**
+     Sequence of serialised model states for undo/redo.
+
+     Only the most recent state is held in full. Each earlier state
+     is held as a zlib compressed delta against its successor -
+     consisting of the bytes that differ between the common prefix
+     and common suffix of the two - so a state is reconstructed by
+     applying deltas backwards from the most recent one. The last
+     reconstructed state is cached, so stepping back through the
+     history applies one delta per step.
+  */
+  class UndoHistory
+  {
+  public:
+    typedef std::vector<char> Buffer;
+
+    size_t size() const {return head.empty()? 0: deltas.size()+1;}
+    bool empty() const {return head.empty();}
+
+    /// append state \a data, unless it is identical to the most
+    /// recent state. @return true if appended
+    bool push(const char* data, size_t size);
+    /// discard states from \a n onwards
+    void truncate(size_t n);
+    /// discard the oldest states until no more than \a maxEntries
+    /// remain, and no more than \a maxBytes are used (the most recent
+    /// state is always retained). @return number of states discarded
+    size_t trim(size_t maxEntries, size_t maxBytes);
+    /// reconstruct state \a i
+    void get(size_t i, Buffer& state) const;
+    void clear();
+
+    /// memory used by state \a i
+    size_t entryBytes(size_t i) const;
+    /// memory used by all states
+    size_t bytes() const {return m_bytes;}
+
+  private:
+    struct Delta
+    {
+      /// lengths of common prefix and suffix with the successor state
+      size_t prefix, suffix;
+      /// uncompressed length of the differing bytes
+      size_t size;
+      bool compressed;
+      Buffer data;
+    };
+    /// deltas[i] reconstructs state i from state i+1
+    std::deque<Delta> deltas;
+    Buffer head;
+    size_t m_bytes=0;
+    /// most recently reconstructed state
+    mutable Buffer cursor;
+    mutable size_t cursorIdx=0;
+    mutable bool cursorValid=false;
+
+    static Delta diff(const Buffer& from, const Buffer& to);
+    /// reconstruct the state preceding \a state, in place
+    static void apply(const Delta&, Buffer& state);
+  };
+}
+
+#endif
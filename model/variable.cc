@@ -149,6 +149,8 @@ string VariableBase::name(const std::string& name)
 
   m_name=name;
   ensureValueExists();
+  if (auto g=group.lock())
+    g->itemResized(*this);
   return this->name();
 }
 
@@ -126,6 +126,8 @@ namespace minsky
         @return cairo path of icon outline
     */
     void draw(cairo_t*) const override;
+    std::string iconState() const override
+    {return typeName(type())+":"+name();}
 
     bool inputWired() const;
   };
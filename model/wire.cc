@@ -20,31 +20,59 @@
 #include "wire.h"
 #include "port.h"
 #include "group.h"
+#include <tk.h>
 #include <ecolab_epilogue.h>
 
+// undocumented internal function in the Tk library
+extern "C" int TkMakeBezierCurve(Tk_Canvas,double*,int,int,void*,double*);
+
 using namespace std;
 
 namespace minsky
 {
-  vector<float> Wire::coords() const
+  const Wire::Geometry& Wire::geometry() const
   {
-    vector<float> c;
+    if (m_geometry.valid) return m_geometry;
+    auto& c=m_geometry.coords;
+    auto& curve=m_geometry.curve;
+    c.clear();
+    curve.clear();
     assert(from() && to());
     assert(m_coords.size() % 2 == 0);
     if (auto f=from())
       if (auto t=to())
         {
-          c.push_back(f->x());
-          c.push_back(f->y());
+          float fx=f->x(), fy=f->y(), tx=t->x(), ty=t->y();
+          c.push_back(fx);
+          c.push_back(fy);
           for (size_t i=0; m_coords.size()>1 && i<m_coords.size()-1; i+=2)
             {
-              c.push_back(f->x() + (t->x()-f->x())*m_coords[i]);
-              c.push_back(f->y() + (t->y()-f->y())*m_coords[i+1]);
+              c.push_back(fx + (tx-fx)*m_coords[i]);
+              c.push_back(fy + (ty-fy)*m_coords[i+1]);
+            }
+          c.push_back(tx);
+          c.push_back(ty);
+
+          if (c.size()==4)
+            curve.assign(c.begin(), c.end());
+          else
+            {
+              // need to convert to double precision for Tk
+              vector<double> dcoords(c.begin(), c.end());
+              // Use Tk's smoothing algorithm for computing curves
+              const int numSteps=100;
+              // Tk's documentation doesn't say how big this buffer should
+              // be, hopefully this is ample.
+              curve.resize(2*numSteps*(dcoords.size()+1));
+              int numPoints=
+                TkMakeBezierCurve(0,dcoords.data(),dcoords.size()/2,numSteps,
+                                  nullptr,curve.data());
+              curve.resize(2*numPoints);
             }
-          c.push_back(t->x());
-          c.push_back(t->y());
+          // only cache complete wires
+          m_geometry.valid=true;
         }
-    return c;
+    return m_geometry;
   }
 
   vector<float> Wire::coords(const vector<float>& coords)
@@ -64,6 +92,7 @@ namespace minsky
             m_coords[i-1] = (coords[i+1]-coords[1])/dy;
           }
       }
+    invalidateGeometry();
     return this->coords();
   }
 
@@ -127,7 +156,11 @@ namespace minsky
                 fg->addOutputVar();
                 assert(fg->outVariables.back()->ports.size()>1);
                 fg->addWire(new Wire(from(),fg->outVariables.back()->ports[1]));
+                // reattach, so this is told when its new port moves
+                from()->eraseWire(this);
                 m_from=fg->outVariables.back()->ports[0];
+                from()->wires.push_back(this);
+                invalidateGeometry();
               }
             // check if this wire is in to group
             i=find_if(tg->wires.begin(), tg->wires.end(), cmp);
@@ -136,7 +169,10 @@ namespace minsky
                 tg->addInputVar();
                 assert(tg->inVariables.back()->ports.size()>1);
                 tg->addWire(new Wire(tg->inVariables.back()->ports[0],to()));
+                to()->eraseWire(this);
                 m_to=tg->inVariables.back()->ports[1];
+                to()->wires.push_back(this);
+                invalidateGeometry();
               }
           }
   }
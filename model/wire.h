@@ -43,6 +43,20 @@ namespace minsky
     /// ports this wire connects
     std::weak_ptr<Port> m_from, m_to;
   public:
+    /// display geometry, computed from the port positions
+    struct Geometry
+    {
+      std::vector<float> coords; ///< control points, as x,y pairs
+      std::vector<double> curve; ///< points of the drawn curve, as x,y pairs
+      bool valid=false;
+      Geometry() {}
+      // copies are invalid, as they may refer to other ports
+      Geometry(const Geometry&) {}
+      Geometry& operator=(const Geometry&) {valid=false; return *this;}
+    };
+  private:
+    mutable classdesc::Exclude<Geometry> m_geometry;
+  public:
 
     Wire() {}
     Wire(const std::shared_ptr<Port>& from, const std::shared_ptr<Port>& to, 
@@ -54,8 +68,12 @@ namespace minsky
     std::shared_ptr<Port> to() const {return m_to.lock();}
 
     /// display coordinates 
-    std::vector<float> coords() const;
+    std::vector<float> coords() const {return geometry().coords;}
     std::vector<float> coords(const std::vector<float>& coords);
+    /// display geometry, cached until either port moves
+    const Geometry& geometry() const;
+    /// discard the cached geometry, after a port has moved
+    void invalidateGeometry() const {m_geometry.valid=false;}
 
     void straighten() {m_coords.clear();}
 
@@ -0,0 +1,191 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "wiringOrder.h"
+#include "group.h"
+#include "wire.h"
+#include "operation.h"
+#include "godleyIcon.h"
+#include <algorithm>
+#include <unordered_set>
+#include <ecolab_epilogue.h>
+using namespace std;
+
+namespace minsky
+{
+  namespace
+  {
+    /// true if \a x's outputs depend on its inputs within a time
+    /// step. Integrals and Godley tables output stocks.
+    bool passesThrough(const Item& x)
+    {
+      return !dynamic_cast<const IntOp*>(&x) && !dynamic_cast<const GodleyIcon*>(&x);
+    }
+
+    /// apply \a f to each item depending directly on \a x
+    template <class F> void forEachSuccessor(const Item& x, F f)
+    {
+      for (auto& p: x.ports)
+        if (p && !p->input())
+          for (auto w: p->wires)
+            if (auto to=w->to())
+              if (passesThrough(to->item))
+                f(to->item);
+    }
+
+    /// apply \a f to each item \a x depends directly on
+    template <class F> void forEachPredecessor(const Item& x, F f)
+    {
+      if (!passesThrough(x)) return;
+      for (auto& p: x.ports)
+        if (p && p->input())
+          for (auto w: p->wires)
+            if (auto from=w->from())
+              f(from->item);
+    }
+  }
+
+  unsigned WiringOrder::ord(const Item& x)
+  {
+    auto i=order.find(&x);
+    if (i!=order.end()) return i->second;
+    return order[&x]=nextOrder++;
+  }
+
+  bool WiringOrder::rebuild(const Group& model)
+  {
+    order.clear();
+    nextOrder=0;
+    m_valid=false;
+    auto items=model.findItems([](const ItemPtr&){return true;});
+
+    // Kahn's algorithm
+    unordered_map<const Item*, unsigned> inDegree;
+    for (auto& i: items)
+      forEachSuccessor(*i, [&](const Item& y){inDegree[&y]++;});
+    stack.clear();
+    for (auto& i: items)
+      if (!inDegree.count(i.get()))
+        stack.push_back(i.get());
+    while (!stack.empty())
+      {
+        const Item* x=stack.back();
+        stack.pop_back();
+        order[x]=nextOrder++;
+        forEachSuccessor(*x, [&](const Item& y){
+            if (--inDegree[&y]==0)
+              stack.push_back(&y);
+          });
+      }
+    // items left unordered lie on, or downstream of, a cycle
+    for (auto& i: inDegree)
+      if (i.second>0)
+        {
+          order.clear();
+          return false;
+        }
+    return m_valid=true;
+  }
+
+  bool WiringOrder::searchForward(const Item& y, unsigned bound)
+  {
+    forward.clear();
+    unordered_set<const Item*> visited{&y};
+    stack.assign(1, &y);
+    while (!stack.empty())
+      {
+        const Item* n=stack.back();
+        stack.pop_back();
+        forward.push_back(n);
+        bool cycle=false;
+        forEachSuccessor(*n, [&](const Item& w){
+            unsigned o=ord(w);
+            if (o==bound)
+              cycle=true;
+            else if (o<bound && visited.insert(&w).second)
+              stack.push_back(&w);
+          });
+        if (cycle) return true;
+      }
+    return false;
+  }
+
+  void WiringOrder::searchBackward(const Item& x, unsigned bound)
+  {
+    backward.clear();
+    unordered_set<const Item*> visited{&x};
+    stack.assign(1, &x);
+    while (!stack.empty())
+      {
+        const Item* n=stack.back();
+        stack.pop_back();
+        backward.push_back(n);
+        forEachPredecessor(*n, [&](const Item& z){
+            if (ord(z)>bound && visited.insert(&z).second)
+              stack.push_back(&z);
+          });
+      }
+  }
+
+  void WiringOrder::reorder()
+  {
+    auto byOrder=[&](const Item* a, const Item* b) {return order[a]<order[b];};
+    sort(backward.begin(), backward.end(), byOrder);
+    sort(forward.begin(), forward.end(), byOrder);
+    // the searched items take the same set of positions, with those
+    // reaching the new wire placed before those reachable from it
+    vector<unsigned> positions;
+    for (auto i: backward) positions.push_back(order[i]);
+    for (auto i: forward) positions.push_back(order[i]);
+    sort(positions.begin(), positions.end());
+    size_t p=0;
+    for (auto i: backward) order[i]=positions[p++];
+    for (auto i: forward) order[i]=positions[p++];
+  }
+
+  bool WiringOrder::wouldCycle(const Item& from, const Item& to)
+  {
+    if (&from==&to) return passesThrough(to);
+    if (!passesThrough(to)) return false;
+    unsigned lb=ord(to), ub=ord(from);
+    return lb<ub && searchForward(to, ub);
+  }
+
+  bool WiringOrder::addWire(const Wire& w)
+  {
+    if (!m_valid) return true;
+    auto fromP=w.from(), toP=w.to();
+    if (!fromP || !toP || !passesThrough(toP->item)) return true;
+    const Item& x=fromP->item, &y=toP->item;
+    if (&x==&y)
+      {
+        invalidate();
+        return false;
+      }
+    unsigned lb=ord(y), ub=ord(x);
+    if (lb>ub) return true; // already in order
+    if (searchForward(y, ub))
+      {
+        invalidate();
+        return false;
+      }
+    searchBackward(x, lb);
+    reorder();
+    return true;
+  }
+}
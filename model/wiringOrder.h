@@ -0,0 +1,90 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WIRINGORDER_H
+#define WIRINGORDER_H
+#include <unordered_map>
+#include <vector>
+
+namespace minsky
+{
+  class Item;
+  class Wire;
+  class Group;
+
+  /**
+     Topological order of the items in the wiring graph, updated
+     incrementally as wires are added, after Pearce & Kelly, "A
+     dynamic topological sort algorithm for directed acyclic graphs"
+     (2006). Adding a wire only reorders the items whose position lies
+     between the wire's endpoints, and only those reachable from them.
+
+     An item depends on the items wired to its inputs, except for
+     integrals and Godley tables, whose outputs are stocks, so wiring
+     into them cannot close a cycle.
+
+     The order refers to items by address, and is discarded whenever
+     the model is replaced wholesale. It is rebuilt from the whole
+     model on next use. Removing wires or items never invalidates it,
+     but removed items must be forgotten, as their addresses may be
+     reused.
+  */
+  class WiringOrder
+  {
+  public:
+    /// true if the order is current, which implies the wiring is acyclic
+    bool valid() const {return m_valid;}
+    /// number of items positioned
+    size_t size() const {return order.size();}
+    /// discard the order, eg when the model is replaced
+    void invalidate() {m_valid=false; order.clear();}
+    /// rebuild the order from all items in \a model.
+    /// @return false if the wiring contains a cycle
+    bool rebuild(const Group& model);
+
+    /// update the order for \a w, which has just been connected. If
+    /// \a w closes a cycle, the order is invalidated.
+    /// @return false if \a w closes a cycle
+    bool addWire(const Wire& w);
+    /// forget \a x, which has been removed from the model
+    void remove(const Item& x) {order.erase(&x);}
+    /// true if a wire from \a from to an input of \a to would close a
+    /// cycle. Requires a valid order.
+    bool wouldCycle(const Item& from, const Item& to);
+
+  private:
+    std::unordered_map<const Item*, unsigned> order;
+    unsigned nextOrder=0;
+    bool m_valid=false;
+    /// working storage for the searches
+    std::vector<const Item*> forward, backward, stack;
+
+    /// position of \a x in the order, new items being placed last
+    unsigned ord(const Item& x);
+    /// collect items reachable from \a y positioned before \a bound
+    /// into forward. @return true if an item at \a bound is reached
+    bool searchForward(const Item& y, unsigned bound);
+    /// collect items reaching \a x positioned after \a bound into backward
+    void searchBackward(const Item& x, unsigned bound);
+    /// reassign the positions of the searched items
+    void reorder();
+  };
+}
+
+#endif
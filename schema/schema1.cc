@@ -23,6 +23,7 @@
 #include "str.h"
 #include <ecolab_epilogue.h>
 #include <boost/regex.hpp>
+#include <chrono>
 
 namespace schema1
 {
@@ -282,6 +283,67 @@ namespace schema1
       v.check(variables) && v.check(groups) && v.check(godleys);
   }
 
+  namespace
+  {
+    /// 64 bit FNV-1a hash
+    struct StructuralHash
+    {
+      unsigned long long h=14695981039346656037ULL;
+      void bytes(const void* p, size_t n)
+      {
+        auto c=static_cast<const unsigned char*>(p);
+        for (size_t i=0; i<n; ++i)
+          h=(h^c[i])*1099511628211ULL;
+      }
+      StructuralHash& operator<<(int x) {bytes(&x,sizeof(x)); return *this;}
+      StructuralHash& operator<<(double x) {bytes(&x,sizeof(x)); return *this;}
+      StructuralHash& operator<<(const string& x)
+      {*this<<int(x.size()); bytes(x.data(),x.size()); return *this;}
+      template <class T> StructuralHash& operator<<(const vector<T>& x)
+      {
+        *this<<int(x.size());
+        for (auto& i: x) *this<<i;
+        return *this;
+      }
+      StructuralHash& operator<<(const map<double,double>& x)
+      {
+        *this<<int(x.size());
+        for (auto& i: x) *this<<i.first<<i.second;
+        return *this;
+      }
+    };
+  }
+
+  unsigned long long MinskyModel::structuralHash() const
+  {
+    StructuralHash h;
+    h<<int(wires.size());
+    for (auto& i: wires)
+      h<<i.id<<i.from<<i.to;
+    h<<int(operations.size());
+    for (auto& i: operations)
+      h<<i.id<<int(i.type)<<i.value<<i.ports<<i.data<<i.name<<i.intVar;
+    h<<int(variables.size());
+    for (auto& i: variables)
+      h<<i.id<<int(i.type)<<i.init<<i.ports<<i.name;
+    h<<int(plots.size());
+    for (auto& i: plots)
+      h<<i.id<<i.ports;
+    h<<int(groups.size());
+    for (auto& i: groups)
+      h<<i.id<<i.items<<i.ports<<i.createdVars<<i.name;
+    h<<int(switches.size());
+    for (auto& i: switches)
+      h<<i.id<<i.ports;
+    h<<int(godleys.size());
+    for (auto& i: godleys)
+      {
+        h<<i.id<<i.ports<<int(i.doubleEntryCompliant)<<i.name<<i.data;
+        for (auto a: i.assetClasses) h<<int(a);
+      }
+    return h.h;
+  }
+
   namespace
   {
     struct Portmap: public map<int, shared_ptr<minsky::Port> >
@@ -319,11 +381,15 @@ namespace schema1
   }
 
     // TODO combine in layout information
-  void Minsky::populateGroup(minsky::Group& g) const
+  void Minsky::populateGroup(minsky::Group& g, double* layoutTime,
+                             map<int,minsky::ItemPtr>* items) const
   {
     Portmap pmap;
     ItemMap imap(g);
+    auto start=chrono::steady_clock::now();
     Combine combine(layout);
+    if (layoutTime)
+      *layoutTime=chrono::duration<double>(chrono::steady_clock::now()-start).count();
     for (auto& i: model.notes)
       {
         auto it=imap.addItem(new minsky::Item, i);
@@ -434,17 +500,19 @@ namespace schema1
                   }
           }
       }
+    if (items)
+      items->swap(imap);
   }
 
 
-  Minsky::operator minsky::Minsky() const
+  void Minsky::populateMinsky(minsky::Minsky& m, double* layoutTime,
+                              map<int,minsky::ItemPtr>* items) const
   {
     if (!model.validate())
       throw ecolab::error("inconsistent Minsky model");
 
-    minsky::Minsky m;
     minsky::LocalMinsky lm(m);
-    populateGroup(*m.model);
+    populateGroup(*m.model, layoutTime, items);
 
     // strip any leading ':' from top level variables
 //    for (auto& i: m.model->items)
@@ -462,7 +530,6 @@ namespace schema1
     m.order=model.rungeKutta.order;
     m.simulationDelay=model.rungeKutta.simulationDelay;
     m.implicit=model.rungeKutta.implicit;
-   return m;
   }
 
   namespace
@@ -687,7 +754,7 @@ namespace schema1
     };
   }
 
-  Minsky::Minsky(const minsky::Group& g)
+  Minsky::Minsky(const minsky::Group& g, map<const minsky::Item*,int>* ids)
   {
     Group topLevel;
     // need to reserve enough memory on the group vector to prevent groups being moved
@@ -698,7 +765,14 @@ namespace schema1
                   });
     model.groups.reserve(cnt);
 
-    PopulateMinsky(*this).processGroup(topLevel,g);
+    PopulateMinsky populate(*this);
+    populate.processGroup(topLevel,g);
+    if (ids)
+      {
+        ids->swap(populate.itemMap);
+        for (auto& i: populate.groupMap)
+          ids->emplace(i.first, i.second);
+      }
   }    
 
 
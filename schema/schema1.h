@@ -147,7 +147,7 @@ namespace schema1
     map<double,double> data; //for data operations
     string name;
     int intVar;
-    Operation(): type(minsky::OperationType::numOps), value(0) {}
+    Operation(): type(minsky::OperationType::numOps), value(0), intVar(-1) {}
     Operation(int id, const minsky::OperationBase& op); 
   };
 
@@ -247,7 +247,7 @@ namespace schema1
   struct SizeLayout
   {
     double width, height;
-    SizeLayout() {}
+    SizeLayout(): width(0), height(0) {}
     template <class T>
     SizeLayout(const T& x): width(x.width), height(x.height) {}
   };
@@ -269,7 +269,7 @@ struct ItemLayout: public SPoly<ItemLayout, Layout,
   {
     double rotation;
 
-    ItemLayout() {}
+    ItemLayout(): rotation(0) {}
     template <class T> ItemLayout(int id, const T& item): 
       Layout(id), PositionLayout(id, item), VisibilityLayout(item),
       rotation(item.rotation) {}
@@ -299,7 +299,8 @@ struct ItemLayout: public SPoly<ItemLayout, Layout,
   {
     bool sliderVisible, sliderBoundsSet, sliderStepRel;
     double sliderMin, sliderMax, sliderStep;
-    SliderLayout(): sliderVisible(false), sliderBoundsSet(false), sliderStepRel(false) {}
+    SliderLayout(): sliderVisible(false), sliderBoundsSet(false), sliderStepRel(false),
+                    sliderMin(0), sliderMax(0), sliderStep(0) {}
     template <class T>
     SliderLayout(int id, const T& item):
       Layout(id), PositionLayout(id, item), VisibilityLayout(item), 
@@ -350,6 +351,9 @@ struct ItemLayout: public SPoly<ItemLayout, Layout,
 
     /// checks that all items are uniquely identified.
     bool validate() const;
+    /// hash of the fields that determine the model's equations,
+    /// excluding layout and commentary. Stable across runs and platforms
+    unsigned long long structuralHash() const;
   };
 
   struct Minsky
@@ -360,19 +364,29 @@ struct ItemLayout: public SPoly<ItemLayout, Layout,
     vector<shared_ptr<Layout> > layout;
     double zoomFactor;
     Minsky(): schemaVersion(-1), zoomFactor(1) {} // schemaVersion defined on read in
-    Minsky(const minsky::Group& g);
-    Minsky(const minsky::Minsky& m): Minsky(*m.model) {
+    /// if \a ids is not null, it is filled with the id assigned to
+    /// each item and group
+    Minsky(const minsky::Group& g, std::map<const minsky::Item*,int>* ids=nullptr);
+    Minsky(const minsky::Minsky& m, std::map<const minsky::Item*,int>* ids=nullptr):
+      Minsky(*m.model, ids) {
       model.rungeKutta=RungeKutta(m);
       zoomFactor=m.model->zoomFactor;
       assert(model.validate());
     }
       
     /// create a Minsky model from this
-    operator minsky::Minsky() const;
+    operator minsky::Minsky() const {minsky::Minsky m; populateMinsky(m); return m;}
+    /// populate \a m from this. If \a layoutTime is not null, the
+    /// time (in seconds) spent indexing the layout data is returned.
+    /// If \a items is not null, it is filled with the item created
+    /// for each id
+    void populateMinsky(minsky::Minsky& m, double* layoutTime=nullptr,
+                        std::map<int,minsky::ItemPtr>* items=nullptr) const;
     /// populate a group object from this. This mutates the ids in a
     /// consistent way into the free id space of the global minsky
     /// object
-    void populateGroup(minsky::Group& g) const;
+    void populateGroup(minsky::Group& g, double* layoutTime=nullptr,
+                       std::map<int,minsky::ItemPtr>* items=nullptr) const;
     /// move locations such that minx, miny lies at (0,0) on canvas
     void relocateCanvas();
 
@@ -0,0 +1,794 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "schema1Binary.h"
+#include "schema1.h"
+#include <ecolab_epilogue.h>
+#include <fstream>
+#include <type_traits>
+#include <stdint.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace schema1
+{
+  namespace
+  {
+    const char signature[8]={'M','i','n','s','k','y','B','\x1a'};
+    const uint32_t byteOrderMark=0x01020304;
+
+    struct Header
+    {
+      char signature[8];
+      uint32_t version, byteOrder;
+      uint32_t numSections, reserved;
+    };
+
+    enum SectionId: uint32_t
+      {chars, strings, ints, floats, doubles, globals, notes, wires,
+       operations, variables, plots, groups, switches, godleys, layouts};
+
+    struct Section
+    {
+      uint32_t id, recordSize;
+      uint64_t offset, count;
+    };
+
+    /// index into the string table
+    typedef uint32_t StrRef;
+    const StrRef noString=~StrRef(0);
+
+    /// contiguous run of elements in one of the pools
+    struct Range
+    {
+      uint32_t offset, count;
+    };
+
+    struct StringRec {uint64_t offset, size;};
+
+    struct GlobalsRec
+    {
+      int32_t schemaVersion, nSteps;
+      double zoomFactor, stepMin, stepMax, epsRel, epsAbs;
+      int32_t order, simulationDelay;
+      uint8_t implicit;
+    };
+
+    struct ItemRec
+    {
+      int32_t id;
+      StrRef detailedText, tooltip;
+    };
+
+    struct WireRec
+    {
+      ItemRec item;
+      int32_t from, to;
+    };
+
+    struct OperationRec
+    {
+      ItemRec item;
+      StrRef type, name;
+      int32_t intVar;
+      double value;
+      Range ports;
+      Range data; ///< (x,y) pairs in the double pool
+    };
+
+    struct VariableRec
+    {
+      ItemRec item;
+      StrRef type, init, name;
+      Range ports;
+    };
+
+    struct PlotRec
+    {
+      ItemRec item;
+      StrRef legend, title, xlabel, ylabel, y1label;
+      uint8_t logx, logy;
+      Range ports;
+    };
+
+    struct GroupRec
+    {
+      ItemRec item;
+      StrRef name;
+      Range items, ports, createdVars;
+    };
+
+    struct SwitchRec
+    {
+      ItemRec item;
+      Range ports;
+    };
+
+    struct GodleyRec
+    {
+      ItemRec item;
+      StrRef name;
+      uint8_t doubleEntryCompliant;
+      double zoomFactor;
+      Range ports;
+      Range rows;  ///< row lengths, in the int pool
+      Range cells; ///< cell strings, row by row, in the int pool
+      Range assetClasses; ///< asset class names, in the int pool
+    };
+
+    /// which parts of the layout hierarchy a layout record holds
+    enum LayoutPart
+      {positionPart=1, visibilityPart=2, itemPart=4, sizePart=8,
+       groupPart=16, sliderPart=32, wirePart=64};
+
+    struct LayoutRec
+    {
+      int32_t id;
+      uint32_t parts;
+      double x, y, rotation, width, height, displayZoom;
+      double sliderMin, sliderMax, sliderStep;
+      Range coords;
+      uint8_t visible, sliderVisible, sliderBoundsSet, sliderStepRel;
+    };
+
+    /// zero filled record, so padding bytes are deterministic
+    template <class T> T record()
+    {
+      static_assert(std::is_trivially_copyable<T>::value, "records must be POD");
+      T r;
+      memset(&r,0,sizeof(r));
+      return r;
+    }
+
+    class Writer
+    {
+      map<string,StrRef> stringIds;
+      vector<StringRec> stringRecs;
+      string charPool;
+      vector<int32_t> intPool;
+      vector<float> floatPool;
+      vector<double> doublePool;
+
+      struct SectionData
+      {
+        Section section;
+        const void* data;
+      };
+      vector<SectionData> sections;
+
+      void addSection(SectionId id, size_t recordSize, size_t count,
+                      const void* data)
+      {
+        auto s=record<Section>();
+        s.id=id;
+        s.recordSize=recordSize;
+        s.count=count;
+        sections.push_back(SectionData{s, data});
+      }
+      template <class T> void addSection(SectionId id, const vector<T>& x)
+      {addSection(id, sizeof(T), x.size(), x.data());}
+
+    public:
+      vector<GlobalsRec> globalsRecs;
+      vector<ItemRec> noteRecs;
+      vector<WireRec> wireRecs;
+      vector<OperationRec> operationRecs;
+      vector<VariableRec> variableRecs;
+      vector<PlotRec> plotRecs;
+      vector<GroupRec> groupRecs;
+      vector<SwitchRec> switchRecs;
+      vector<GodleyRec> godleyRecs;
+      vector<LayoutRec> layoutRecs;
+
+      StrRef str(const string& x)
+      {
+        auto i=stringIds.find(x);
+        if (i!=stringIds.end()) return i->second;
+        StrRef r=stringRecs.size();
+        stringRecs.push_back(StringRec{charPool.size(), x.size()});
+        charPool+=x;
+        stringIds.emplace(x,r);
+        return r;
+      }
+
+      template <class E> StrRef enumStr(E x)
+      {return str(classdesc::enumKey<E>(x));}
+
+      Range ints(const vector<int>& x)
+      {
+        Range r{uint32_t(intPool.size()), uint32_t(x.size())};
+        intPool.insert(intPool.end(), x.begin(), x.end());
+        return r;
+      }
+
+      Range strs(const vector<string>& x)
+      {
+        Range r{uint32_t(intPool.size()), uint32_t(x.size())};
+        for (auto& i: x) intPool.push_back(str(i));
+        return r;
+      }
+
+      template <class E> Range enumStrs(const vector<E>& x)
+      {
+        Range r{uint32_t(intPool.size()), uint32_t(x.size())};
+        for (auto i: x) intPool.push_back(enumStr(i));
+        return r;
+      }
+
+      Range floats(const vector<float>& x)
+      {
+        Range r{uint32_t(floatPool.size()), uint32_t(x.size())};
+        floatPool.insert(floatPool.end(), x.begin(), x.end());
+        return r;
+      }
+
+      Range pairs(const map<double,double>& x)
+      {
+        Range r{uint32_t(doublePool.size()/2), uint32_t(x.size())};
+        for (auto& i: x)
+          {
+            doublePool.push_back(i.first);
+            doublePool.push_back(i.second);
+          }
+        return r;
+      }
+
+      ItemRec item(const Item& x)
+      {
+        auto r=record<ItemRec>();
+        r.id=x.id;
+        r.detailedText=str(x.detailedText);
+        r.tooltip=str(x.tooltip);
+        return r;
+      }
+
+      void write(ostream& o)
+      {
+        sections.clear();
+        addSection(SectionId::chars, 1, charPool.size(), charPool.data());
+        addSection(SectionId::strings, stringRecs);
+        addSection(SectionId::ints, intPool);
+        addSection(SectionId::floats, floatPool);
+        addSection(SectionId::doubles, doublePool);
+        addSection(SectionId::globals, globalsRecs);
+        addSection(SectionId::notes, noteRecs);
+        addSection(SectionId::wires, wireRecs);
+        addSection(SectionId::operations, operationRecs);
+        addSection(SectionId::variables, variableRecs);
+        addSection(SectionId::plots, plotRecs);
+        addSection(SectionId::groups, groupRecs);
+        addSection(SectionId::switches, switchRecs);
+        addSection(SectionId::godleys, godleyRecs);
+        addSection(SectionId::layouts, layoutRecs);
+
+        auto header=record<Header>();
+        memcpy(header.signature, signature, sizeof(signature));
+        header.version=binaryVersion;
+        header.byteOrder=byteOrderMark;
+        header.numSections=sections.size();
+
+        auto align=[](uint64_t x){return (x+7)&~uint64_t(7);};
+        uint64_t offset=align(sizeof(Header)+sections.size()*sizeof(Section));
+        for (auto& s: sections)
+          {
+            s.section.offset=offset;
+            offset=align(offset+s.section.count*s.section.recordSize);
+          }
+
+        o.write((const char*)&header, sizeof(header));
+        for (auto& s: sections)
+          o.write((const char*)&s.section, sizeof(Section));
+        uint64_t pos=sizeof(Header)+sections.size()*sizeof(Section);
+        static const char zeros[8]={};
+        for (auto& s: sections)
+          {
+            o.write(zeros, s.section.offset-pos);
+            uint64_t size=s.section.count*s.section.recordSize;
+            o.write((const char*)s.data, size);
+            pos=s.section.offset+size;
+          }
+        o.write(zeros, align(pos)-pos);
+      }
+    };
+
+    /// read only view of a file's contents
+    class MappedFile
+    {
+      const char* m_data=nullptr;
+      size_t m_size=0;
+#ifdef _WIN32
+      vector<double> buffer; // double ensures alignment of the records
+#endif
+    public:
+      MappedFile(const string& fileName)
+      {
+#ifdef _WIN32
+        ifstream f(fileName, ios::binary);
+        if (!f)
+          throw ecolab::error("cannot open %s",fileName.c_str());
+        f.seekg(0, ios::end);
+        m_size=f.tellg();
+        f.seekg(0);
+        buffer.resize((m_size+sizeof(double)-1)/sizeof(double));
+        f.read((char*)buffer.data(), m_size);
+        m_data=(const char*)buffer.data();
+#else
+        int fd=open(fileName.c_str(), O_RDONLY);
+        if (fd<0)
+          throw ecolab::error("cannot open %s",fileName.c_str());
+        struct stat st;
+        if (fstat(fd,&st)==0 && st.st_size>0)
+          {
+            void* p=mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p!=MAP_FAILED)
+              {
+                m_data=(const char*)p;
+                m_size=st.st_size;
+              }
+          }
+        close(fd);
+#endif
+      }
+      ~MappedFile()
+      {
+#ifndef _WIN32
+        if (m_data) munmap((void*)m_data, m_size);
+#endif
+      }
+      MappedFile(const MappedFile&)=delete;
+      void operator=(const MappedFile&)=delete;
+      const char* data() const {return m_data;}
+      size_t size() const {return m_size;}
+    };
+
+    template <class T> struct Array
+    {
+      const T* data;
+      size_t size;
+      const T* begin() const {return data;}
+      const T* end() const {return data+size;}
+    };
+
+    class Reader
+    {
+      const MappedFile& file;
+      Array<char> charPool;
+      Array<StringRec> stringRecs;
+      Array<int32_t> intPool;
+      Array<float> floatPool;
+      Array<double> doublePool;
+
+      [[noreturn]] void corrupt() const
+      {throw ecolab::error("corrupt binary model file");}
+
+      template <class T> Array<T> range(const Array<T>& pool, Range r,
+                                        size_t stride=1) const
+      {
+        if ((uint64_t(r.offset)+r.count)*stride>pool.size) corrupt();
+        return Array<T>{pool.data+r.offset*stride, r.count*stride};
+      }
+
+    public:
+      Reader(const MappedFile& file): file(file)
+      {
+        if (file.size()<sizeof(Header)) corrupt();
+        auto& header=*(const Header*)file.data();
+        if (memcmp(header.signature, signature, sizeof(signature))!=0)
+          throw ecolab::error("not a binary Minsky model");
+        if (header.byteOrder!=byteOrderMark)
+          throw ecolab::error("binary model written on a machine of different byte order");
+        if (header.version>binaryVersion)
+          throw ecolab::error("binary model version %d is newer than supported (%d)",
+                              int(header.version), int(binaryVersion));
+        if (sizeof(Header)+uint64_t(header.numSections)*sizeof(Section)>file.size())
+          corrupt();
+        charPool=section<char>(SectionId::chars);
+        stringRecs=section<StringRec>(SectionId::strings);
+        intPool=section<int32_t>(SectionId::ints);
+        floatPool=section<float>(SectionId::floats);
+        doublePool=section<double>(SectionId::doubles);
+      }
+
+      /// records of section \a id. A missing section is empty
+      template <class T> Array<T> section(SectionId id) const
+      {
+        auto& header=*(const Header*)file.data();
+        auto sections=(const Section*)(file.data()+sizeof(Header));
+        for (unsigned i=0; i<header.numSections; ++i)
+          if (sections[i].id==id)
+            {
+              auto& s=sections[i];
+              if (s.recordSize!=sizeof(T) || s.offset%alignof(T)!=0 ||
+                  s.offset>file.size() || s.count>(file.size()-s.offset)/sizeof(T))
+                corrupt();
+              return Array<T>{(const T*)(file.data()+s.offset), s.count};
+            }
+        return Array<T>();
+      }
+
+      string str(StrRef i) const
+      {
+        if (i>=stringRecs.size) corrupt();
+        auto& s=stringRecs.data[i];
+        if (s.offset>charPool.size || s.size>charPool.size-s.offset) corrupt();
+        return string(charPool.data+s.offset, s.size);
+      }
+
+      template <class E> E enumStr(StrRef i) const
+      {return E(classdesc::enumKey<E>(str(i).c_str()));}
+
+      vector<int> ints(Range r) const
+      {
+        auto a=range(intPool, r);
+        return vector<int>(a.begin(), a.end());
+      }
+
+      vector<string> strs(Range r) const
+      {
+        vector<string> x;
+        for (auto i: range(intPool, r)) x.push_back(str(i));
+        return x;
+      }
+
+      template <class E> vector<E> enumStrs(Range r) const
+      {
+        vector<E> x;
+        for (auto i: range(intPool, r)) x.push_back(enumStr<E>(i));
+        return x;
+      }
+
+      vector<float> floats(Range r) const
+      {
+        auto a=range(floatPool, r);
+        return vector<float>(a.begin(), a.end());
+      }
+
+      map<double,double> pairs(Range r) const
+      {
+        map<double,double> x;
+        auto a=range(doublePool, r, 2);
+        for (size_t i=0; i<a.size; i+=2)
+          x.emplace_hint(x.end(), a.data[i], a.data[i+1]);
+        return x;
+      }
+
+      void item(Item& x, const ItemRec& r) const
+      {
+        x.id=r.id;
+        x.detailedText=str(r.detailedText);
+        x.tooltip=str(r.tooltip);
+      }
+    };
+  }
+
+  bool isBinaryFileName(const string& fileName)
+  {
+    static const string ext=".mkyb";
+    return fileName.size()>=ext.size() &&
+      fileName.compare(fileName.size()-ext.size(), ext.size(), ext)==0;
+  }
+
+  bool isBinaryModel(const string& fileName)
+  {
+    ifstream f(fileName, ios::binary);
+    char buf[sizeof(signature)];
+    return f.read(buf, sizeof(buf)) && memcmp(buf, signature, sizeof(buf))==0;
+  }
+
+  void saveBinary(const Minsky& m, const string& fileName)
+  {
+    Writer w;
+    auto g=record<GlobalsRec>();
+    g.schemaVersion=m.schemaVersion;
+    g.zoomFactor=m.zoomFactor;
+    auto& rk=m.model.rungeKutta;
+    g.stepMin=rk.stepMin; g.stepMax=rk.stepMax; g.nSteps=rk.nSteps;
+    g.epsRel=rk.epsRel; g.epsAbs=rk.epsAbs; g.order=rk.order;
+    g.implicit=rk.implicit; g.simulationDelay=rk.simulationDelay;
+    w.globalsRecs.push_back(g);
+
+    for (auto& i: m.model.notes)
+      w.noteRecs.push_back(w.item(i));
+
+    for (auto& i: m.model.wires)
+      {
+        auto r=record<WireRec>();
+        r.item=w.item(i);
+        r.from=i.from; r.to=i.to;
+        w.wireRecs.push_back(r);
+      }
+
+    for (auto& i: m.model.operations)
+      {
+        auto r=record<OperationRec>();
+        r.item=w.item(i);
+        r.type=w.enumStr(i.type);
+        r.name=w.str(i.name);
+        r.intVar=i.intVar;
+        r.value=i.value;
+        r.ports=w.ints(i.ports);
+        r.data=w.pairs(i.data);
+        w.operationRecs.push_back(r);
+      }
+
+    for (auto& i: m.model.variables)
+      {
+        auto r=record<VariableRec>();
+        r.item=w.item(i);
+        r.type=w.enumStr(i.type);
+        r.init=w.str(i.init);
+        r.name=w.str(i.name);
+        r.ports=w.ints(i.ports);
+        w.variableRecs.push_back(r);
+      }
+
+    for (auto& i: m.model.plots)
+      {
+        auto r=record<PlotRec>();
+        r.item=w.item(i);
+        r.legend=i.legend? w.enumStr(*i.legend): noString;
+        r.title=w.str(i.title); r.xlabel=w.str(i.xlabel);
+        r.ylabel=w.str(i.ylabel); r.y1label=w.str(i.y1label);
+        r.logx=i.logx; r.logy=i.logy;
+        r.ports=w.ints(i.ports);
+        w.plotRecs.push_back(r);
+      }
+
+    for (auto& i: m.model.groups)
+      {
+        auto r=record<GroupRec>();
+        r.item=w.item(i);
+        r.name=w.str(i.name);
+        r.items=w.ints(i.items);
+        r.ports=w.ints(i.ports);
+        r.createdVars=w.ints(i.createdVars);
+        w.groupRecs.push_back(r);
+      }
+
+    for (auto& i: m.model.switches)
+      {
+        auto r=record<SwitchRec>();
+        r.item=w.item(i);
+        r.ports=w.ints(i.ports);
+        w.switchRecs.push_back(r);
+      }
+
+    for (auto& i: m.model.godleys)
+      {
+        auto r=record<GodleyRec>();
+        r.item=w.item(i);
+        r.name=w.str(i.name);
+        r.doubleEntryCompliant=i.doubleEntryCompliant;
+        r.zoomFactor=i.zoomFactor;
+        r.ports=w.ints(i.ports);
+        vector<int> rowLengths;
+        for (auto& row: i.data) rowLengths.push_back(row.size());
+        r.rows=w.ints(rowLengths);
+        r.cells.offset=r.rows.offset+r.rows.count;
+        for (auto& row: i.data)
+          r.cells.count+=w.strs(row).count;
+        r.assetClasses=w.enumStrs(i.assetClasses);
+        w.godleyRecs.push_back(r);
+      }
+
+    for (auto& i: m.layout)
+      {
+        auto r=record<LayoutRec>();
+        r.id=i->id;
+        if (auto l=dynamic_cast<const PositionLayout*>(i.get()))
+          {
+            r.parts|=positionPart;
+            r.x=l->x; r.y=l->y;
+          }
+        if (auto l=dynamic_cast<const VisibilityLayout*>(i.get()))
+          {
+            r.parts|=visibilityPart;
+            r.visible=l->visible;
+          }
+        if (auto l=dynamic_cast<const ItemLayout*>(i.get()))
+          {
+            r.parts|=itemPart;
+            r.rotation=l->rotation;
+          }
+        if (auto l=dynamic_cast<const SizeLayout*>(i.get()))
+          {
+            r.parts|=sizePart;
+            r.width=l->width; r.height=l->height;
+          }
+        if (auto l=dynamic_cast<const GroupLayout*>(i.get()))
+          {
+            r.parts|=groupPart;
+            r.displayZoom=l->displayZoom;
+          }
+        if (auto l=dynamic_cast<const SliderLayout*>(i.get()))
+          {
+            r.parts|=sliderPart;
+            r.sliderVisible=l->sliderVisible;
+            r.sliderBoundsSet=l->sliderBoundsSet;
+            r.sliderStepRel=l->sliderStepRel;
+            r.sliderMin=l->sliderMin; r.sliderMax=l->sliderMax;
+            r.sliderStep=l->sliderStep;
+          }
+        if (auto l=dynamic_cast<const WireLayout*>(i.get()))
+          {
+            r.parts|=wirePart;
+            r.coords=w.floats(l->coords);
+          }
+        w.layoutRecs.push_back(r);
+      }
+
+    ofstream o(fileName, ios::binary);
+    w.write(o);
+    if (!o)
+      throw ecolab::error("cannot save to %s",fileName.c_str());
+  }
+
+  void loadBinary(const string& fileName, Minsky& m)
+  {
+    MappedFile file(fileName);
+    Reader r(file);
+    m=Minsky();
+
+    auto g=r.section<GlobalsRec>(SectionId::globals);
+    if (g.size!=1)
+      throw ecolab::error("corrupt binary model file");
+    m.schemaVersion=g.data->schemaVersion;
+    m.zoomFactor=g.data->zoomFactor;
+    auto& rk=m.model.rungeKutta;
+    rk.stepMin=g.data->stepMin; rk.stepMax=g.data->stepMax;
+    rk.nSteps=g.data->nSteps; rk.epsRel=g.data->epsRel;
+    rk.epsAbs=g.data->epsAbs; rk.order=g.data->order;
+    rk.implicit=g.data->implicit; rk.simulationDelay=g.data->simulationDelay;
+
+    auto notes=r.section<ItemRec>(SectionId::notes);
+    m.model.notes.resize(notes.size);
+    for (size_t i=0; i<notes.size; ++i)
+      r.item(m.model.notes[i], notes.data[i]);
+
+    auto wires=r.section<WireRec>(SectionId::wires);
+    m.model.wires.resize(wires.size);
+    for (size_t i=0; i<wires.size; ++i)
+      {
+        auto& x=m.model.wires[i];
+        auto& w=wires.data[i];
+        r.item(x, w.item);
+        x.from=w.from; x.to=w.to;
+      }
+
+    auto ops=r.section<OperationRec>(SectionId::operations);
+    m.model.operations.resize(ops.size);
+    for (size_t i=0; i<ops.size; ++i)
+      {
+        auto& x=m.model.operations[i];
+        auto& o=ops.data[i];
+        r.item(x, o.item);
+        x.type=r.enumStr<minsky::OperationType::Type>(o.type);
+        x.name=r.str(o.name);
+        x.intVar=o.intVar;
+        x.value=o.value;
+        x.ports=r.ints(o.ports);
+        x.data=r.pairs(o.data);
+      }
+
+    auto vars=r.section<VariableRec>(SectionId::variables);
+    m.model.variables.resize(vars.size);
+    for (size_t i=0; i<vars.size; ++i)
+      {
+        auto& x=m.model.variables[i];
+        auto& v=vars.data[i];
+        r.item(x, v.item);
+        x.type=r.enumStr<VariableType::Type>(v.type);
+        x.init=r.str(v.init);
+        x.name=r.str(v.name);
+        x.ports=r.ints(v.ports);
+      }
+
+    auto plots=r.section<PlotRec>(SectionId::plots);
+    m.model.plots.resize(plots.size);
+    for (size_t i=0; i<plots.size; ++i)
+      {
+        auto& x=m.model.plots[i];
+        auto& p=plots.data[i];
+        r.item(x, p.item);
+        if (p.legend!=noString)
+          x.legend.reset(new Plot::Side(r.enumStr<Plot::Side>(p.legend)));
+        x.title=r.str(p.title); x.xlabel=r.str(p.xlabel);
+        x.ylabel=r.str(p.ylabel); x.y1label=r.str(p.y1label);
+        x.logx=p.logx; x.logy=p.logy;
+        x.ports=r.ints(p.ports);
+      }
+
+    auto groups=r.section<GroupRec>(SectionId::groups);
+    m.model.groups.resize(groups.size);
+    for (size_t i=0; i<groups.size; ++i)
+      {
+        auto& x=m.model.groups[i];
+        auto& gr=groups.data[i];
+        r.item(x, gr.item);
+        x.name=r.str(gr.name);
+        x.items=r.ints(gr.items);
+        x.ports=r.ints(gr.ports);
+        x.createdVars=r.ints(gr.createdVars);
+      }
+
+    auto switches=r.section<SwitchRec>(SectionId::switches);
+    m.model.switches.resize(switches.size);
+    for (size_t i=0; i<switches.size; ++i)
+      {
+        r.item(m.model.switches[i], switches.data[i].item);
+        m.model.switches[i].ports=r.ints(switches.data[i].ports);
+      }
+
+    auto godleys=r.section<GodleyRec>(SectionId::godleys);
+    m.model.godleys.resize(godleys.size);
+    for (size_t i=0; i<godleys.size; ++i)
+      {
+        auto& x=m.model.godleys[i];
+        auto& gd=godleys.data[i];
+        r.item(x, gd.item);
+        x.name=r.str(gd.name);
+        x.doubleEntryCompliant=gd.doubleEntryCompliant;
+        x.zoomFactor=gd.zoomFactor;
+        x.ports=r.ints(gd.ports);
+        auto cells=r.strs(gd.cells);
+        size_t cell=0;
+        for (auto n: r.ints(gd.rows))
+          {
+            if (n<0 || cell+n>cells.size())
+              throw ecolab::error("corrupt binary model file");
+            x.data.emplace_back(cells.begin()+cell, cells.begin()+cell+n);
+            cell+=n;
+          }
+        x.assetClasses=r.enumStrs<minsky::GodleyTable::AssetClass>(gd.assetClasses);
+      }
+
+    auto layouts=r.section<LayoutRec>(SectionId::layouts);
+    m.layout.reserve(layouts.size);
+    for (auto& l: layouts)
+      {
+        auto u=new UnionLayout;
+        m.layout.emplace_back(u);
+        u->id=l.id;
+        if (l.parts&positionPart)
+          {u->x=l.x; u->y=l.y;}
+        if (l.parts&visibilityPart)
+          u->visible=l.visible;
+        if (l.parts&itemPart)
+          u->rotation=l.rotation;
+        if (l.parts&sizePart)
+          {u->width=l.width; u->height=l.height;}
+        if (l.parts&groupPart)
+          u->displayZoom=l.displayZoom;
+        if (l.parts&sliderPart)
+          {
+            u->sliderVisible=l.sliderVisible;
+            u->sliderBoundsSet=l.sliderBoundsSet;
+            u->sliderStepRel=l.sliderStepRel;
+            u->sliderMin=l.sliderMin; u->sliderMax=l.sliderMax;
+            u->sliderStep=l.sliderStep;
+          }
+        if (l.parts&wirePart)
+          u->coords=r.floats(l.coords);
+      }
+  }
+}
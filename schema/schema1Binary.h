@@ -0,0 +1,59 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   @file Binary container for schema 1 models.
+
+   The file consists of a fixed header, a table of sections, and the
+   sections themselves, each an 8 byte aligned array of fixed size
+   records. Items, wires, groups, Godley tables, layouts and
+   operation data each have their own section. Variable length fields
+   (port lists, Godley cells, wire coordinates, data points) are
+   ranges into shared int, float and double pools, and every string
+   is stored once in a string table, and referred to by index. A
+   reader can therefore map the file and use the records in place.
+
+   Enumerated types are stored by name, so files remain readable
+   when enumerations are extended.
+*/
+#ifndef SCHEMA1BINARY_H
+#define SCHEMA1BINARY_H
+#include <string>
+
+namespace schema1
+{
+  struct Minsky;
+
+  /// current version of the binary container
+  static const unsigned binaryVersion=1;
+
+  /// true if \a fileName's extension selects the binary format (.mkyb)
+  bool isBinaryFileName(const std::string& fileName);
+  /// true if \a fileName starts with the binary model signature
+  bool isBinaryModel(const std::string& fileName);
+
+  /// write \a m to \a fileName in the binary format
+  /// @throw ecolab::error if the file cannot be written
+  void saveBinary(const Minsky& m, const std::string& fileName);
+  /// read \a fileName in the binary format into \a m
+  /// @throw ecolab::error if the file is not a valid binary model
+  void loadBinary(const std::string& fileName, Minsky& m);
+}
+
+#endif
@@ -0,0 +1,374 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "schema1Stream.h"
+#include "schema1.h"
+#include <ecolab_epilogue.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace schema1
+{
+  namespace
+  {
+    int toInt(const string& x) {return strtol(x.c_str(),nullptr,10);}
+    double toDouble(const string& x) {return strtod(x.c_str(),nullptr);}
+    bool toBool(const string& x) {return x=="true" || x=="1";}
+    template <class E> E toEnum(const string& x)
+    {return E(classdesc::enumKey<E>(x.c_str()));}
+
+    /// append unicode code point \a c to \a s in UTF-8
+    void appendUTF8(string& s, unsigned long c)
+    {
+      if (c<0x80)
+        s+=char(c);
+      else if (c<0x800)
+        {
+          s+=char(0xC0|(c>>6));
+          s+=char(0x80|(c&0x3F));
+        }
+      else if (c<0x10000)
+        {
+          s+=char(0xE0|(c>>12));
+          s+=char(0x80|((c>>6)&0x3F));
+          s+=char(0x80|(c&0x3F));
+        }
+      else
+        {
+          s+=char(0xF0|(c>>18));
+          s+=char(0x80|((c>>12)&0x3F));
+          s+=char(0x80|((c>>6)&0x3F));
+          s+=char(0x80|(c&0x3F));
+        }
+    }
+
+    /// assigns elements to a schema1::Minsky as they are closed,
+    /// according to their position in the document. Fields added to
+    /// schema1 need adding here, and to the streamUnpackEveryField test
+    class Builder
+    {
+      Minsky& m;
+      vector<string> path;
+      // records currently being read
+      Item* item=nullptr;
+      Wire* wire=nullptr;
+      Operation* op=nullptr;
+      Variable* var=nullptr;
+      Plot* plot=nullptr;
+      Group* group=nullptr;
+      Switch* sw=nullptr;
+      Godley* godley=nullptr;
+      UnionLayout* layout=nullptr;
+      double pairFirst=0;
+
+      template <class T>
+      T* newItem(vector<T>& v)
+      {
+        v.emplace_back();
+        item=&v.back();
+        return &v.back();
+      }
+
+      bool inModel(size_t depth) const
+      {return path.size()==depth && path[0]=="Minsky" && path[1]=="model";}
+
+      void itemField(const string& name, const string& text);
+      void listElement(const string& list, const string& text);
+      void layoutField(const string& name, const string& text);
+      void rungeKuttaField(const string& name, const string& text);
+    public:
+      Builder(Minsky& m): m(m) {}
+      void start(const string& name);
+      void end(const string& name, const string& text);
+      bool complete() const {return path.empty();}
+    };
+
+    void Builder::start(const string& name)
+    {
+      path.push_back(name);
+      if (inModel(4))
+        {
+          item=nullptr; wire=nullptr; op=nullptr; var=nullptr;
+          plot=nullptr; group=nullptr; sw=nullptr; godley=nullptr;
+          const string& list=path[2];
+          if (list=="wires") wire=newItem(m.model.wires);
+          else if (list=="notes") newItem(m.model.notes);
+          else if (list=="operations") op=newItem(m.model.operations);
+          else if (list=="variables") var=newItem(m.model.variables);
+          else if (list=="plots") plot=newItem(m.model.plots);
+          else if (list=="groups") group=newItem(m.model.groups);
+          else if (list=="switches") sw=newItem(m.model.switches);
+          else if (list=="godleys") godley=newItem(m.model.godleys);
+        }
+      else if (path.size()==3 && path[1]=="layout")
+        {
+          layout=new UnionLayout;
+          m.layout.emplace_back(layout);
+        }
+      else if (godley && inModel(6) && path[4]=="data")
+        godley->data.emplace_back();
+    }
+
+    void Builder::end(const string& name, const string& text)
+    {
+      if (path.empty() || path.back()!=name)
+        throw ecolab::error("mismatched closing tag </%s>",name.c_str());
+      if (path.size()==2 && path[0]=="Minsky")
+        {
+          if (name=="schemaVersion") m.schemaVersion=toInt(text);
+          else if (name=="zoomFactor") m.zoomFactor=toDouble(text);
+        }
+      else if (inModel(4) && path[2]=="rungeKutta")
+        rungeKuttaField(name, text);
+      else if (inModel(5) && item)
+        itemField(name, text);
+      else if (inModel(6) && item)
+        listElement(path[4], text);
+      else if (inModel(7) && op && path[4]=="data")
+        {
+          if (name=="first") pairFirst=toDouble(text);
+          else if (name=="second") op->data[pairFirst]=toDouble(text);
+        }
+      else if (inModel(7) && godley && path[4]=="data" && !godley->data.empty())
+        godley->data.back().push_back(text);
+      else if (path.size()==4 && path[1]=="layout" && layout)
+        layoutField(name, text);
+      else if (path.size()==5 && path[1]=="layout" && layout && path[3]=="coords")
+        layout->coords.push_back(toDouble(text));
+      path.pop_back();
+    }
+
+    void Builder::itemField(const string& name, const string& text)
+    {
+      if (name=="id") item->id=toInt(text);
+      else if (name=="detailedText") item->detailedText=text;
+      else if (name=="tooltip") item->tooltip=text;
+      else if (wire)
+        {
+          if (name=="from") wire->from=toInt(text);
+          else if (name=="to") wire->to=toInt(text);
+        }
+      else if (op)
+        {
+          if (name=="type") op->type=toEnum<minsky::OperationType::Type>(text);
+          else if (name=="value") op->value=toDouble(text);
+          else if (name=="name") op->name=text;
+          else if (name=="intVar") op->intVar=toInt(text);
+        }
+      else if (var)
+        {
+          if (name=="type") var->type=toEnum<VariableType::Type>(text);
+          else if (name=="init") var->init=text;
+          else if (name=="name") var->name=text;
+        }
+      else if (plot)
+        {
+          if (name=="legend") plot->legend.reset(new Plot::Side(toEnum<Plot::Side>(text)));
+          else if (name=="logx") plot->logx=toBool(text);
+          else if (name=="logy") plot->logy=toBool(text);
+          else if (name=="title") plot->title=text;
+          else if (name=="xlabel") plot->xlabel=text;
+          else if (name=="ylabel") plot->ylabel=text;
+          else if (name=="y1label") plot->y1label=text;
+        }
+      else if (group)
+        {
+          if (name=="name") group->name=text;
+        }
+      else if (godley)
+        {
+          if (name=="doubleEntryCompliant") godley->doubleEntryCompliant=toBool(text);
+          else if (name=="name") godley->name=text;
+          else if (name=="zoomFactor") godley->zoomFactor=toDouble(text);
+        }
+    }
+
+    void Builder::listElement(const string& list, const string& text)
+    {
+      if (list=="ports")
+        {
+          int port=toInt(text);
+          if (op) op->ports.push_back(port);
+          else if (var) var->ports.push_back(port);
+          else if (plot) plot->ports.push_back(port);
+          else if (group) group->ports.push_back(port);
+          else if (sw) sw->ports.push_back(port);
+          else if (godley) godley->ports.push_back(port);
+        }
+      else if (group && list=="items")
+        group->items.push_back(toInt(text));
+      else if (group && list=="createdVars")
+        group->createdVars.push_back(toInt(text));
+      else if (godley && list=="assetClasses")
+        godley->assetClasses.push_back
+          (toEnum<minsky::GodleyTable::AssetClass>(text));
+    }
+
+    void Builder::layoutField(const string& name, const string& text)
+    {
+      if (name=="id") layout->id=toInt(text);
+      else if (name=="x") layout->x=toDouble(text);
+      else if (name=="y") layout->y=toDouble(text);
+      else if (name=="visible") layout->visible=toBool(text);
+      else if (name=="rotation") layout->rotation=toDouble(text);
+      else if (name=="width") layout->width=toDouble(text);
+      else if (name=="height") layout->height=toDouble(text);
+      else if (name=="displayZoom") layout->displayZoom=toDouble(text);
+      else if (name=="sliderVisible") layout->sliderVisible=toBool(text);
+      else if (name=="sliderBoundsSet") layout->sliderBoundsSet=toBool(text);
+      else if (name=="sliderStepRel") layout->sliderStepRel=toBool(text);
+      else if (name=="sliderMin") layout->sliderMin=toDouble(text);
+      else if (name=="sliderMax") layout->sliderMax=toDouble(text);
+      else if (name=="sliderStep") layout->sliderStep=toDouble(text);
+    }
+
+    void Builder::rungeKuttaField(const string& name, const string& text)
+    {
+      auto& rk=m.model.rungeKutta;
+      if (name=="stepMin") rk.stepMin=toDouble(text);
+      else if (name=="stepMax") rk.stepMax=toDouble(text);
+      else if (name=="nSteps") rk.nSteps=toInt(text);
+      else if (name=="epsRel") rk.epsRel=toDouble(text);
+      else if (name=="epsAbs") rk.epsAbs=toDouble(text);
+      else if (name=="order") rk.order=toInt(text);
+      else if (name=="implicit") rk.implicit=toBool(text);
+      else if (name=="simulationDelay") rk.simulationDelay=toInt(text);
+    }
+
+    /// buffered character source
+    class Reader
+    {
+      istream& in;
+      char buf[65536];
+      size_t pos=0, end=0;
+    public:
+      Reader(istream& in): in(in) {}
+      int get() {
+        if (pos==end)
+          {
+            in.read(buf,sizeof(buf));
+            end=in.gcount();
+            pos=0;
+            if (end==0) return EOF;
+          }
+        return (unsigned char)buf[pos++];
+      }
+      int getOrThrow() {
+        int c=get();
+        if (c==EOF) throw ecolab::error("unexpected end of XML document");
+        return c;
+      }
+      /// skip input up to and including \a terminator, appending
+      /// the text preceding it to \a skipped
+      void skipPast(const char* terminator, string* skipped=nullptr)
+      {
+        string tail;
+        size_t n=strlen(terminator);
+        while (tail.size()<n || tail.compare(tail.size()-n,n,terminator)!=0)
+          tail+=char(getOrThrow());
+        if (skipped) skipped->append(tail, 0, tail.size()-n);
+      }
+    };
+
+    void appendEntity(Reader& r, string& text)
+    {
+      string entity;
+      for (int c=r.getOrThrow(); c!=';'; c=r.getOrThrow())
+        entity+=char(c);
+      if (entity=="lt") text+='<';
+      else if (entity=="gt") text+='>';
+      else if (entity=="amp") text+='&';
+      else if (entity=="quot") text+='"';
+      else if (entity=="apos") text+='\'';
+      else if (entity.size()>1 && entity[0]=='#')
+        appendUTF8(text, entity[1]=='x'? strtoul(entity.c_str()+2,nullptr,16):
+                   strtoul(entity.c_str()+1,nullptr,10));
+      else
+        throw ecolab::error("unknown XML entity &%s;",entity.c_str());
+    }
+  }
+
+  void streamUnpack(std::istream& in, Minsky& m)
+  {
+    Reader r(in);
+    Builder builder(m);
+    string text, name;
+    bool started=false;
+    for (int c=r.get(); c!=EOF; c=r.get())
+      if (c=='<')
+        {
+          c=r.getOrThrow();
+          if (c=='?')
+            r.skipPast("?>");
+          else if (c=='!')
+            switch (r.getOrThrow())
+              {
+              case '-': // comment
+                r.skipPast("-->");
+                break;
+              case '[': // CDATA section
+                r.skipPast("CDATA[");
+                r.skipPast("]]>",&text);
+                break;
+              default: // DOCTYPE etc
+                r.skipPast(">");
+                break;
+              }
+          else if (c=='/')
+            {
+              name.clear();
+              while ((c=r.getOrThrow())!='>')
+                if (!isspace(c)) name+=char(c);
+              builder.end(name, text);
+              text.clear();
+            }
+          else
+            {
+              name.clear();
+              for (; !isspace(c) && c!='/' && c!='>'; c=r.getOrThrow())
+                name+=char(c);
+              // skip attributes
+              char quote=0, last=0;
+              for (; quote || c!='>'; last=c, c=r.getOrThrow())
+                if (quote)
+                  {
+                    if (c==quote) quote=0;
+                  }
+                else if (c=='"' || c=='\'')
+                  quote=c;
+              builder.start(name);
+              started=true;
+              text.clear();
+              if (last=='/')
+                builder.end(name, text);
+            }
+        }
+      else if (c=='&')
+        appendEntity(r, text);
+      // as with xml_unpack, whitespace is only significant when
+      // represented by character entities
+      else if (!isspace(c))
+        text+=char(c);
+
+    if (!started || !builder.complete())
+      throw ecolab::error("unexpected end of XML document");
+  }
+}
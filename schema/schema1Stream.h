@@ -0,0 +1,38 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCHEMA1STREAM_H
+#define SCHEMA1STREAM_H
+#include <istream>
+
+namespace schema1
+{
+  struct Minsky;
+
+  /**
+     Read a schema 1 XML document from \a in into \a m, equivalent to
+     xml_unpack, but assigning each element to \a m as it is read,
+     rather than first building an index of the whole document.
+     Unrecognised elements are ignored.
+     @throw ecolab::error if the document is malformed
+  */
+  void streamUnpack(std::istream& in, Minsky& m);
+}
+
+#endif
@@ -98,6 +98,7 @@ namespace minsky
      const vector<GodleyTable::AssetClass>& assetClass)
     {
       g.data=data;
+      g.invalidateParsed();
       g.m_assetClass=assetClass;
     }
 //
@@ -0,0 +1,72 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// microbenchmark of evaluating the derivatives of a model dominated
+// by a large Godley table
+#include "minsky.h"
+#include "ecolab_epilogue.h"
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+using namespace minsky;
+using namespace std;
+
+int main(int argc, const char*argv[])
+{
+  unsigned rows=argc>1? atoi(argv[1]): 1000;
+  unsigned cols=argc>2? atoi(argv[2]): 200;
+  unsigned reps=argc>3? atoi(argv[3]): 1000;
+  // number of columns each flow appears in
+  const unsigned entriesPerRow=4;
+
+  Minsky m;
+  LocalMinsky lm(m);
+  auto gi=new GodleyIcon;
+  m.model->addItem(gi);
+  GodleyTable& godley=gi->table;
+  godley.resize(rows+2, cols+1);
+  for (unsigned c=1; c<=cols; ++c)
+    godley.cell(0,c)="s"+str(c);
+  for (unsigned r=2; r<rows+2; ++r)
+    for (unsigned k=0; k<entriesPerRow; ++k)
+      godley.cell(r, 1+(r*7+k*13)%cols)=str(k+1)+"f"+str(r);
+  gi->update();
+  for (auto& v: m.variableValues)
+    if (v.second.isFlowVar())
+      v.second.init="0.1";
+
+  auto start=chrono::steady_clock::now();
+  m.reset();
+  double resetTime=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+  vector<double> result(m.stockVars.size());
+  start=chrono::steady_clock::now();
+  for (unsigned i=0; i<reps; ++i)
+    m.evalEquations(&result[0], 0, &m.stockVars[0]);
+  double evalTime=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+  double checksum=0;
+  for (double x: result) checksum+=x;
+  cout<<rows<<"x"<<cols<<" table, "<<rows*entriesPerRow<<" entries"<<endl;
+  cout<<"reset: "<<resetTime*1e3<<"ms"<<endl;
+  cout<<"evalEquations: "<<evalTime/reps*1e6<<"us per call, "
+      <<evalTime/reps/(rows*entriesPerRow)*1e9<<"ns per entry"<<endl;
+  cout<<"checksum: "<<checksum<<endl;
+  return 0;
+}
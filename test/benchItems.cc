@@ -0,0 +1,84 @@
+/*
+  @copyright Steve Keen 2017
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// microbenchmark of model-wide passes over items of one kind, using
+// the per-kind indices versus a dynamic_cast sweep of all items
+#include "minsky.h"
+#include "switchIcon.h"
+#include "ecolab_epilogue.h"
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+using namespace minsky;
+using namespace std;
+
+int main(int argc, const char*argv[])
+{
+  unsigned numItems=argc>1? atoi(argv[1]): 100000;
+  unsigned numGroups=argc>2? atoi(argv[2]): 100;
+  unsigned reps=argc>3? atoi(argv[3]): 100;
+
+  Minsky m;
+  LocalMinsky lm(m);
+  vector<GroupPtr> groups{m.model};
+  for (unsigned i=1; i<numGroups; ++i)
+    groups.push_back(m.model->addGroup(new Group));
+  for (unsigned i=0; i<numItems; ++i)
+    {
+      auto& g=groups[i%groups.size()];
+      switch (i%100)
+        {
+        case 0: g->addItem(new PlotWidget); break;
+        case 1: g->addItem(new SwitchIcon); break;
+        default:
+          if (i%2)
+            g->addItem(OperationPtr(OperationType::add));
+          else
+            g->addItem(VariablePtr(VariableType::flow, "v"+str(i)));
+          break;
+        }
+    }
+
+  size_t count=0;
+  auto start=chrono::steady_clock::now();
+  for (unsigned r=0; r<reps; ++r)
+    m.model->recursiveDo
+      (&GroupItems::items, [&](const Items&, Items::const_iterator i) {
+        if (dynamic_cast<PlotWidget*>(i->get())) count++;
+        return false;
+      });
+  double sweepTime=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+  start=chrono::steady_clock::now();
+  for (unsigned r=0; r<reps; ++r)
+    m.model->forEachOfKind
+      (&GroupItems::plots, [&](const shared_ptr<PlotWidget>&) {count++;});
+  double indexTime=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+  start=chrono::steady_clock::now();
+  m.reset();
+  double resetTime=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+  cout<<numItems<<" items in "<<numGroups<<" groups"<<endl;
+  cout<<"dynamic_cast sweep for plots: "<<sweepTime/reps*1e3<<"ms"<<endl;
+  cout<<"plot index: "<<indexTime/reps*1e3<<"ms"<<endl;
+  cout<<"reset: "<<resetTime*1e3<<"ms"<<endl;
+  cout<<"count: "<<count<<endl;
+  return 0;
+}
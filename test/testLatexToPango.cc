@@ -60,3 +60,18 @@ TEST(LaTeXToPango)
     
 }
 
+TEST(LaTeXToPangoMemoised)
+{
+  CHECK_EQUAL("<i>x<sup>y</sup>z</i>", latexToPango("x^yz"));
+  // more labels than the memo holds, so it is cleared along the way
+  for (int i=0; i<70000; ++i)
+    {
+      string n=to_string(i);
+      CHECK_EQUAL("<i>x<sub>"+n+"</sub></i>", latexToPango("x_{"+n+"}"));
+    }
+  // repeated conversions are unchanged
+  CHECK_EQUAL("<i>x<sup>y</sup>z</i>", latexToPango("x^yz"));
+  CHECK_EQUAL("<i>x<sub>0</sub></i>", latexToPango("x_{0}"));
+  CHECK_EQUAL("<i>x<sub>0</sub></i>", latexToPango("x_{0}"));
+}
+
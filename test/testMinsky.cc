@@ -17,6 +17,11 @@
   along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "minsky.h"
+#include "schema1.h"
+#include "schema1Stream.h"
+#include "schema1Binary.h"
+#include "switchIcon.h"
+#include <boost/filesystem.hpp>
 #include <ecolab_epilogue.h>
 #include <UnitTest++/UnitTest++.h>
 #include <gsl/gsl_integration.h>
@@ -31,6 +36,53 @@ namespace
     {
     }
   };
+
+  struct ClipboardFixture: public TestFixture
+  {
+    bool claimClipboard() override {return true;}
+  };
+
+  /// number of items in the index \a kind of \a g and its subgroups
+  template <class T>
+  size_t countOf(const Group& g, classdesc::Exclude<vector<shared_ptr<T> > > GroupItems::*kind)
+  {
+    size_t n=0;
+    g.forEachOfKind(kind, [&](const shared_ptr<T>&){n++;});
+    return n;
+  }
+
+  /// XML of \a m, for comparing schema objects
+  string packXML(schema1::Minsky& m)
+  {
+    ostringstream os;
+    classdesc::xml_pack_t x(os,"");
+    xml_pack(x,"Minsky",m);
+    return os.str();
+  }
+
+  /// check that streamUnpack reads \a xml as xml_unpack does
+  void checkStreamUnpack(const string& xml)
+  {
+    schema1::Minsky viaUnpack, viaStream;
+    {
+      istringstream is(xml);
+      classdesc::xml_unpack_t x(is);
+      xml_unpack(x,"Minsky",viaUnpack);
+    }
+    {
+      istringstream is(xml);
+      schema1::streamUnpack(is,viaStream);
+    }
+    CHECK_EQUAL(packXML(viaUnpack), packXML(viaStream));
+  }
+
+  /// a platform whose clipboard cannot be supplied on demand
+  struct CopyClipboardFixture: public TestFixture
+  {
+    mutable string systemClipboard;
+    void putClipboard(const string& x) const override {systemClipboard=x;}
+    string getClipboard() const override {return systemClipboard;}
+  };
 }
 
 SUITE(Minsky)
@@ -218,7 +270,18 @@ SUITE(Minsky)
       CHECK_EQUAL(-5,variableValues[":d"].value());
       CHECK_EQUAL(0,variableValues[":e"].value());
       CHECK_EQUAL(5,variableValues[":a"].value());
-    
+
+      // derivatives of Godley stocks and integrals in one pass
+      auto intOp=model->addItem(OperationBase::create(OperationType::integrate));
+      model->addWire(*model->addItem(new Variable<VariableType::flow>("a")), *intOp, 1);
+      reset();
+      auto& integral=integrals[0];
+      vector<double> result(stockVars.size(), -1);
+      evalEquations(&result[0], t, &stockVars[0]);
+      CHECK_EQUAL(5,result[variableValues[":c"].idx()]);
+      CHECK_EQUAL(-5,result[variableValues[":d"].idx()]);
+      CHECK_EQUAL(0,result[variableValues[":e"].idx()]);
+      CHECK_EQUAL(5,result[integral.stock.idx()]);
     }
 
   /*
@@ -334,6 +397,593 @@ SUITE(Minsky)
       CHECK_CLOSE(0.5*value*t*t, intOp->intVar->value(), 1e-5);
     }
 
+  TEST_FIXTURE(TestFixture,liveIcons)
+    {
+      model->addItem(new Variable<VariableType::flow>);
+      auto plot=model->addItem(new PlotWidget);
+      auto group=model->addGroup(new Group);
+      auto groupPlot=group->addItem(new PlotWidget);
+      constructEquations();
+      // only plots need updating, including those hidden in groups
+      CHECK_EQUAL(2,liveIcons.size());
+      auto isLive=[&](const ItemPtr& i) {
+        for (auto& l: liveIcons)
+          if (l.lock()==i) return true;
+        return false;
+      };
+      CHECK(isLive(plot));
+      CHECK(isLive(groupPlot));
+      // deleted icons are released, and pruned on the next update
+      group->removeItem(*groupPlot);
+      groupPlot.reset();
+      updateLiveIcons();
+      CHECK_EQUAL(1,liveIcons.size());
+      CHECK(isLive(plot));
+    }
+
+  TEST_FIXTURE(TestFixture,checkpoints)
+    {
+      auto op1=model->addItem(OperationPtr(OperationBase::constant));
+      auto op2=model->addItem(OperationPtr(OperationBase::integrate));
+      dynamic_cast<IntOp*>(op2.get())->description("output");
+      model->addWire(*op1,*op2,1,vector<float>());
+      dynamic_cast<Constant*>(op1.get())->value=10;
+      nSteps=1;
+      checkpointInterval=1;
+      maxCheckpoints=3;
+      checkpointSpillDir=".";
+      
+      while (t<10) step();
+      CHECK(numCheckpoints()>3); // older ones spilled to disk
+      double t0=checkpointTime(1);
+      restoreCheckpoint(1);
+      CHECK_EQUAL(2,numCheckpoints());
+      CHECK_EQUAL(t0,t);
+      CHECK_CLOSE(10*t, variableValues[":output"].value(), 1e-5);
+      // simulation resumes from the checkpoint
+      while (t<10) step();
+      CHECK_CLOSE(10*t, variableValues[":output"].value(), 1e-5);
+
+      reset();
+      CHECK_EQUAL(0,numCheckpoints());
+    }
+
+  TEST_FIXTURE(TestFixture,streamLoad)
+    {
+      auto op1=model->addItem(OperationPtr(OperationBase::constant));
+      auto op2=model->addItem(OperationPtr(OperationBase::integrate));
+      dynamic_cast<IntOp*>(op2.get())->description("output & more");
+      model->addWire(*op1,*op2,1,vector<float>());
+      auto& g=dynamic_cast<GodleyIcon&>(*model->addItem(new GodleyIcon));
+      g.table.dimension(3,3);
+      g.table.cell(0,1)="a";
+      g.table.cell(2,1)=" b";
+      g.update();
+      model->addItem(new PlotWidget);
+      model->addGroup(new Group)->title="a group";
+      save("streamLoad.mky");
+
+      // streamed load yields the same schema object as xml_unpack
+      schema1::Minsky viaUnpack, viaStream;
+      {
+        ifstream f("streamLoad.mky");
+        classdesc::xml_unpack_t x(f);
+        xml_unpack(x,"Minsky",viaUnpack);
+      }
+      {
+        ifstream f("streamLoad.mky");
+        schema1::streamUnpack(f,viaStream);
+      }
+      ostringstream a, b;
+      {
+        classdesc::xml_pack_t x(a,"");
+        xml_pack(x,"Minsky",viaUnpack);
+      }
+      {
+        classdesc::xml_pack_t x(b,"");
+        xml_pack(x,"Minsky",viaStream);
+      }
+      CHECK_EQUAL(a.str(), b.str());
+
+      load("streamLoad.mky");
+      CHECK(loadParseTime>0);
+      // equations are not built until needed
+      CHECK(reset_flag());
+      step();
+      CHECK(!reset_flag());
+    }
+
+  // schema1Stream's Builder assigns each field by hand, so every
+  // field is given a non default value here. Fields added to schema1
+  // must be added to both.
+  TEST(streamUnpackEveryField)
+    {
+      schema1::Minsky m;
+      m.schemaVersion=1;
+      m.zoomFactor=2.5;
+      auto& model=m.model;
+      auto describe=[](schema1::Item& i, int id) {
+        i.id=id;
+        i.detailedText="detail "+to_string(id);
+        i.tooltip="tip "+to_string(id);
+      };
+
+      schema1::Wire w;
+      describe(w,1);
+      w.from=2; w.to=3;
+      model.wires.push_back(w);
+
+      schema1::Item note;
+      describe(note,4);
+      model.notes.push_back(note);
+
+      schema1::Operation op;
+      describe(op,5);
+      op.type=OperationType::data;
+      op.value=1.5;
+      op.ports={2,3};
+      op.data={{0,1},{2,3}};
+      op.name="op";
+      op.intVar=6;
+      model.operations.push_back(op);
+
+      schema1::Variable v;
+      describe(v,6);
+      v.type=VariableType::stock;
+      v.init="3";
+      v.ports={7};
+      v.name="v";
+      model.variables.push_back(v);
+
+      schema1::Plot p;
+      describe(p,8);
+      p.ports={9};
+      p.legend.reset(new schema1::Plot::Side(schema1::Plot::Side(1)));
+      p.logx=p.logy=true;
+      p.title="title"; p.xlabel="x"; p.ylabel="y"; p.y1label="y1";
+      model.plots.push_back(p);
+
+      schema1::Group g;
+      describe(g,10);
+      g.items={5,6};
+      g.ports={11};
+      g.createdVars={6};
+      g.name="group";
+      model.groups.push_back(g);
+
+      schema1::Switch sw;
+      describe(sw,12);
+      sw.ports={13,14,15};
+      model.switches.push_back(sw);
+
+      schema1::Godley godley;
+      describe(godley,16);
+      godley.ports={17};
+      godley.doubleEntryCompliant=false;
+      godley.name="bank";
+      godley.data={{"","a & b"},{"flow","<c>"}};
+      godley.assetClasses={GodleyAssetClass::noAssetClass, GodleyAssetClass::liability};
+      godley.zoomFactor=2;
+      model.godleys.push_back(godley);
+
+      auto& rk=model.rungeKutta;
+      rk.stepMin=0.1; rk.stepMax=0.2; rk.nSteps=3; rk.epsRel=0.4;
+      rk.epsAbs=0.5; rk.order=2; rk.implicit=true; rk.simulationDelay=6;
+
+      auto layout=new schema1::UnionLayout;
+      m.layout.emplace_back(layout);
+      layout->id=5;
+      layout->x=1; layout->y=2;
+      layout->visible=false;
+      layout->rotation=3;
+      layout->width=4; layout->height=5;
+      layout->displayZoom=6;
+      layout->sliderVisible=layout->sliderBoundsSet=layout->sliderStepRel=true;
+      layout->sliderMin=7; layout->sliderMax=8; layout->sliderStep=9;
+      layout->coords={10,11,12,13};
+
+      checkStreamUnpack(packXML(m));
+    }
+
+  // every model distributed with Minsky reads the same either way
+  TEST(streamUnpackExamples)
+    {
+      using namespace boost::filesystem;
+      // copied into the working directory by the test script
+      CHECK(exists("examples"));
+      if (!exists("examples")) return;
+      for (directory_iterator i("examples"); i!=directory_iterator(); ++i)
+        if (i->path().extension()==".mky")
+          {
+            ifstream f(i->path().string());
+            ostringstream xml;
+            xml<<f.rdbuf();
+            checkStreamUnpack(xml.str());
+          }
+    }
+
+  TEST_FIXTURE(TestFixture,dataOpsEvaluateACopyOfTheirData)
+    {
+      auto t=model->addItem(OperationPtr(OperationBase::time));
+      auto d=model->addItem(OperationPtr(OperationBase::data));
+      auto v=model->addItem(VariablePtr(VariableType::flow,"v"));
+      dynamic_cast<DataOp&>(*d).data={{0,1},{2,3}};
+      model->addWire(*t,*d,1,vector<float>());
+      model->addWire(*d,*v,1,vector<float>());
+      constructEquations();
+      EvalOpPtr e;
+      for (auto& i: equations)
+        if (i->type()==OperationType::data)
+          e=i;
+      CHECK(e);
+      CHECK_CLOSE(2,e->evaluate(1),1e-10);
+      CHECK_CLOSE(1,e->d1(1),1e-10);
+      // a running solver does not see edits made to the operation
+      dynamic_cast<DataOp&>(*d).data={{0,5}};
+      CHECK_CLOSE(2,e->evaluate(1),1e-10);
+    }
+
+  TEST_FIXTURE(TestFixture,binaryModel)
+    {
+      auto op1=model->addItem(OperationPtr(OperationBase::data));
+      auto op2=model->addItem(OperationPtr(OperationBase::integrate));
+      dynamic_cast<IntOp*>(op2.get())->description("output & more");
+      dynamic_cast<DataOp*>(op1.get())->data={{0,1},{2,3}};
+      model->addWire(*op1,*op2,1,vector<float>());
+      auto& g=dynamic_cast<GodleyIcon&>(*model->addItem(new GodleyIcon));
+      g.table.dimension(3,3);
+      g.table.cell(0,1)="a";
+      g.table.cell(2,1)=" b";
+      g.update();
+      model->addItem(new PlotWidget);
+      model->addGroup(new Group)->title="a group";
+      save("binaryModel.mky");
+
+      convertModelFile("binaryModel.mky","binaryModel.mkyb");
+      CHECK(schema1::isBinaryModel("binaryModel.mkyb"));
+      CHECK(!schema1::isBinaryModel("binaryModel.mky"));
+
+      // binary form holds exactly the same schema object
+      schema1::Minsky viaXML, viaBinary;
+      {
+        ifstream f("binaryModel.mky");
+        schema1::streamUnpack(f,viaXML);
+      }
+      schema1::loadBinary("binaryModel.mkyb",viaBinary);
+      ostringstream a, b;
+      {
+        classdesc::xml_pack_t x(a,"");
+        xml_pack(x,"Minsky",viaXML);
+      }
+      {
+        classdesc::xml_pack_t x(b,"");
+        xml_pack(x,"Minsky",viaBinary);
+      }
+      CHECK_EQUAL(a.str(), b.str());
+
+      // and converts back
+      convertModelFile("binaryModel.mkyb","binaryModel2.mky");
+      schema1::Minsky viaConverted;
+      {
+        ifstream f("binaryModel2.mky");
+        schema1::streamUnpack(f,viaConverted);
+      }
+      ostringstream c;
+      {
+        classdesc::xml_pack_t x(c,"");
+        xml_pack(x,"Minsky",viaConverted);
+      }
+      CHECK_EQUAL(a.str(), c.str());
+
+      size_t numItems=model->items.size();
+      load("binaryModel.mkyb");
+      CHECK_EQUAL(numItems, model->items.size());
+      CHECK_EQUAL(1, model->wires.size());
+    }
+
+  TEST_FIXTURE(TestFixture,storedEquations)
+    {
+      auto gi=new GodleyIcon;
+      model->addItem(gi);
+      GodleyTable& godley=gi->table;
+      godley.resize(3,4);
+      godley.cell(0,1)="c";
+      godley.cell(0,2)="d";
+      godley.cell(0,3)="e";
+      godley.cell(2,1)="a";
+      godley.cell(2,2)="b";
+      godley.cell(2,3)="f";
+      gi->update();
+
+      map<string, VariablePtr> var;
+      for (ItemPtr& i: model->items)
+        if (auto v=dynamic_pointer_cast<VariableBase>(i))
+          var[v->name()]=v;
+      var["c"]->init("0.1");
+      var["d"]->init("0.2");
+      var["e"]->init("0.3");
+
+      auto addOp=model->addItem(OperationBase::create(OperationType::add)); 
+      auto intOp=model->addItem(OperationBase::create(OperationType::integrate)); 
+      auto mulOp=model->addItem(OperationBase::create(OperationType::multiply)); 
+      model->addWire(*var["e"], *var["f"], 1, {});
+      model->addWire(*var["c"], *addOp, 1, {});
+      model->addWire(*var["d"], *addOp, 2, {});
+      model->addWire(*addOp, *intOp, 1, {});
+      model->addWire(*intOp, *var["a"], 1, {});
+      model->addWire(*intOp, *mulOp, 1, {});
+      model->addWire(*var["e"], *mulOp, 2, {});
+      model->addWire(*mulOp, *var["b"], 1, {});
+
+      auto run=[&]() {
+        reset();
+        for (int i=0; i<5; ++i) step();
+        vector<double> r;
+        for (auto& i: var)
+          r.push_back(variableValues[i.second->valueId()].value());
+        return r;
+      };
+
+      order=1;
+      implicit=false;
+      storeEquations=true;
+      reset();
+      save("storedEquations.mky");
+      CHECK(ifstream(CompiledEquations::fileName("storedEquations.mky")).good());
+      vector<double> expected=run();
+
+      // the stored program is used in place of constructing equations
+      load("storedEquations.mky");
+      CHECK(pendingEquations);
+      vector<double> restored=run();
+      CHECK(!pendingEquations);
+      CHECK_ARRAY_CLOSE(expected, restored, expected.size(), 1e-10);
+
+      remove(CompiledEquations::fileName("storedEquations.mky").c_str());
+      load("storedEquations.mky");
+      CHECK(!pendingEquations);
+      vector<double> rebuilt=run();
+      CHECK_ARRAY_CLOSE(expected, rebuilt, expected.size(), 1e-10);
+
+      // editing the model invalidates the stored program
+      save("storedEquations.mky");
+      load("storedEquations.mky");
+      CHECK(pendingEquations);
+      markEdited();
+      CHECK(!pendingEquations);
+
+      // as does a structural change between save and load
+      reset();
+      save("storedEquations.mky");
+      string xml;
+      {
+        ifstream f("storedEquations.mky");
+        xml.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+      }
+      auto pos=xml.find("<init>0.3</init>");
+      CHECK(pos!=string::npos);
+      xml.replace(pos, 16, "<init>0.4</init>");
+      ofstream("storedEquations.mky")<<xml;
+      load("storedEquations.mky");
+      CHECK(!pendingEquations);
+    }
+
+  TEST_FIXTURE(TestFixture,backgroundSave)
+    {
+      auto a=model->addItem(new Variable<VariableType::flow>("a"));
+      auto b=model->addItem(new Variable<VariableType::flow>("b"));
+      model->addWire(*a,*b,1,vector<float>());
+      save("backgroundSave.mky");
+      string expected;
+      {
+        ifstream f("backgroundSave.mky");
+        expected.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+      }
+
+      markEdited();
+      saveInBackground("backgroundSave2.mky");
+      CHECK(!edited());
+      // edits after the snapshot do not appear in the saved file
+      model->addItem(new Variable<VariableType::flow>("c"));
+      waitForSave();
+      CHECK(!saveInProgress());
+      CHECK(takeSaveError().empty());
+      string saved;
+      {
+        ifstream f("backgroundSave2.mky");
+        saved.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+      }
+      CHECK_EQUAL(expected, saved);
+      CHECK(!ifstream("backgroundSave2.mky.tmp").good());
+
+      // a failed save is reported, and leaves the model unsaved
+      saveInBackground("nonexistentDirectory/backgroundSave.mky");
+      waitForSave();
+      CHECK(!takeSaveError().empty());
+      CHECK(edited());
+      CHECK(takeSaveError().empty());
+    }
+
+  TEST_FIXTURE(ClipboardFixture,lazyClipboard)
+    {
+      auto a=model->addItem(new Variable<VariableType::flow>("a"));
+      a->moveTo(10,10);
+      select(0,0,20,20);
+      CHECK_EQUAL(1,currentSelection.items.size());
+      // selecting serialises nothing
+      CHECK(clipboardOwned);
+      CHECK(!clipboard);
+      CHECK(clipboardXML.empty());
+
+      copy();
+      CHECK(clipboard);
+      CHECK(clipboardXML.empty());
+      auto g=paste();
+      CHECK_EQUAL(1,g->items.size());
+      CHECK(clipboardXML.empty());
+
+      // XML is only produced when requested by another application
+      string xml=clipboardText();
+      CHECK(xml.find("Minsky")!=string::npos);
+      CHECK_EQUAL(xml.substr(5,10), clipboardChunk(5,10));
+      clipboardLost();
+      CHECK(!clipboardOwned);
+    }
+
+  TEST_FIXTURE(CopyClipboardFixture,internalClipboardFallback)
+    {
+      auto a=model->addItem(new Variable<VariableType::flow>("a"));
+      a->moveTo(10,10);
+      select(0,0,20,20);
+      CHECK(!clipboardOwned);
+      CHECK(systemClipboard.empty());
+
+      // copy places XML on the system clipboard, but pasting uses the
+      // binary snapshot whilst the system clipboard is unchanged
+      copy();
+      CHECK(clipboardOwned);
+      CHECK_EQUAL(clipboardText(), systemClipboard);
+      model->removeItem(*a);
+      CHECK_EQUAL(1,paste()->items.size());
+      CHECK(clipboardOwned);
+
+      // another application replaces the clipboard contents
+      {
+        ostringstream os;
+        classdesc::xml_pack_t x(os,"");
+        schema1::Minsky empty;
+        xml_pack(x,"Minsky",empty);
+        systemClipboard=os.str();
+      }
+      CHECK_EQUAL(0,paste()->items.size());
+      CHECK(!clipboardOwned);
+      CHECK(!clipboard);
+    }
+
+  TEST_FIXTURE(TestFixture,undoHistory)
+    {
+      pushHistory();
+      for (int i=0; i<10; ++i)
+        {
+          model->addItem(new Variable<VariableType::flow>("v"+to_string(i)));
+          pushHistory();
+        }
+      CHECK_EQUAL(11,historySize());
+      // earlier states are held as deltas, much smaller than a full state
+      size_t head=historyEntryBytes(historySize()-1);
+      for (size_t i=0; i<historySize()-1; ++i)
+        CHECK(historyEntryBytes(i)<head/2);
+
+      size_t numItems=model->items.size();
+      undo(3);
+      CHECK_EQUAL(numItems-3, model->items.size());
+      undo(-2);
+      CHECK_EQUAL(numItems-1, model->items.size());
+      undo(5);
+      CHECK_EQUAL(numItems-6, model->items.size());
+
+      // when over budget, the oldest states are discarded
+      maxHistoryBytes=0;
+      pushHistory();
+      CHECK_EQUAL(1,historySize());
+      CHECK_EQUAL(historyEntryBytes(0),historyBytes());
+    }
+
+  TEST_FIXTURE(TestFixture,scenarios)
+    {
+      auto rate=model->addItem(new Variable<VariableType::parameter>("rate"));
+      dynamic_cast<VariableBase*>(rate.get())->init("10");
+      auto op=model->addItem(OperationPtr(OperationBase::integrate));
+      dynamic_cast<IntOp*>(op.get())->description("output");
+      model->addWire(*rate,*op,1,vector<float>());
+      nSteps=1;
+
+      runScenarioPrefix(1);
+      double t0=t;
+      addScenario("low");
+      setScenarioParameter("low",":rate",1);
+      addScenario("high");
+      setScenarioParameter("high",":rate",100);
+      runScenarios(2);
+      CHECK(scenarioError("low").empty());
+      CHECK(scenarioError("high").empty());
+      // prefix is shared, not copied
+      CHECK(scenarios["low"].results->prefix==scenarioPrefix);
+      CHECK(scenarios["high"].results->prefix==scenarioPrefix);
+
+      auto times=scenarioTimes("low");
+      auto values=scenarioValues("low",":output");
+      CHECK_EQUAL(times.size(), values.size());
+      CHECK(times.back()>=2);
+      for (size_t i=0; i<times.size(); ++i)
+        CHECK_CLOSE(times[i]<=t0? 10*times[i]: 10*t0+(times[i]-t0),
+                    values[i], 1e-5);
+      times=scenarioTimes("high");
+      values=scenarioValues("high",":output");
+      for (size_t i=0; i<times.size(); ++i)
+        CHECK_CLOSE(times[i]<=t0? 10*times[i]: 10*t0+100*(times[i]-t0),
+                    values[i], 1e-5);
+
+      // base model is unaffected by the scenarios
+      CHECK_EQUAL(t0,t);
+      CHECK_CLOSE(10*t, variableValues[":output"].value(), 1e-5);
+    }
+
+  TEST_FIXTURE(TestFixture,threadedSimulation)
+    {
+      auto op1=model->addItem(OperationPtr(OperationBase::constant));
+      auto op2=model->addItem(OperationPtr(OperationBase::integrate));
+      dynamic_cast<IntOp*>(op2.get())->description("output");
+      model->addWire(*op1,*op2,1,vector<float>());
+      dynamic_cast<Constant*>(op1.get())->value=10;
+      nSteps=1;
+      simulationQueueSize=16; // ensure solver has to wait for us
+
+      startSimulation();
+      CHECK(simulationRunning());
+      size_t steps=0;
+      while (steps<100)
+        steps+=syncSimulation();
+      stopSimulation();
+      CHECK(!simulationRunning());
+      CHECK(t>0);
+      // model state is consistent with the last state received
+      CHECK_CLOSE(10*t, variableValues[":output"].value(), 1e-5);
+
+      // pausing and resuming continues from where we left off
+      double t0=t;
+      startSimulation();
+      pauseSimulation();
+      CHECK(simulationRunning());
+      CHECK(t>=t0);
+      t0=t;
+      while (t<=t0)
+        syncSimulation();
+      stopSimulation();
+      CHECK_CLOSE(10*t, variableValues[":output"].value(), 1e-5);
+    }
+
+  struct ErrorItemFixture: public TestFixture
+  {
+    mutable vector<pair<float,float>> shown;
+    using Minsky::displayErrorItem;
+    void displayErrorItem(float x, float y) const override
+    {shown.emplace_back(x,y);}
+  };
+
+  TEST_FIXTURE(ErrorItemFixture,errorItemsOnlyShownFromGUIThread)
+    {
+      auto op=model->addItem(OperationPtr(OperationBase::time));
+      op->moveTo(100,50);
+      // other threads must not read the item's position
+      std::thread([&]{displayErrorItem(op);}).join();
+      CHECK(shown.empty());
+      displayErrorItem(op);
+      CHECK_EQUAL(1,shown.size());
+      CHECK_CLOSE(100,shown[0].first,1e-4);
+      CHECK_CLOSE(50,shown[0].second,1e-4);
+    }
+
   /*
     check that cyclic networks throw an exception
 
@@ -388,6 +1038,64 @@ SUITE(Minsky)
       constructEquations();
     }
 
+  TEST_FIXTURE(TestFixture,cycleRejectedWhenWired)
+    {
+      auto add=model->addItem(OperationPtr(OperationType::add));
+      auto mul=model->addItem(OperationPtr(OperationType::multiply));
+      auto w=model->addItem(VariablePtr(VariableType::flow,"w"));
+      auto integ=model->addItem(OperationPtr(OperationType::integrate));
+      CHECK(model->addWire(*add, *w, 1));
+      CHECK(model->addWire(*w, *mul, 1));
+      CHECK(wiringOrder.valid());
+      // closing the loop is refused
+      CHECK(!model->addWire(*mul, *add, 1));
+      CHECK(!model->addWire(*w, *add, 2));
+      // but may pass through an integral
+      CHECK(model->addWire(*mul, *integ, 1));
+      CHECK(model->addWire(*integ, *add, 1));
+      CHECK(wiringOrder.valid());
+      CHECK(!cycleCheck());
+
+      // cycles arriving by other routes are still detected
+      model->addWire(new Wire(w->ports[0], add->ports[2]));
+      CHECK(!wiringOrder.valid());
+      CHECK(cycleCheck());
+      CHECK_THROW(constructEquations(), ecolab::error);
+    }
+
+  TEST_FIXTURE(TestFixture,wiringOrderForgetsRemovedItems)
+    {
+      auto add=model->addItem(OperationPtr(OperationType::add));
+      auto w=model->addItem(VariablePtr(VariableType::flow,"w"));
+      auto mul=model->addItem(OperationPtr(OperationType::multiply));
+      CHECK(model->addWire(*add, *w, 1));
+      CHECK(model->addWire(*w, *mul, 1));
+      CHECK(wiringOrder.valid());
+      size_t n=wiringOrder.size();
+
+      // copies of the model leave its order alone
+      {
+        Group copy;
+        copy=*model;
+        CHECK(!copy.inModel());
+        CHECK(model->inModel());
+      }
+      CHECK_EQUAL(n, wiringOrder.size());
+
+      // moving an item into a group keeps its position
+      auto g=model->addGroup(new Group);
+      g->addItem(mul);
+      CHECK_EQUAL(n, wiringOrder.size());
+      CHECK(!model->addWire(*mul, *add, 1));
+
+      model->removeItem(*add);
+      CHECK_EQUAL(n-1, wiringOrder.size());
+      // removing a group forgets its contents
+      model->removeGroup(*g);
+      CHECK_EQUAL(n-2, wiringOrder.size());
+      CHECK(wiringOrder.valid());
+    }
+
   TEST_FIXTURE(TestFixture,godleyIconVariableOrder)
     {
       auto& g=dynamic_cast<GodleyIcon&>(*model->addItem(new GodleyIcon));
@@ -934,4 +1642,428 @@ SUITE(Minsky)
       g1->setCell(1,1,"");
       CHECK_EQUAL("0",g1->table.cell(1,1));
     }
+
+    TEST_FIXTURE(TestFixture,godleyParsedCells)
+    {
+      GodleyTable godley;
+      godley.dimension(3,3);
+      godley.cell(0,1)=" a ";
+      godley.cell(1,0)=GodleyTable::initialConditions;
+      godley.cell(2,1)="-2 b";
+      CHECK_EQUAL("a",godley.parsedCell(0,1).flow.name);
+      CHECK_EQUAL(1,godley.parsedCell(0,1).flow.coef);
+      CHECK_EQUAL("b",godley.parsedCell(2,1).flow.name);
+      CHECK_EQUAL(-2,godley.parsedCell(2,1).flow.coef);
+      CHECK(godley.initialConditionRow(1));
+      CHECK(!godley.initialConditionRow(2));
+
+      // edits are reflected in the parsed form
+      godley.cell(2,1)="c";
+      CHECK_EQUAL("c",godley.parsedCell(2,1).flow.name);
+      CHECK_EQUAL(1,godley.parsedCell(2,1).flow.coef);
+      godley.cell(1,0)="";
+      CHECK(!godley.initialConditionRow(1));
+      godley.moveRow(2,-1);
+      CHECK_EQUAL("c",godley.parsedCell(1,1).flow.name);
+      godley.insertCol(1);
+      CHECK_EQUAL("a",godley.parsedCell(0,2).flow.name);
+      CHECK(godley.parsedCell(0,1).flow.name.empty());
+    }
+
+    TEST_FIXTURE(TestFixture,itemsIndexedByKind)
+    {
+      auto v=model->addItem(VariablePtr(VariableType::flow,"x"));
+      auto op=model->addItem(OperationPtr(OperationType::add));
+      model->addItem(new GodleyIcon);
+      auto plot=model->addItem(new PlotWidget);
+      model->addItem(new SwitchIcon);
+      model->addItem(new Item);
+      CHECK_EQUAL(1,countOf(*model,&GroupItems::variables));
+      CHECK_EQUAL(1,countOf(*model,&GroupItems::operations));
+      CHECK_EQUAL(1,countOf(*model,&GroupItems::godleyIcons));
+      CHECK_EQUAL(1,countOf(*model,&GroupItems::plots));
+      CHECK_EQUAL(1,countOf(*model,&GroupItems::switches));
+
+      // moving into a subgroup moves the index entry
+      auto g=model->addGroup(new Group);
+      g->addItem(plot);
+      CHECK_EQUAL(0,model->plots.size());
+      CHECK_EQUAL(1,g->plots.size());
+      CHECK_EQUAL(1,countOf(*model,&GroupItems::plots));
+
+      model->removeItem(*op);
+      CHECK_EQUAL(0,countOf(*model,&GroupItems::operations));
+      g->removeItem(*plot);
+      CHECK_EQUAL(0,countOf(*model,&GroupItems::plots));
+
+      // copies are indexed afresh
+      Group copy;
+      copy=*model;
+      CHECK_EQUAL(1,countOf(copy,&GroupItems::variables));
+      CHECK(copy.variables[0]!=v);
+      model->clear();
+      CHECK_EQUAL(0,countOf(*model,&GroupItems::variables));
+
+      // removal from the middle of an index keeps the rest intact
+      vector<ItemPtr> vars;
+      for (int i=0; i<5; ++i)
+        vars.push_back(model->addItem(VariablePtr(VariableType::flow,"v"+to_string(i))));
+      model->removeItem(*vars[1]);
+      CHECK_EQUAL(4,countOf(*model,&GroupItems::variables));
+      for (size_t i=0; i<model->variables.size(); ++i)
+        CHECK_EQUAL(i, model->variables[i]->kindIndexPos);
+      for (int i: {4,0,3,2})
+        model->removeItem(*vars[i]);
+      CHECK_EQUAL(0,countOf(*model,&GroupItems::variables));
+    }
+
+    TEST_FIXTURE(TestFixture,convertVarTypeReindexes)
+    {
+      auto a1=model->addItem(VariablePtr(VariableType::flow,"a"));
+      auto b=model->addItem(VariablePtr(VariableType::flow,"b"));
+      auto a2=model->addItem(VariablePtr(VariableType::flow,"a"));
+      convertVarType(VariablePtr(a1)->valueId(), VariableType::parameter);
+
+      // both references are replaced, and the replacements indexed
+      CHECK_EQUAL(3,countOf(*model,&GroupItems::variables));
+      for (size_t i=0; i<model->variables.size(); ++i)
+        {
+          auto& v=model->variables[i];
+          CHECK(v!=a1 && v!=a2);
+          CHECK_EQUAL(i, v->kindIndexPos);
+          CHECK_EQUAL(v==b? VariableType::flow: VariableType::parameter, v->type());
+        }
+
+      // deleting a converted variable leaves the others indexed
+      for (auto& v: model->variables)
+        if (v!=b)
+          {
+            model->removeItem(*v);
+            break;
+          }
+      CHECK_EQUAL(2,countOf(*model,&GroupItems::variables));
+      CHECK(find(model->variables.begin(),model->variables.end(),b)!=model->variables.end());
+      for (size_t i=0; i<model->variables.size(); ++i)
+        CHECK_EQUAL(i, model->variables[i]->kindIndexPos);
+    }
+
+    TEST_FIXTURE(TestFixture,spatialIndexQueries)
+    {
+      auto a=model->addItem(new Variable<VariableType::flow>("a"));
+      auto b=model->addItem(new Variable<VariableType::flow>("b"));
+      a->moveTo(100,100);
+      b->moveTo(1000,1000);
+      auto found=[&](float x0, float y0, float x1, float y1, const ItemPtr& i) {
+        auto r=model->itemsIntersecting(BoundingBox(x0,y0,x1,y1));
+        return find(r.begin(), r.end(), i)!=r.end();
+      };
+      CHECK(found(95,95,105,105,a));
+      CHECK(!found(95,95,105,105,b));
+
+      // moves, removals and additions are tracked
+      b->moveTo(110,100);
+      CHECK(found(95,95,105,105,b));
+      CHECK(!found(995,995,1005,1005,b));
+      select(90,90,120,110);
+      CHECK_EQUAL(2,currentSelection.items.size());
+      model->removeItem(*a);
+      CHECK(!found(95,95,105,105,a));
+      auto c=model->addItem(OperationPtr(OperationType::time));
+      c->moveTo(500,500);
+      CHECK(found(495,495,505,505,c));
+      auto g=model->addGroup(new Group);
+      g->moveTo(2000,2000);
+      CHECK(found(1995,1995,2005,2005,g));
+
+      // zooming scales the indexed boxes, rather than remeasuring them
+      BoundingBox before, after;
+      CHECK(model->spatialIndex.find(*c,before));
+      model->zoom(0,0,2);
+      CHECK(model->spatialIndex.unmeasured.empty());
+      CHECK(model->spatialIndex.find(*c,after));
+      CHECK_CLOSE(2*before.x0, after.x0, 1e-3);
+      CHECK_CLOSE(2*before.x1, after.x1, 1e-3);
+      CHECK(found(995,995,1005,1005,c));
+      model->zoom(0,0,0.5);
+
+      ClosestPort p(*model, ClosestPort::out, 520, 500);
+      CHECK(p && &p->item==c.get());
+    }
+
+    TEST_FIXTURE(TestFixture,resizedItemsReindexed)
+    {
+      auto plot=model->addItem(new PlotWidget);
+      plot->moveTo(100,100);
+      auto g=model->addGroup(new Group);
+      g->moveTo(1000,1000);
+      // measure both into the spatial index
+      select(90,90,110,110);
+      CHECK_EQUAL(1,currentSelection.items.size());
+      select(350,350,380,380);
+      CHECK(currentSelection.empty());
+
+      // lasso selection finds the resized plot by its new extent
+      dynamic_cast<PlotWidget&>(*plot).resize(600,600);
+      select(350,350,380,380);
+      CHECK_EQUAL(1,currentSelection.items.size());
+
+      dynamic_cast<Group&>(*g).resize(600,600);
+      select(1250,1250,1280,1280);
+      CHECK_EQUAL(1,currentSelection.groups.size());
+    }
+
+    TEST_FIXTURE(TestFixture,iconCacheReusesUnchangedIcons)
+    {
+      auto v=model->addItem(new Variable<VariableType::flow>("a"));
+      cairo_surface_t* surf=cairo_image_surface_create(CAIRO_FORMAT_ARGB32,100,100);
+      cairo_t* cairo=cairo_create(surf);
+      cairo_translate(cairo,50,50);
+      auto& cache=iconCache();
+      size_t hits=cache.hits(), misses=cache.misses();
+      v->drawCached(cairo);
+      CHECK_EQUAL(misses+1,cache.misses());
+      v->drawCached(cairo);
+      CHECK_EQUAL(hits+1,cache.hits());
+
+      // changes of state redraw the icon
+      dynamic_cast<VariableBase&>(*v).name("b");
+      v->drawCached(cairo);
+      CHECK_EQUAL(misses+2,cache.misses());
+      v->rotation=90;
+      v->drawCached(cairo);
+      CHECK_EQUAL(misses+3,cache.misses());
+      CHECK_EQUAL(hits+1,cache.hits());
+
+      // the image is released with its item
+      size_t n=cache.size();
+      model->removeItem(*v);
+      v.reset();
+      CHECK_EQUAL(n-1,cache.size());
+      cairo_destroy(cairo);
+      cairo_surface_destroy(surf);
+    }
+
+    TEST_FIXTURE(TestFixture,wireGeometryFollowsPorts)
+    {
+      auto g=model->addGroup(new Group);
+      auto a=g->addItem(new Variable<VariableType::flow>("a"));
+      auto b=g->addItem(new Variable<VariableType::flow>("b"));
+      a->moveTo(100,100);
+      b->moveTo(300,100);
+      auto w=g->addWire(new Wire(a->ports[0], b->ports[1], {100,100,200,150,300,200}));
+      float ax=a->ports[0]->x(), ay=a->ports[0]->y();
+      CHECK_CLOSE(ax,w->geometry().coords[0],1e-4);
+      CHECK_EQUAL(6,w->geometry().coords.size());
+
+      // moving the enclosing group moves the wire
+      g->moveTo(g->x()+50, g->y());
+      CHECK_CLOSE(ax+50,a->ports[0]->x(),1e-4);
+      CHECK_CLOSE(ax+50,w->geometry().coords[0],1e-4);
+      CHECK_CLOSE(ay,w->geometry().coords[1],1e-4);
+
+      // as does moving a port, and the curve ends at the port
+      b->ports[1]->moveTo(400,120);
+      auto& curve=w->geometry().curve;
+      CHECK_CLOSE(400,w->coords()[4],1e-4);
+      CHECK_CLOSE(400,curve[curve.size()-2],1e-4);
+      CHECK_CLOSE(120,curve[curve.size()-1],1e-4);
+    }
+
+    TEST_FIXTURE(TestFixture,renderCanvasToPNG)
+    {
+      model->addItem(new Variable<VariableType::flow>("a"))->moveTo(100,100);
+      model->addItem(new Variable<VariableType::flow>("b"))->moveTo(3000,2000);
+      auto b=canvasBounds();
+      CHECK(b.x0<100 && b.x1>3000 && b.y0<100 && b.y1>2000);
+      renderCanvasToPNG("renderCanvas.png",2);
+
+      ifstream f("renderCanvas.png", ios::binary);
+      unsigned char header[24];
+      CHECK(f.read((char*)header,sizeof(header)));
+      CHECK_EQUAL(0x89,header[0]);
+      CHECK_EQUAL("IHDR",string((char*)header+12,4));
+      auto get32=[&](int i) {
+        return (unsigned(header[i])<<24)|(header[i+1]<<16)|(header[i+2]<<8)|header[i+3];
+      };
+      CHECK_EQUAL(unsigned(ceil(2*(b.x1-b.x0+20))),get32(16));
+      CHECK_EQUAL(unsigned(ceil(2*(b.y1-b.y0+20))),get32(20));
+    }
+
+    TEST_FIXTURE(TestFixture,renderCanvasToPNGWiderThanCairoSurface)
+    {
+      // cairo image surfaces are at most 32767 pixels wide
+      model->addItem(new Variable<VariableType::flow>("a"))->moveTo(100,100);
+      model->addItem(new Variable<VariableType::flow>("b"))->moveTo(20000,100);
+      auto b=canvasBounds();
+      renderCanvasToPNG("renderCanvasWide.png",2);
+
+      ifstream f("renderCanvasWide.png", ios::binary);
+      string png((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+      CHECK(png.size()>24);
+      auto get32=[&](int i) {
+        return (unsigned((unsigned char)png[i])<<24)|((unsigned char)png[i+1]<<16)|
+          ((unsigned char)png[i+2]<<8)|(unsigned char)png[i+3];
+      };
+      CHECK(get32(16)>32767);
+      CHECK_EQUAL(unsigned(ceil(2*(b.x1-b.x0+20))),get32(16));
+      CHECK_EQUAL("IEND",png.substr(png.size()-8,4));
+    }
+
+    TEST_FIXTURE(TestFixture,equationViewRendersOnlyChangedRows)
+    {
+      auto a=model->addItem(VariablePtr(VariableType::flow,"a"));
+      auto b=model->addItem(VariablePtr(VariableType::flow,"b"));
+      auto c=model->addItem(VariablePtr(VariableType::flow,"c"));
+      auto op=model->addItem(OperationPtr(OperationType::exp));
+      model->addWire(new Wire(a->ports[0], op->ports[1]));
+      model->addWire(new Wire(op->ports[0], b->ports[1]));
+      markEdited();
+      updateEquationView();
+      size_t rows=equationView.size(), rendered=equationView.rowsRendered();
+      CHECK(rows>=2);
+      CHECK_EQUAL(rows,rendered);
+
+      // an edit leaving the equations unchanged renders nothing
+      a->moveTo(200,200);
+      markEdited();
+      updateEquationView();
+      CHECK_EQUAL(rendered,equationView.rowsRendered());
+
+      // defining c renders just its row
+      model->addWire(new Wire(op->ports[0], c->ports[1]));
+      markEdited();
+      updateEquationView();
+      CHECK_EQUAL(rendered+1,equationView.rowsRendered());
+
+      // drawing is restricted to the clip region
+      cairo_surface_t* surf=cairo_image_surface_create
+        (CAIRO_FORMAT_ARGB32,ceil(equationView.width())+1,ceil(equationView.height())+1);
+      cairo_t* cairo=cairo_create(surf);
+      size_t drawn=equationView.rowsDrawn();
+      cairo_move_to(cairo,0,0);
+      equationView.draw(cairo);
+      CHECK_EQUAL(drawn+=equationView.size(),equationView.rowsDrawn());
+      // a pane entirely above the surface replays nothing
+      cairo_move_to(cairo,0,-2*equationView.height()-100);
+      equationView.draw(cairo);
+      CHECK_EQUAL(drawn,equationView.rowsDrawn());
+      cairo_destroy(cairo);
+      cairo_surface_destroy(surf);
+    }
+    TEST(ringBuffer)
+    {
+      RingBuffer<vector<double> > q(2);
+      vector<double> x{1}, y;
+      CHECK(q.push(x));
+      x={2};
+      CHECK(q.push(x));
+      x={3};
+      CHECK(!q.push(x));
+      CHECK_EQUAL(2,q.size());
+      CHECK(q.pop(y));
+      CHECK_EQUAL(1,y[0]);
+      CHECK(q.push(x));
+      CHECK(q.pop(y));
+      CHECK_EQUAL(2,y[0]);
+      CHECK(q.pop(y));
+      CHECK_EQUAL(3,y[0]);
+      CHECK(!q.pop(y));
+      CHECK(q.empty());
+    }
+
+    TEST(logWriter)
+    {
+      {
+        LogWriter log("testLog.dat",{"a","b"},4,false);
+        vector<double> record;
+        for (int i=0; i<100; ++i)
+          {
+            record={double(i), 2.0*i, 3.0*i};
+            log.push(record);
+          }
+      } // destructor flushes all records
+      ifstream f("testLog.dat");
+      string header;
+      getline(f,header);
+      CHECK_EQUAL("#time a b",header);
+      int n=0;
+      double t,a,b;
+      while (f>>t>>a>>b)
+        {
+          CHECK_EQUAL(n,t);
+          CHECK_EQUAL(2*n,a);
+          CHECK_EQUAL(3*n,b);
+          n++;
+        }
+      CHECK_EQUAL(100,n);
+    }
+
+    TEST_FIXTURE(TestFixture,logWriteErrorsAreReported)
+    {
+      LogWriter log("/dev/full",{"a"},4,false);
+      vector<double> record;
+      for (int i=0; i<10000; ++i)
+        {
+          record={double(i), double(i)};
+          log.push(record);
+        }
+      log.close();
+      CHECK(log.failed());
+
+      // the simulation is told, and logging stops
+      openLogFile("/dev/full");
+      bool thrown=false;
+      for (int i=0; i<10000 && !thrown; ++i)
+        {
+          try {logVariables();}
+          catch (const ecolab::error&) {thrown=true;}
+          this_thread::sleep_for(chrono::microseconds(10));
+        }
+      CHECK(thrown);
+      CHECK(!outputDataFile);
+    }
+    TEST(plotRenderer)
+    {
+      auto frame=make_shared<PlotFrame>();
+      ecolab::Plot plot;
+      plot.addPt(0,0,0);
+      plot.addPt(0,1,1);
+      size_t frames=plotRenderer().frames();
+      plotRenderer().submit(frame, plot, 100, 50);
+      plotRenderer().waitIdle();
+      CHECK_EQUAL(frames+1, plotRenderer().frames());
+      CHECK(frame->ready);
+      CHECK(frame->outstanding==0);
+
+      cairo_surface_t* surf=cairo_image_surface_create(CAIRO_FORMAT_ARGB32,100,50);
+      cairo_t* cairo=cairo_create(surf);
+      CHECK(frame->blit(cairo,100,50));
+      // wrong size
+      CHECK(!frame->blit(cairo,80,50));
+      // data changed since frame was rendered
+      frame->generation++;
+      CHECK(!frame->blit(cairo,100,50));
+      cairo_destroy(cairo);
+      cairo_surface_destroy(surf);
+    }
+    TEST(plotWidgetKeepsAddedPoints)
+    {
+      PlotWidget plot;
+      plot.addPt(0,0,0);
+      plot.addPt(0,1,1);
+      CHECK_EQUAL(2,plot.historyEntries());
+      // redraw reloads the pens from history
+      plot.redraw();
+      CHECK_EQUAL(2,plot.historyEntries());
+      CHECK_EQUAL(2,plot.historyCursor()[0]);
+    }
+
+    TEST_FIXTURE(TestFixture,plotHistoryCapacityValidated)
+    {
+      unsigned c=plotHistoryCapacity();
+      CHECK_THROW(plotHistoryCapacity(PlotHistory::minCapacity-1), ecolab::error);
+      CHECK_EQUAL(c,plotHistoryCapacity());
+      plotHistoryCapacity(PlotHistory::minCapacity);
+      CHECK_EQUAL(PlotHistory::minCapacity,plotHistoryCapacity());
+    }
 }
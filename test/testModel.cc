@@ -137,3 +137,75 @@ SUITE(Group)
     CHECK_EQUAL(1,model->wires.size());
   }
 }
+
+SUITE(PlotHistory)
+{
+  TEST(boundedMemory)
+    {
+      PlotHistory h(900);
+      for (int i=0; i<100000; ++i)
+        h.append(0, i, i==500? 1000: 0);
+      CHECK_EQUAL(100000, h.count(0));
+      CHECK(h.storedEntries()<=900);
+
+      vector<double> x, y;
+      h.query(0, x, y, 100);
+      CHECK(x.size()<=100);
+      CHECK(x.size()>0);
+      // spike must survive decimation
+      CHECK_EQUAL(1000, *max_element(y.begin(), y.end()));
+      for (size_t i=1; i<x.size(); ++i)
+        CHECK(x[i]>=x[i-1]);
+    }
+
+  TEST(truncate)
+    {
+      PlotHistory h(900);
+      for (int i=0; i<10000; ++i)
+        h.append(0, i, i);
+      h.truncate(0, 5000);
+      CHECK_EQUAL(5000, h.count(0));
+      vector<double> x, y;
+      h.query(0, x, y, 10000);
+      CHECK(!x.empty());
+      CHECK(*max_element(x.begin(), x.end())<5000);
+      // new points carry on from the truncation point
+      h.append(0, 5000, 5000);
+      h.query(0, x, y, 10000);
+      CHECK_EQUAL(5000, x.back());
+    }
+
+  TEST(smallCapacity)
+    {
+      for (size_t c=PlotHistory::minCapacity; c<50; ++c)
+        {
+          PlotHistory h(c);
+          for (int i=0; i<1000; ++i)
+            h.append(0, i, i);
+          CHECK(h.storedEntries()<=c);
+        }
+      // shrinking folds the coarser levels into those remaining
+      PlotHistory h(900);
+      for (int i=0; i<100000; ++i)
+        h.append(0, i, i==500? 1000: 0);
+      h.setCapacity(10);
+      CHECK(h.storedEntries()<=10);
+      vector<double> x, y;
+      h.query(0, x, y, 100);
+      CHECK_EQUAL(1000, *max_element(y.begin(), y.end()));
+      CHECK_THROW(h.setCapacity(1), ecolab::error);
+    }
+
+  TEST(zoomUsesFinestLevel)
+    {
+      PlotHistory h(900);
+      for (int i=0; i<100000; ++i)
+        h.append(0, i, i);
+      vector<double> x, y;
+      // recent data is stored at full resolution
+      h.query(0, x, y, 1000, 99950, 99999);
+      CHECK_EQUAL(50, x.size());
+      CHECK_EQUAL(99950, x.front());
+      CHECK_EQUAL(99999, x.back());
+    }
+}